@@ -0,0 +1,131 @@
+#ifndef INC_METTLE_DETAIL_MOVE_ONLY_FUNCTION_HPP
+#define INC_METTLE_DETAIL_MOVE_ONLY_FUNCTION_HPP
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace mettle::detail {
+
+  template<typename Signature>
+  class move_only_function;
+
+  // Like `std::function`, but never copies its callable, so the callable can
+  // be move-only, and has room to hold a few pointers' worth of callable (e.g.
+  // a `std::function` or a lambda with a handful of captures) without
+  // allocating.
+  template<typename Ret, typename ...Args>
+  class move_only_function<Ret(Args...)> {
+    static constexpr std::size_t buffer_size = 4 * sizeof(void*);
+
+    template<typename T>
+    static constexpr bool fits_inline = (
+      sizeof(T) <= buffer_size &&
+      alignof(T) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<T>
+    );
+  public:
+    move_only_function() = default;
+    move_only_function(std::nullptr_t) {}
+
+    template<typename F>
+    requires(!std::is_same_v<std::remove_cvref_t<F>, move_only_function> &&
+             std::is_invocable_r_v<Ret, std::decay_t<F> &, Args...>)
+    move_only_function(F &&f) {
+      using T = std::decay_t<F>;
+      if constexpr(std::is_pointer_v<T> || std::is_member_pointer_v<T> ||
+                   requires(const T &t) { t == nullptr; }) {
+        if(f == nullptr)
+          return;
+      }
+
+      if constexpr(fits_inline<T>)
+        ::new(static_cast<void*>(buffer_)) T(std::forward<F>(f));
+      else
+        ::new(static_cast<void*>(buffer_)) T*(new T(std::forward<F>(f)));
+      vtable_ = &vtable_for<T>;
+    }
+
+    move_only_function(move_only_function &&rhs) noexcept
+      : vtable_(rhs.vtable_) {
+      if(vtable_) {
+        vtable_->move(buffer_, rhs.buffer_);
+        rhs.vtable_ = nullptr;
+      }
+    }
+
+    move_only_function & operator =(move_only_function &&rhs) noexcept {
+      if(this != &rhs) {
+        reset();
+        if((vtable_ = rhs.vtable_)) {
+          vtable_->move(buffer_, rhs.buffer_);
+          rhs.vtable_ = nullptr;
+        }
+      }
+      return *this;
+    }
+
+    ~move_only_function() {
+      reset();
+    }
+
+    explicit operator bool() const {
+      return vtable_;
+    }
+
+    Ret operator ()(Args ...args) {
+      return vtable_->invoke(buffer_, std::forward<Args>(args)...);
+    }
+  private:
+    struct vtable {
+      Ret (*invoke)(void *, Args &&...);
+      // Move the callable from `src` to `dst`, destroying the original.
+      void (*move)(void *dst, void *src) noexcept;
+      void (*destroy)(void *) noexcept;
+    };
+
+    template<typename T>
+    static T * target(void *storage) {
+      if constexpr(fits_inline<T>)
+        return std::launder(static_cast<T*>(storage));
+      else
+        return *std::launder(static_cast<T**>(storage));
+    }
+
+    template<typename T>
+    static constexpr vtable vtable_for = {
+      [](void *storage, Args &&...args) -> Ret {
+        return std::invoke(*target<T>(storage), std::forward<Args>(args)...);
+      },
+      [](void *dst, void *src) noexcept {
+        if constexpr(fits_inline<T>) {
+          ::new(dst) T(std::move(*target<T>(src)));
+          target<T>(src)->~T();
+        } else {
+          ::new(dst) T*(target<T>(src));
+        }
+      },
+      [](void *storage) noexcept {
+        if constexpr(fits_inline<T>)
+          target<T>(storage)->~T();
+        else
+          delete target<T>(storage);
+      }
+    };
+
+    void reset() {
+      if(vtable_) {
+        vtable_->destroy(buffer_);
+        vtable_ = nullptr;
+      }
+    }
+
+    alignas(std::max_align_t) unsigned char buffer_[buffer_size];
+    const vtable *vtable_ = nullptr;
+  };
+
+} // namespace mettle::detail
+
+#endif
@@ -7,6 +7,7 @@
 #include <optional>
 #include <vector>
 #include <string>
+#include <utility>
 
 #include <boost/any.hpp>
 #include <boost/program_options/options_description.hpp>
@@ -14,9 +15,13 @@
 #include <boost/version.hpp>
 
 #include "filters.hpp"
+#include "list_tests.hpp"
 #include "object_factory.hpp"
+#include "resource_limits.hpp"
+#include "run_tests.hpp"
 #include "detail/export.hpp"
 #include "log/core.hpp"
+#include "log/frame.hpp"
 #include "log/indent.hpp"
 
 #ifdef _WIN32
@@ -36,6 +41,12 @@ namespace mettle {
   struct driver_options {
     std::optional<std::chrono::milliseconds> timeout;
     filter_set filters;
+    std::optional<std::string> history;
+    std::optional<std::size_t> output_limit;
+    resource_limits limits;
+    std::optional<std::size_t> shard_count;
+    std::optional<std::size_t> shard_index;
+    bool stream_output = false;
   };
 
   METTLE_PUBLIC boost::program_options::options_description
@@ -67,6 +78,12 @@ namespace mettle {
   METTLE_PUBLIC boost::program_options::options_description
   make_output_options(output_options &opts, const logger_factory &factory);
 
+  // Boost.ProgramOptions lets an option with an implicit value consume the
+  // next argument (e.g. `--fail-fast file`), so handle the bare form here. Pass
+  // this to `command_line_parser::extra_parser`.
+  METTLE_PUBLIC std::pair<std::string, std::string>
+  parse_fail_fast(const std::string &arg);
+
   METTLE_PUBLIC boost::program_options::option_description *
   has_option(const boost::program_options::options_description &options,
              const boost::program_options::variables_map &args);
@@ -92,10 +109,37 @@ namespace mettle {
   validate(boost::any &v, const std::vector<std::string> &values,
            color_option*, int);
 
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           report_order*, int);
+
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           output_capture*, int);
+
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           list_format*, int);
+
+  // An inclusive range of test IDs, written as `ID` or `FIRST-LAST`.
+  struct test_id_range {
+    test_uid first, last;
+  };
+
+  METTLE_PUBLIC void
+  validate(boost::any &v, const std::vector<std::string> &values,
+           test_id_range*, int);
+
   METTLE_PUBLIC void
   validate(boost::any &v, const std::vector<std::string> &values,
            attr_filter_set*, int);
 
+  namespace log {
+    METTLE_PUBLIC void
+    validate(boost::any &v, const std::vector<std::string> &values,
+             child_protocol*, int);
+  }
+
   METTLE_PUBLIC void
   validate(boost::any &v, const std::vector<std::string> &values,
            name_filter_set*, int);
@@ -7,6 +7,7 @@ namespace mettle::exit_code {
   constexpr const int success = 0;
   constexpr const int failure = 1;
   constexpr const int timeout = 32;
+  constexpr const int out_of_memory = 33;
   constexpr const int bad_args = 64;
   constexpr const int no_inputs = 66;
   constexpr const int unknown_error = 70;
@@ -4,7 +4,10 @@
 #include <cstdint>
 #include <functional>
 #include <initializer_list>
+#include <optional>
 #include <regex>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "filters_core.hpp"
@@ -19,19 +22,35 @@ namespace mettle {
     using iterator = container_type::const_iterator;
 
     name_filter_set() = default;
-    name_filter_set(std::initializer_list<value_type> i) : filters_(i) {}
+    name_filter_set(std::initializer_list<value_type> i)
+      : filters_(i), prefixes_(i.size()) {}
 
     METTLE_PUBLIC filter_result
-    operator ()(const test_name &name, const attributes &) const;
+    operator ()(const test_name &name, const attributes &attrs) const;
+
+    // Match against `full_name` rather than building it from `name`.
+    METTLE_PUBLIC filter_result
+    operator ()(const test_name &, std::string_view full_name,
+                const attributes &) const;
+
+    // Only patterns inserted as strings can hide suites: if a pattern starts
+    // with `^` and some literal text, it can't match tests whose names start
+    // with something else.
+    METTLE_PUBLIC bool
+    hides_suite(std::string_view prefix, const attributes &) const;
 
     void insert(const value_type &item) {
       filters_.push_back(item);
+      prefixes_.emplace_back();
     }
 
     void insert(value_type &&item) {
       filters_.push_back(std::move(item));
+      prefixes_.emplace_back();
     }
 
+    METTLE_PUBLIC void insert(const std::string &pattern);
+
     bool empty() const {
       return filters_.empty();
     }
@@ -49,18 +68,24 @@ namespace mettle {
     }
   private:
     container_type filters_;
+    // The literal text that each anchored pattern requires names to start
+    // with, if we know it.
+    std::vector<std::optional<std::string>> prefixes_;
   };
 
   struct attr_filter_item {
     std::string attribute;
     std::function<bool(const attr_instance *)> func;
+    // What `func` returns for any instance of the attribute, if that doesn't
+    // depend on the instance's value.
+    std::optional<bool> if_present = std::nullopt;
   };
 
   inline attr_filter_item
   has_attr(std::string name) {
     return {std::move(name), [](const attr_instance *attr) -> bool {
       return attr != nullptr;
-    }};
+    }, true};
   }
 
   inline attr_filter_item
@@ -78,7 +103,10 @@ namespace mettle {
     ) -> bool {
       return !func(attr);
     };
-    return {std::move(filter.attribute), std::move(f)};
+    std::optional<bool> if_present;
+    if(filter.if_present)
+      if_present = !*filter.if_present;
+    return {std::move(filter.attribute), std::move(f), if_present};
   }
 
   class attr_filter {
@@ -88,17 +116,25 @@ namespace mettle {
     using iterator = container_type::const_iterator;
 
     attr_filter() = default;
-    attr_filter(std::initializer_list<value_type> i) : filters_(i) {}
+    attr_filter(std::initializer_list<value_type> i) : filters_(i) {
+      for(const auto &f : filters_)
+        ids_.push_back(detail::attr_id(f.attribute));
+    }
 
     METTLE_PUBLIC filter_result
     operator ()(const test_name &, const attributes &attrs) const;
 
+    METTLE_PUBLIC bool
+    hides_suite(std::string_view, const attributes &attrs) const;
+
     void insert(const value_type &item) {
       filters_.push_back(item);
+      ids_.push_back(detail::attr_id(item.attribute));
     }
 
     void insert(value_type &&item) {
       filters_.push_back(std::move(item));
+      ids_.push_back(detail::attr_id(filters_.back().attribute));
     }
 
     bool empty() const {
@@ -118,6 +154,8 @@ namespace mettle {
     }
   private:
     container_type filters_;
+    // The ID of each filter's attribute, so we can look them up quickly.
+    std::vector<std::uint64_t> ids_;
   };
 
   class attr_filter_set {
@@ -132,6 +170,9 @@ namespace mettle {
     METTLE_PUBLIC filter_result
     operator ()(const test_name &, const attributes &attrs) const;
 
+    METTLE_PUBLIC bool
+    hides_suite(std::string_view prefix, const attributes &attrs) const;
+
     void insert(const value_type &item) {
       filters_.push_back(item);
     }
@@ -165,7 +206,22 @@ namespace mettle {
 
     filter_result
     operator ()(const test_name &name, const attributes &attrs) const {
-      auto first = by_name(name, attrs);
+      return then_by_attr(by_name(name, attrs), name, attrs);
+    }
+
+    filter_result
+    operator ()(const test_name &name, std::string_view full_name,
+                const attributes &attrs) const {
+      return then_by_attr(by_name(name, full_name, attrs), name, attrs);
+    }
+
+    bool hides_suite(std::string_view prefix, const attributes &attrs) const {
+      return by_name.hides_suite(prefix, attrs) ||
+             by_attr.hides_suite(prefix, attrs);
+    }
+  private:
+    filter_result then_by_attr(filter_result first, const test_name &name,
+                               const attributes &attrs) const {
       if(first.action == test_action::hide)
         return first;
 
@@ -1,6 +1,11 @@
 #ifndef INC_METTLE_DRIVER_FILTERS_CORE_HPP
 #define INC_METTLE_DRIVER_FILTERS_CORE_HPP
 
+#include <concepts>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
 #include "../suite/attributes.hpp"
 #include "../detail/algorithm.hpp"
 #include "test_name.hpp"
@@ -16,16 +21,112 @@ namespace mettle {
     std::string message;
   };
 
+  // Filters can also define `hides_suite(prefix, attrs)`, returning true only
+  // if they'd hide every test whose full name starts with `prefix` and whose
+  // attributes include `attrs` (e.g. a suite's, which all its tests inherit).
+  // This lets us skip whole suites without looking at each of their tests.
+  template<typename Filter>
+  bool filter_hides_suite(const Filter &filter, std::string_view prefix,
+                          const attributes &attrs) {
+    if constexpr(requires {
+      { filter.hides_suite(prefix, attrs) } -> std::convertible_to<bool>;
+    }) {
+      return filter.hides_suite(prefix, attrs);
+    } else {
+      return false;
+    }
+  }
+
+  // Filters can also be called as `filter(name, full_name, attrs)`, with the
+  // test's full name already built (e.g. by a `basic_test_index`), so that
+  // filters by name don't have to build it for each test themselves.
+  template<typename Filter>
+  filter_result filter_test(const Filter &filter, const test_name &name,
+                            std::string_view full_name,
+                            const attributes &attrs) {
+    if constexpr(requires {
+      { filter(name, full_name, attrs) } -> std::convertible_to<filter_result>;
+    }) {
+      return filter(name, full_name, attrs);
+    } else {
+      return filter(name, attrs);
+    }
+  }
+
   struct default_filter {
     filter_result operator ()(const test_name &, const attributes &) const {
       return test_action::indeterminate;
     }
   };
 
+  // Hide every test whose ID isn't in `tests`, passing the rest through to
+  // the wrapped filter.
+  template<typename Filter>
+  class id_filter {
+  public:
+    id_filter(Filter filter, std::unordered_set<test_uid> tests)
+      : filter_(std::move(filter)), tests_(std::move(tests)) {}
+
+    // Also count how many of our tests come before each test in `index`, so
+    // that we can tell right away whether a suite in it has any of them. The
+    // filter mustn't outlive `index`.
+    template<typename Index>
+    id_filter(Filter filter, std::unordered_set<test_uid> tests,
+              const Index &index)
+      : id_filter(std::move(filter), std::move(tests)) {
+      index_ = &index;
+      tests_before_.reserve(index.tests().size() + 1);
+      tests_before_.push_back(0);
+      for(const auto &test : index.tests()) {
+        tests_before_.push_back(tests_before_.back() +
+                                tests_.count(test.name.id));
+      }
+    }
+
+    filter_result
+    operator ()(const test_name &name, const attributes &attrs) const {
+      if(!tests_.count(name.id))
+        return test_action::hide;
+      return filter_(name, attrs);
+    }
+
+    filter_result operator ()(const test_name &name, std::string_view full_name,
+                              const attributes &attrs) const {
+      if(!tests_.count(name.id))
+        return test_action::hide;
+      return filter_test(filter_, name, full_name, attrs);
+    }
+
+    bool hides_suite(std::string_view prefix, const attributes &attrs) const {
+      return filter_hides_suite(filter_, prefix, attrs);
+    }
+
+    template<typename Index>
+    bool hides_suite(const Index &index, std::size_t suite) const {
+      if(&index == index_) {
+        const auto &s = index.suites()[suite];
+        if(tests_before_[s.subtree_tests_end] == tests_before_[s.tests_begin])
+          return true;
+      }
+      return index.hides_suite(filter_, suite);
+    }
+
+    std::size_t size() const {
+      return tests_.size();
+    }
+  private:
+    Filter filter_;
+    std::unordered_set<test_uid> tests_;
+    const void *index_ = nullptr;
+    std::vector<std::size_t> tests_before_;
+  };
+
   inline filter_result filter_by_attr(const attributes &attrs) {
     using namespace detail;
+    if(!attrs.has_skip())
+      return test_action::run;
     for(const auto &attr : attrs) {
-      if(attr.attribute.action() == test_action::skip)
+      if(attr.attribute().action() == test_action::skip)
         return {test_action::skip, stringify(joined(attr.value))};
     }
     return test_action::run;
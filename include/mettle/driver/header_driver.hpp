@@ -16,7 +16,7 @@ int main() {
   indenting_ostream out(std::cout);
 
   log::simple_summary logger(out);
-  run_tests(detail::all_suites, logger, inline_test_runner);
+  run_tests(detail::all_suites.materialize(), logger, inline_test_runner);
   logger.summarize();
   return !logger.good();
 }
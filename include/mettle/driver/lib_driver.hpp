@@ -9,6 +9,9 @@ namespace mettle::detail {
   METTLE_PUBLIC int
   drive_tests(int argc, const char *argv[], const suites_list &suites);
 
+  METTLE_PUBLIC int
+  drive_tests(int argc, const char *argv[], suite_registry &registry);
+
 } // namespace mettle::detail
 
 int main(int argc, const char *argv[]) {
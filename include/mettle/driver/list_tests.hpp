@@ -0,0 +1,80 @@
+#ifndef INC_METTLE_DRIVER_LIST_TESTS_HPP
+#define INC_METTLE_DRIVER_LIST_TESTS_HPP
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "filters_core.hpp"
+#include "test_index.hpp"
+#include "test_name.hpp"
+#include "detail/export.hpp"
+#include "../suite/attributes.hpp"
+
+namespace mettle {
+
+  enum class list_format {
+    text,
+    json,
+    binary
+  };
+
+  struct listed_test {
+    test_name name;
+    attributes attrs;
+    bool skipped;
+  };
+
+  // Get every test that `filter` doesn't hide, in the order they'd be run,
+  // without running anything.
+  template<typename Suite, typename Filter>
+  std::vector<listed_test>
+  list_tests(const basic_test_index<Suite> &index, const Filter &filter) {
+    const auto &suites = index.suites();
+    std::vector<listed_test> tests;
+    for(std::size_t i = 0; i != suites.size(); i++) {
+      if(index.hides_suite(filter, i)) {
+        i = suites[i].subsuites_end - 1;
+        continue;
+      }
+
+      for(auto t = suites[i].tests_begin; t != suites[i].tests_end; t++) {
+        const auto &test = index.tests()[t];
+        const auto &attrs = test.info->attrs;
+        auto action = filter_test(filter, test.name, test.full_name, attrs);
+        if(action.action == test_action::indeterminate)
+          action = filter_by_attr(attrs);
+
+        if(action.action == test_action::hide)
+          continue;
+        tests.push_back({test.name, attrs,
+                         action.action == test_action::skip});
+      }
+    }
+    return tests;
+  }
+
+  template<typename Suites, typename Filter>
+  std::vector<listed_test>
+  list_tests(const Suites &suites, const Filter &filter) {
+    return list_tests(make_test_index(suites), filter);
+  }
+
+  // Write a list of tests to `out`. The `text` format is one line per test,
+  // meant for people; `json` is an array of objects, one per test; and
+  // `binary` is a series of `log::frame` frames (`define_suites`,
+  // `define_file`, and `listed_test`) that the `mettle` driver can read
+  // cheaply.
+  METTLE_PUBLIC void write_test_list(std::ostream &out,
+                                     const std::vector<listed_test> &tests,
+                                     list_format format);
+
+  // Read the tests from a list written in the `binary` format. Their
+  // attributes aren't included, since they can't be reconstructed outside of
+  // the test file that defined them.
+  METTLE_PUBLIC std::vector<test_name> read_test_list(std::string_view data);
+
+} // namespace mettle
+
+#endif
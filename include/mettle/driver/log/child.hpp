@@ -2,86 +2,166 @@
 #define INC_METTLE_DRIVER_LOG_CHILD_HPP
 
 #include <cassert>
+#include <chrono>
+#include <optional>
 #include <ostream>
+#include <sstream>
 
 #include <bencode.hpp>
 
 #include "core.hpp"
+#include "frame.hpp"
 
 namespace mettle::log {
 
-  class child : public test_logger {
+  // How a child logger batches events before sending them to its parent. By
+  // default, each event is sent as soon as it's logged. Otherwise, events are
+  // held until `max_size` bytes are pending or the oldest one has waited for
+  // `max_delay`. Starting a test or ending the run always sends everything
+  // pending, so the parent knows which test was running if the process dies.
+  struct child_buffering {
+    std::size_t max_size = 0;
+    std::chrono::milliseconds max_delay = std::chrono::milliseconds(0);
+  };
+
+  // Like `protocol_env`, the `mettle` driver sets this environment variable
+  // instead of passing `--output-buffer`, to the number of bytes a child may
+  // hold before sending them.
+  inline constexpr const char *buffer_env = "METTLE_OUTPUT_BUFFER";
+
+  namespace detail {
+    class child_base : public test_logger {
+    public:
+      ~child_base() {
+        try {
+          flush();
+        } catch(...) {}
+      }
+    protected:
+      child_base(std::ostream &out, child_buffering buffering)
+        : out(out), buffering_(buffering) {}
+
+      // Send the events written to `pending` if they're urgent or we've hit
+      // one of our limits; otherwise, hold onto them.
+      void send(bool urgent = false) {
+        if(urgent || static_cast<std::size_t>(pending.tellp()) >=
+                     buffering_.max_size) {
+          flush();
+          return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if(!oldest_)
+          oldest_ = now;
+        if(now - *oldest_ >= buffering_.max_delay)
+          flush();
+      }
+
+      void flush() {
+        if(pending.tellp() > 0) {
+          auto data = pending.view();
+          out.write(data.data(), data.size());
+          out.flush();
+          pending.str("");
+        }
+        oldest_.reset();
+      }
+
+      std::ostringstream pending;
+    private:
+      std::ostream &out;
+      child_buffering buffering_;
+      std::optional<std::chrono::steady_clock::time_point> oldest_;
+    };
+  }
+
+  class child : public detail::child_base {
   public:
-    child(std::ostream &out) : out(out) {}
+    child(std::ostream &out, child_buffering buffering = {})
+      : child_base(out, buffering) {}
 
     void started_run() override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "started_run"}
       });
-      out.flush();
+      send();
     }
     void ended_run() override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "ended_run"}
       });
-      out.flush();
+      send(true);
     }
 
     void started_suite(const std::vector<std::string> &suites) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "started_suite"},
         {"suites", wrap_suites(suites)}
       });
-      out.flush();
+      send();
     }
     void ended_suite(const std::vector<std::string> &suites) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "ended_suite"},
         {"suites", wrap_suites(suites)}
       });
-      out.flush();
+      send();
     }
 
     void started_test(const test_name &test) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "started_test"},
         {"test", wrap_test(test)}
       });
-      out.flush();
+      send(true);
     }
 
     void passed_test(const test_name &test, const test_output &output,
                      test_duration duration) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "passed_test"},
         {"test", wrap_test(test)},
         {"duration", duration.count()},
         {"output", wrap_output(output)}
       });
-      out.flush();
+      send();
     }
 
     void failed_test(const test_name &test, const std::string &message,
                      const test_output &output,
                      test_duration duration) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "failed_test"},
         {"test", wrap_test(test)},
         {"duration", duration.count()},
         {"message", message},
         {"output", wrap_output(output)}
       });
-      out.flush();
+      send();
     }
 
     void skipped_test(const test_name &test,
                       const std::string &message) override {
-      bencode::encode(out, bencode::dict_view{
+      bencode::encode(pending, bencode::dict_view{
         {"event", "skipped_test"},
         {"test", wrap_test(test)},
         {"message", message}
       });
-      out.flush();
+      send();
+    }
+
+    void test_output_chunk(const test_name &test, output_stream stream,
+                           std::string_view data) override {
+      bencode::encode(pending, bencode::dict_view{
+        {"event", "test_output_chunk"},
+        {"test", wrap_test(test)},
+        {"stream", stream == output_stream::stdout_log ? "stdout_log" :
+                                                         "stderr_log"},
+        {"data", data}
+      });
+      // Streamed output is only useful if it arrives while the test is still
+      // running, so don't hold onto it until the next event.
+      send(true);
     }
   private:
     bencode::dict_view wrap_test(const test_name &test) {
@@ -95,9 +175,28 @@ namespace mettle::log {
     }
 
     bencode::dict_view wrap_output(const test_output &output) {
-      return bencode::dict_view{
+      bencode::dict_view result{
         {"stdout_log", output.stdout_log},
-        {"stderr_log", output.stderr_log}
+        {"stderr_log", output.stderr_log},
+        {"stdout_elided", bencode::integer(output.stdout_elided)},
+        {"stderr_elided", bencode::integer(output.stderr_elided)}
+      };
+      if(output.resources)
+        result.emplace("resources", wrap_resources(*output.resources));
+      return result;
+    }
+
+    bencode::dict_view wrap_resources(const test_resources &resources) {
+      return bencode::dict_view{
+        {"user_time", resources.user_time.count()},
+        {"system_time", resources.system_time.count()},
+        {"max_rss", bencode::integer(resources.max_rss)},
+        {"minor_faults", bencode::integer(resources.minor_faults)},
+        {"major_faults", bencode::integer(resources.major_faults)},
+        {"voluntary_switches",
+         bencode::integer(resources.voluntary_switches)},
+        {"involuntary_switches",
+         bencode::integer(resources.involuntary_switches)}
       };
     }
 
@@ -107,8 +206,109 @@ namespace mettle::log {
         result.push_back(i);
       return result;
     }
+  };
+
+  // Like `child`, but sends each event as a binary frame (see frame.hpp),
+  // which is much cheaper for the parent to read.
+  class binary_child : public detail::child_base {
+  public:
+    binary_child(std::ostream &out, child_buffering buffering = {})
+      : child_base(out, buffering) {}
+
+    void started_run() override {
+      w.begin(frame::event_type::started_run);
+      send_frame();
+    }
+    void ended_run() override {
+      w.begin(frame::event_type::ended_run);
+      send_frame(true);
+    }
+
+    void started_suite(const std::vector<std::string> &suites) override {
+      w.begin(frame::event_type::started_suite);
+      w.suites(suites);
+      send_frame();
+    }
+    void ended_suite(const std::vector<std::string> &suites) override {
+      w.begin(frame::event_type::ended_suite);
+      w.suites(suites);
+      send_frame();
+    }
+
+    void started_test(const test_name &test) override {
+      begin_test(frame::event_type::started_test, test);
+      send_frame(true);
+    }
+
+    void passed_test(const test_name &test, const test_output &output,
+                     test_duration duration) override {
+      begin_test(frame::event_type::passed_test, test);
+      w.u64(static_cast<std::uint64_t>(duration.count()));
+      w.output(output);
+      send_frame();
+    }
+
+    void failed_test(const test_name &test, const std::string &message,
+                     const test_output &output,
+                     test_duration duration) override {
+      begin_test(frame::event_type::failed_test, test);
+      w.u64(static_cast<std::uint64_t>(duration.count()));
+      w.str(message);
+      w.output(output);
+      send_frame();
+    }
+
+    void skipped_test(const test_name &test,
+                      const std::string &message) override {
+      begin_test(frame::event_type::skipped_test, test);
+      w.str(message);
+      send_frame();
+    }
+
+    void test_output_chunk(const test_name &test, output_stream stream,
+                           std::string_view data) override {
+      begin_test(frame::event_type::output_chunk, test);
+      w.u64(static_cast<std::uint64_t>(stream));
+      w.str(data);
+      // As in `child`, send output right away.
+      send_frame(true);
+    }
+  private:
+    // Start an event for `test`, first defining its suites and file if we
+    // haven't sent them yet.
+    void begin_test(frame::event_type type, const test_name &test) {
+      auto [suites_id, new_suites] = names.suites(test.suites);
+      if(new_suites) {
+        w.begin(frame::event_type::define_suites);
+        w.u64(suites_id);
+        w.suites(test.suites);
+        append_frame();
+      }
+
+      auto [file_id, new_file] = names.file(test.file);
+      if(new_file) {
+        w.begin(frame::event_type::define_file);
+        w.u64(file_id);
+        w.str(test.file);
+        append_frame();
+      }
+
+      w.begin(type);
+      w.test(test, suites_id, file_id);
+    }
+
+    void append_frame() {
+      auto &data = w.end();
+      pending.write(data.data(), data.size());
+    }
+
+    void send_frame(bool urgent = false) {
+      append_frame();
+      send(urgent);
+    }
 
-    std::ostream &out;
+    frame::writer w;
+    frame::interner names;
   };
 
 } // namespace mettle::log
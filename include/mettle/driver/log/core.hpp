@@ -2,7 +2,11 @@
 #define INC_METTLE_DRIVER_LOG_CORE_HPP
 
 #include <chrono>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "../test_name.hpp"
@@ -10,16 +14,60 @@
 
 namespace mettle::log {
 
+  // The resources a test's process used, as reported by the kernel.
+  struct test_resources {
+    std::chrono::microseconds user_time{0}, system_time{0};
+    // The peak resident set size, in bytes.
+    std::uint64_t max_rss = 0;
+    std::uint64_t minor_faults = 0, major_faults = 0;
+    std::uint64_t voluntary_switches = 0, involuntary_switches = 0;
+
+    std::chrono::microseconds cpu_time() const {
+      return user_time + system_time;
+    }
+  };
+
   struct test_output {
     std::string stdout_log, stderr_log;
+    // The number of bytes dropped from the middle of each log when it was
+    // longer than the capture limit (see `elide_log`).
+    std::size_t stdout_elided = 0, stderr_elided = 0;
+    // Only set when the test ran in a subprocess that we could measure.
+    std::optional<test_resources> resources = std::nullopt;
 
     bool empty() const {
       return stdout_log.empty() && stderr_log.empty();
     }
   };
 
+  // Drop bytes from the middle of `log` so that it's no longer than `limit`,
+  // keeping its first `limit - limit / 2` and last `limit / 2` bytes, and add
+  // the number of bytes dropped to `elided`. Since the beginning of the log is
+  // always kept, this can be called repeatedly as the log grows.
+  inline void elide_log(std::string &log, std::size_t &elided,
+                        std::size_t limit) {
+    if(log.size() <= limit)
+      return;
+    std::size_t head = limit - limit / 2, dropped = log.size() - limit;
+    log.erase(head, dropped);
+    elided += dropped;
+  }
+
+  // Split a log into the parts before and after the bytes `elide_log` dropped
+  // from it.
+  inline std::pair<std::string_view, std::string_view>
+  split_elided(std::string_view log, std::size_t elided) {
+    std::size_t head = elided ? log.size() - log.size() / 2 : log.size();
+    return {log.substr(0, head), log.substr(head)};
+  }
+
   using test_duration = std::chrono::milliseconds;
 
+  enum class output_stream {
+    stdout_log,
+    stderr_log
+  };
+
   class METTLE_PUBLIC test_logger {
   public:
     virtual ~test_logger() {}
@@ -44,6 +92,13 @@ namespace mettle::log {
                 const test_output &output, test_duration duration) = 0;
     virtual void
     skipped_test(const test_name &test, const std::string &message) = 0;
+
+    // Called with each chunk of a test's output as the test writes it, if
+    // output streaming is enabled. Loggers don't have to handle this: the full
+    // output is still passed to `passed_test` or `failed_test`. When tests run
+    // in parallel, a test's chunks may arrive before its `started_test`.
+    virtual void
+    test_output_chunk(const test_name &, output_stream, std::string_view) {}
   };
 
   class METTLE_PUBLIC file_logger : public test_logger {
@@ -0,0 +1,283 @@
+#ifndef INC_METTLE_DRIVER_LOG_FRAME_HPP
+#define INC_METTLE_DRIVER_LOG_FRAME_HPP
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core.hpp"
+#include "../../suite/attributes.hpp"
+
+namespace mettle::log {
+
+  // The format a test binary uses to send events to its parent (the `mettle`
+  // driver) over `--output-fd`.
+  enum class child_protocol {
+    bencode,
+    binary
+  };
+
+  // The `mettle` driver sets this environment variable to the name of the
+  // best protocol it can read, instead of passing `--output-protocol`, so
+  // that test binaries built against an older mettle (which would reject the
+  // option) still run and just keep sending bencode.
+  inline constexpr const char *protocol_env = "METTLE_OUTPUT_PROTOCOL";
+
+} // namespace mettle::log
+
+// A compact binary alternative to bencode for a child's events. Each frame is
+// a fixed-size header (a marker byte, which can never begin a bencoded event,
+// followed by the event type and the size of the payload) and then the
+// payload itself: little-endian integers and length-prefixed strings, in a
+// fixed order for each event type. This lets the parent read events directly
+// into their final form without decoding a generic data structure first.
+//
+// Tests refer to their suites and file by ID. Each ID is defined by a
+// `define_suites` or `define_file` frame the first time it's used, and IDs
+// count up from 0.
+namespace mettle::log::frame {
+
+  constexpr char marker = '\xf0';
+  constexpr std::size_t header_size = 6;
+
+  enum class event_type : std::uint8_t {
+    started_run = 1,
+    ended_run,
+    started_suite,
+    ended_suite,
+    started_test,
+    passed_test,
+    failed_test,
+    skipped_test,
+    failed_file,
+    define_suites,
+    define_file,
+    output_chunk,
+    listed_test
+  };
+
+  class writer {
+  public:
+    void begin(event_type type) {
+      data_.assign(header_size, '\0');
+      data_[0] = marker;
+      data_[1] = static_cast<char>(type);
+    }
+
+    const std::string & end() {
+      auto size = size32(data_.size() - header_size);
+      for(int i = 0; i != 4; i++)
+        data_[2 + i] = static_cast<char>(size >> (i * 8));
+      return data_;
+    }
+
+    void u64(std::uint64_t value) {
+      for(int i = 0; i != 8; i++)
+        data_.push_back(static_cast<char>(value >> (i * 8)));
+    }
+
+    void str(std::string_view value) {
+      auto size = size32(value.size());
+      for(int i = 0; i != 4; i++)
+        data_.push_back(static_cast<char>(size >> (i * 8)));
+      data_ += value;
+    }
+
+    void suites(const std::vector<std::string> &value) {
+      u64(value.size());
+      for(const auto &i : value)
+        str(i);
+    }
+
+    void test(const test_name &value, std::uint64_t suites_id,
+              std::uint64_t file_id) {
+      u64(value.id);
+      u64(suites_id);
+      str(value.name);
+      u64(file_id);
+      u64(static_cast<std::uint64_t>(value.line));
+    }
+
+    void attrs(const attributes &value) {
+      u64(value.size());
+      for(const auto &i : value) {
+        str(i.attribute().name());
+        u64(i.value.size());
+        for(const auto &v : i.value)
+          str(v);
+      }
+    }
+
+    void output(const test_output &value) {
+      str(value.stdout_log);
+      str(value.stderr_log);
+      u64(value.stdout_elided);
+      u64(value.stderr_elided);
+      u64(value.resources.has_value());
+      if(value.resources) {
+        auto &r = *value.resources;
+        u64(static_cast<std::uint64_t>(r.user_time.count()));
+        u64(static_cast<std::uint64_t>(r.system_time.count()));
+        u64(r.max_rss);
+        u64(r.minor_faults);
+        u64(r.major_faults);
+        u64(r.voluntary_switches);
+        u64(r.involuntary_switches);
+      }
+    }
+  private:
+    // Sizes are sent as 32-bit integers, so refuse to send anything bigger
+    // rather than silently corrupting the frame.
+    static std::uint32_t size32(std::size_t size) {
+      if(size > std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("event too large to send");
+      return static_cast<std::uint32_t>(size);
+    }
+
+    std::string data_;
+  };
+
+  class reader {
+  public:
+    reader(std::string_view data) : data_(data) {}
+
+    std::uint64_t u64() {
+      auto bytes = take(8);
+      std::uint64_t value = 0;
+      for(int i = 0; i != 8; i++)
+        value |= std::uint64_t(std::uint8_t(bytes[i])) << (i * 8);
+      return value;
+    }
+
+    std::string str() {
+      auto bytes = take(4);
+      std::uint32_t size = 0;
+      for(int i = 0; i != 4; i++)
+        size |= std::uint32_t(std::uint8_t(bytes[i])) << (i * 8);
+      return std::string(take(size));
+    }
+
+    std::vector<std::string> suites() {
+      std::vector<std::string> value;
+      for(auto count = u64(); count != 0; count--)
+        value.push_back(str());
+      return value;
+    }
+
+    test_output output() {
+      test_output value;
+      value.stdout_log = str();
+      value.stderr_log = str();
+      value.stdout_elided = u64();
+      value.stderr_elided = u64();
+      if(u64()) {
+        auto &r = value.resources.emplace();
+        r.user_time = std::chrono::microseconds(u64());
+        r.system_time = std::chrono::microseconds(u64());
+        r.max_rss = u64();
+        r.minor_faults = u64();
+        r.major_faults = u64();
+        r.voluntary_switches = u64();
+        r.involuntary_switches = u64();
+      }
+      return value;
+    }
+  private:
+    std::string_view take(std::size_t size) {
+      if(data_.size() < size)
+        throw std::runtime_error("unexpected end of event");
+      auto value = data_.substr(0, size);
+      data_.remove_prefix(size);
+      return value;
+    }
+
+    std::string_view data_;
+  };
+
+  // Assigns IDs to the suite paths and files of the tests a child sends.
+  class interner {
+  public:
+    // Get the ID of `value`, and whether this is the first time we've seen it
+    // (and so it needs to be defined).
+    std::pair<std::uint64_t, bool> suites(const suite_path &value) {
+      // Tests in the same suite usually share their path, so check that first.
+      if(last_suites_ && value == *last_suites_)
+        return {last_suites_id_, false};
+
+      auto [i, added] = suites_.emplace(value.get(), suites_.size());
+      last_suites_ = value;
+      last_suites_id_ = i->second;
+      return {i->second, added};
+    }
+
+    std::pair<std::uint64_t, bool> file(const std::string &value) {
+      auto [i, added] = files_.emplace(value, files_.size());
+      return {i->second, added};
+    }
+  private:
+    std::map<std::vector<std::string>, std::uint64_t> suites_;
+    std::unordered_map<std::string, std::uint64_t> files_;
+    std::optional<suite_path> last_suites_;
+    std::uint64_t last_suites_id_ = 0;
+  };
+
+  // The parent's side of `interner`: the suite paths and files defined so far.
+  // Suite paths are shared by every test that refers to them.
+  class name_table {
+  public:
+    void define_suites(std::uint64_t id, std::vector<std::string> value) {
+      if(id != suites_.size())
+        throw std::runtime_error("invalid suites id");
+      suites_.emplace_back(std::move(value));
+    }
+
+    void define_file(std::uint64_t id, std::string value) {
+      if(id != files_.size())
+        throw std::runtime_error("invalid file id");
+      files_.push_back(std::move(value));
+    }
+
+    const suite_path & suites(std::uint64_t id) const {
+      if(id >= suites_.size())
+        throw std::runtime_error("unknown suites id");
+      return suites_[id];
+    }
+
+    const std::string & file(std::uint64_t id) const {
+      if(id >= files_.size())
+        throw std::runtime_error("unknown file id");
+      return files_[id];
+    }
+  private:
+    std::vector<suite_path> suites_;
+    std::vector<std::string> files_;
+  };
+
+  // Get the type and payload size from a frame's header.
+  inline std::pair<event_type, std::uint32_t>
+  read_header(std::string_view header) {
+    std::uint32_t size = 0;
+    for(int i = 0; i != 4; i++)
+      size |= std::uint32_t(std::uint8_t(header[2 + i])) << (i * 8);
+    return {static_cast<event_type>(header[1]), size};
+  }
+
+  // Get the size of the frame at the start of `data`, or 0 if it's still
+  // incomplete.
+  inline std::size_t frame_size(std::string_view data) {
+    if(data.size() < header_size)
+      return 0;
+    std::size_t size = header_size + read_header(data).second;
+    return data.size() < size ? 0 : size;
+  }
+
+} // namespace mettle::log::frame
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef INC_METTLE_DRIVER_LOG_HISTORY_HPP
+#define INC_METTLE_DRIVER_LOG_HISTORY_HPP
+
+#include <memory>
+
+#include "core.hpp"
+#include "../test_history.hpp"
+#include "../detail/export.hpp"
+
+// Ignore warnings from MSVC about DLL interfaces.
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(push)
+#  pragma warning(disable:4251)
+#endif
+
+namespace mettle::log {
+
+  // Records the duration and outcome of each test (and test file) into a
+  // `test_history`, forwarding all events on to another logger.
+  class METTLE_PUBLIC history : public file_logger {
+  public:
+    history(test_history &history, std::unique_ptr<file_logger> &&log);
+
+    void started_run() override;
+    void ended_run() override;
+
+    void started_suite(const std::vector<std::string> &suites) override;
+    void ended_suite(const std::vector<std::string> &suites) override;
+
+    void started_test(const test_name &test) override;
+    void passed_test(const test_name &test, const test_output &output,
+                     test_duration duration) override;
+    void failed_test(const test_name &test, const std::string &message,
+                     const test_output &output,
+                     test_duration duration) override;
+    void skipped_test(const test_name &test,
+                      const std::string &message) override;
+    void test_output_chunk(const test_name &test, output_stream stream,
+                           std::string_view data) override;
+
+    void started_file(const test_file &file) override;
+    void ended_file(const test_file &file) override;
+    void failed_file(const test_file &file,
+                     const std::string &message) override;
+  private:
+    test_history &history_;
+    std::unique_ptr<file_logger> log_;
+    test_duration file_duration_{0};
+    bool file_passed_ = true;
+  };
+
+} // namespace mettle::log
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(pop)
+#endif
+
+#endif
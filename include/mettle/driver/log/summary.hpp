@@ -39,6 +39,8 @@ namespace mettle::log {
                      test_duration duration) override;
     void skipped_test(const test_name &test,
                       const std::string &message) override;
+    void test_output_chunk(const test_name &test, output_stream stream,
+                           std::string_view data) override;
 
     void started_file(const test_file &file) override;
     void ended_file(const test_file &file) override;
@@ -2,6 +2,7 @@
 #define INC_METTLE_DRIVER_LOG_VERBOSE_HPP
 
 #include <cstdint>
+#include <optional>
 
 #include "core.hpp"
 #include "indent.hpp"
@@ -34,6 +35,8 @@ namespace mettle::log {
                      test_duration duration) override;
     void skipped_test(const test_name &test,
                       const std::string &message) override;
+    void test_output_chunk(const test_name &test, output_stream stream,
+                           std::string_view data) override;
 
     void started_file(const test_file &file) override;
     void ended_file(const test_file &file) override;
@@ -41,7 +44,8 @@ namespace mettle::log {
     void failed_file(const test_file &file,
                      const std::string &message) override;
   private:
-    void log_time(test_duration duration) const;
+    bool end_stream(const test_name &test);
+    void log_time(test_duration duration, const test_output &output) const;
     void summarize_output(const test_output &output) const;
     void log_output(const test_output &output, bool extra_newline) const;
 
@@ -49,6 +53,8 @@ namespace mettle::log {
     indenter indent_, run_indent_;
     std::size_t total_runs_, run_ = 0;
     bool first_ = true, show_time_, show_terminal_;
+    std::optional<test_uid> current_test_;
+    bool streamed_ = false, stream_newline_ = false;
   };
 
 } // namespace mettle::log
@@ -0,0 +1,79 @@
+#ifndef INC_METTLE_DRIVER_POSIX_CHILD_MONITOR_HPP
+#define INC_METTLE_DRIVER_POSIX_CHILD_MONITOR_HPP
+
+#include <signal.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <map>
+#include <vector>
+
+namespace mettle::posix {
+
+  // Wait for any of a set of file descriptors to become readable or any of a
+  // set of child processes to exit. On Linux, this uses epoll and pidfds, so
+  // there's no limit on the number of fds and no need for SIGCHLD. Elsewhere
+  // (or if pidfds aren't supported), it falls back to pselect(2), and callers
+  // should block SIGCHLD and unblock it via `sigmask` so that child exits
+  // interrupt the wait.
+  class child_monitor {
+  public:
+    enum class event_type {
+      readable,
+      exited
+    };
+
+    struct event {
+      event_type type;
+      void *data;
+    };
+
+    child_monitor() = default;
+    child_monitor(const child_monitor &) = delete;
+    child_monitor & operator =(const child_monitor &) = delete;
+
+    ~child_monitor() {
+      close();
+    }
+
+    int open();
+    int close();
+
+    bool is_open() const {
+      return open_;
+    }
+
+    int watch_fd(int fd, void *data);
+    int unwatch_fd(int fd);
+
+    int watch_child(pid_t pid, void *data);
+    int unwatch_child(pid_t pid);
+
+    // Wait until at least one event occurs, the timeout elapses, or we're
+    // interrupted by a signal. Returns the number of events, or -1 on error.
+    int wait(std::vector<event> &events, const timespec *timeout,
+             const sigset_t *sigmask);
+  private:
+    struct watch {
+      event_type type;
+      pid_t pid;
+      void *data;
+    };
+
+    struct polled_child {
+      pid_t pid;
+      void *data;
+    };
+
+    int add(int fd, const watch &w);
+    int remove(int fd);
+
+    bool open_ = false;
+    int epoll_fd_ = -1;
+    std::map<int, watch> watches_;
+    std::vector<polled_child> polled_children_;
+  };
+
+} // namespace mettle::posix
+
+#endif
@@ -2,23 +2,50 @@
 #define INC_METTLE_DRIVER_POSIX_SUBPROCESS_HPP
 
 #include <signal.h>
+#include <time.h>
 
 #include <chrono>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "child_monitor.hpp"
+
 namespace mettle::posix {
 
   struct readfd {
     int fd;
     std::string *dest;
+    // If `limit` is non-zero, only keep the beginning and end of what we read,
+    // counting the bytes dropped in `elided` (see `log::elide_log`).
+    std::size_t limit = 0;
+    std::size_t *elided = nullptr;
+    // If set, called with each chunk as it's read.
+    std::function<void(std::string_view)> on_chunk = nullptr;
   };
 
-  void make_timeout_monitor(std::chrono::milliseconds timeout);
+  timespec to_timespec(std::chrono::nanoseconds duration);
 
+  // Read from each fd into its destination until they've all been closed, the
+  // timeout (measured across the whole call) elapses, or we're interrupted by
+  // a signal.
   int read_into(std::vector<readfd> &dests, const timespec *timeout,
                 const sigset_t *sigmask);
 
+  // As above, but use an already-open `monitor`, which mustn't be watching
+  // any of `dests`, rather than opening a new one for each call.
+  int read_into(std::vector<readfd> &dests, child_monitor &monitor,
+                const timespec *timeout, const sigset_t *sigmask);
+
+  // Read one chunk from a readable fd into its destination. If the fd has been
+  // closed, stop watching it and mark it as closed. A limited destination may
+  // hold up to twice its limit, so call `finish_read` once we're done.
+  int read_chunk(readfd &src, child_monitor &monitor);
+
+  // Trim a limited destination down to its limit.
+  void finish_read(readfd &src);
+
   int send_pgid(int fd, int pgid);
   int recv_pgid(int fd, int *pgid);
 
@@ -0,0 +1,43 @@
+#ifndef INC_METTLE_DRIVER_RESOURCE_LIMITS_HPP
+#define INC_METTLE_DRIVER_RESOURCE_LIMITS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "../suite/attributes.hpp"
+#include "detail/export.hpp"
+
+namespace mettle {
+
+  // The most memory and CPU time a test may use before it's killed. These can
+  // be set for every test on the command line, or for a single test (or
+  // suite) with the `limit::max_rss` and `limit::cpu_time` attributes.
+  struct resource_limits {
+    // On POSIX systems, this limits the size of the test's address space,
+    // which is always at least as large as its resident set.
+    std::optional<std::uint64_t> max_rss;
+    std::optional<std::chrono::seconds> cpu_time;
+
+    bool empty() const {
+      return !max_rss && !cpu_time;
+    }
+  };
+
+  // Parse a size in bytes with an optional binary suffix, e.g. "512M".
+  METTLE_PUBLIC std::uint64_t parse_memory_size(const std::string &value);
+
+  // Parse a number of seconds with an optional unit, e.g. "30s" or "2m".
+  METTLE_PUBLIC std::chrono::seconds parse_cpu_time(const std::string &value);
+
+  METTLE_PUBLIC std::string format_memory_size(std::uint64_t bytes);
+
+  // Get the limits for a test with the attributes `attrs`, which take
+  // precedence over `defaults`.
+  METTLE_PUBLIC resource_limits
+  get_resource_limits(const attributes &attrs, resource_limits defaults);
+
+} // namespace mettle
+
+#endif
@@ -1,8 +1,19 @@
 #ifndef INC_METTLE_DRIVER_RUN_TESTS_HPP
 #define INC_METTLE_DRIVER_RUN_TESTS_HPP
 
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "../suite/compiled_suite.hpp"
 #include "filters_core.hpp"
+#include "test_index.hpp"
 #include "log/core.hpp"
 
 namespace mettle {
@@ -11,100 +22,368 @@ namespace mettle {
     test_result(const test_info &, log::test_output &)
   >;
 
+  // A pool of test runners that can execute several tests at once. `start`
+  // may block until there's room for another test, and the callback is invoked
+  // (from `start` or `wait`) once the test has finished.
+  class METTLE_PUBLIC test_pool {
+  public:
+    using callback_type = std::function<
+      void(test_result, log::test_output, log::test_duration)
+    >;
+    using chunk_callback_type = std::function<
+      void(log::output_stream, std::string_view)
+    >;
+
+    virtual ~test_pool() {}
+
+    virtual void start(const test_info &test, callback_type done) = 0;
+    virtual void wait() = 0;
+
+    // Like `start`, but also pass each chunk of the test's output to `chunk`
+    // as it's written. Pools that can't stream output can ignore `chunk`.
+    virtual void start(const test_info &test, callback_type done,
+                       chunk_callback_type) {
+      start(test, std::move(done));
+    }
+
+    // Stop any running tests and drop any that haven't started yet; their
+    // callbacks won't be invoked. This may be called from a callback. Pools
+    // that can't stop early can just let their tests finish.
+    virtual void cancel() {}
+  };
+
+  // Counts test failures so that a run (or several) can be cancelled once
+  // there have been too many.
+  class failure_limit {
+  public:
+    explicit failure_limit(std::size_t limit) : limit_(limit) {}
+
+    void add_failure() {
+      failures_++;
+    }
+
+    bool reached() const {
+      return failures_ >= limit_;
+    }
+
+    std::size_t limit() const {
+      return limit_;
+    }
+
+    std::size_t remaining() const {
+      return reached() ? 0 : limit_ - failures_;
+    }
+
+    std::string cancelled_message() const {
+      return "Cancelled after " + std::to_string(limit_) +
+             (limit_ == 1 ? " failure" : " failures");
+    }
+  private:
+    std::size_t limit_, failures_ = 0;
+  };
+
+  enum class report_order {
+    suite,
+    completion
+  };
+
+  // How a test subprocess's stdout and stderr are captured: `pipe` reads them
+  // as the test runs, while `file` points them at an anonymous file (a memfd,
+  // where available) that's mapped into memory once the test is done, so the
+  // parent doesn't have to wake up and copy each chunk of output as it's
+  // written.
+  enum class output_capture {
+    pipe,
+    file
+  };
+
+  // Estimates how long a test will take to run (e.g. from a previous run), so
+  // that parallel runs can start the slowest tests first.
+  using test_estimator = std::function<
+    std::optional<log::test_duration>(const test_name &)
+  >;
+
   namespace detail {
 
-    class suite_stack {
+    // Reorders the events of tests run in parallel so that the wrapped logger
+    // sees a well-formed stream. In suite order, events are held until every
+    // test before them has finished; in completion order, each test is
+    // reported as soon as it finishes, (re-)opening its suites as needed.
+    class test_sequencer : public log::test_logger {
     public:
-      using value_type = std::vector<std::string>;
+      test_sequencer(log::test_logger &logger, report_order order)
+        : logger_(logger), order_(order) {}
 
-      template<typename T>
-      void push(T &&t) {
-        queued_.push_back(std::forward<T>(t));
+      void started_run() override {
+        logger_.started_run();
+      }
+      void ended_run() override {
+        assert(queue_.empty() && "tests still pending");
+        if(order_ == report_order::completion)
+          switch_suites({});
+        logger_.ended_run();
       }
 
-      void pop() {
-        if(!queued_.empty())
-          queued_.pop_back();
-        else
-          committed_.pop_back();
+      void started_suite(const std::vector<std::string> &suites) override {
+        if(order_ == report_order::suite) {
+          enqueue([suites](log::test_logger &logger) {
+            logger.started_suite(suites);
+          });
+        }
+      }
+      void ended_suite(const std::vector<std::string> &suites) override {
+        if(order_ == report_order::suite) {
+          enqueue([suites](log::test_logger &logger) {
+            logger.ended_suite(suites);
+          });
+        }
       }
 
-      template<typename T>
-      void commit(T &&callback) {
-        if(!queued_.empty()) {
-          for(auto &&i : queued_) {
-            committed_.push_back(std::move(i));
-            callback(committed_);
-          }
-          queued_.clear();
+      void started_test(const test_name &test) override {
+        if(order_ == report_order::suite) {
+          enqueue([test](log::test_logger &logger) {
+            logger.started_test(test);
+          });
         }
       }
+      void passed_test(const test_name &test, const log::test_output &output,
+                       log::test_duration duration) override {
+        enqueue([test, output, duration](log::test_logger &logger) {
+          logger.passed_test(test, output, duration);
+        }, test);
+      }
+      void failed_test(const test_name &test, const std::string &message,
+                       const log::test_output &output,
+                       log::test_duration duration) override {
+        enqueue([test, message, output, duration](log::test_logger &logger) {
+          logger.failed_test(test, message, output, duration);
+        }, test);
+      }
+      void skipped_test(const test_name &test,
+                        const std::string &message) override {
+        enqueue([test, message](log::test_logger &logger) {
+          logger.skipped_test(test, message);
+        }, test);
+      }
 
-      const value_type committed() const {
-        return committed_;
+      // Chunks are passed along right away, since holding them until the
+      // test's turn would mean buffering all of its output.
+      void test_output_chunk(const test_name &test, log::output_stream stream,
+                             std::string_view data) override {
+        logger_.test_output_chunk(test, stream, data);
       }
 
-      value_type all() const {
-        value_type all = committed_;
-        all.insert(all.end(), queued_.begin(), queued_.end());
-        return all;
+      std::size_t pending_test(const test_name &test) {
+        queue_.push_back({test, nullptr});
+        return popped_ + queue_.size() - 1;
       }
 
-      bool has_queued() const {
-        return !queued_.empty();
+      void finished_test(std::size_t slot, test_result result,
+                         log::test_output output, log::test_duration duration) {
+        assert(slot >= popped_ && slot - popped_ < queue_.size());
+        auto &entry = queue_[slot - popped_];
+
+        if(order_ == report_order::completion) {
+          emit_test(entry.test, [&](log::test_logger &logger) {
+            log_result(logger, entry.test, result, output, duration);
+          });
+          entry.event = [](log::test_logger &) {};
+        } else {
+          entry.event = [test = std::move(entry.test),
+                         result = std::move(result),
+                         output = std::move(output), duration](
+            log::test_logger &logger
+          ) {
+            log_result(logger, test, result, output, duration);
+          };
+        }
+        flush();
+      }
+
+      // Report every test that hasn't finished as skipped, e.g. because the
+      // run was cancelled before it could start.
+      void skip_pending(const std::string &message) {
+        for(auto &entry : queue_) {
+          if(entry.event)
+            continue;
+
+          if(order_ == report_order::completion) {
+            emit_test(entry.test, [&](log::test_logger &logger) {
+              logger.skipped_test(entry.test, message);
+            });
+            entry.event = [](log::test_logger &) {};
+          } else {
+            entry.event = [test = std::move(entry.test), message](
+              log::test_logger &logger
+            ) {
+              logger.skipped_test(test, message);
+            };
+          }
+        }
+        flush();
       }
     private:
-      value_type committed_, queued_;
+      using event_type = std::function<void(log::test_logger &)>;
+
+      struct entry {
+        test_name test;
+        event_type event;
+      };
+
+      static void log_result(
+        log::test_logger &logger, const test_name &test,
+        const test_result &result, const log::test_output &output,
+        log::test_duration duration
+      ) {
+        if(result.passed)
+          logger.passed_test(test, output, duration);
+        else
+          logger.failed_test(test, result.message, output, duration);
+      }
+
+      template<typename F>
+      void enqueue(F &&f) {
+        if(queue_.empty())
+          f(logger_);
+        else
+          queue_.push_back({{}, std::forward<F>(f)});
+      }
+
+      template<typename F>
+      void enqueue(F &&f, const test_name &test) {
+        if(order_ == report_order::completion)
+          emit_test(test, f);
+        else
+          enqueue(std::forward<F>(f));
+      }
+
+      template<typename F>
+      void emit_test(const test_name &test, F &&f) {
+        switch_suites(test.suites);
+        logger_.started_test(test);
+        f(logger_);
+      }
+
+      void switch_suites(const std::vector<std::string> &suites) {
+        std::size_t common = 0;
+        while(common != open_.size() && common != suites.size() &&
+              open_[common] == suites[common])
+          common++;
+
+        while(open_.size() != common) {
+          logger_.ended_suite(open_);
+          open_.pop_back();
+        }
+        while(open_.size() != suites.size()) {
+          open_.push_back(suites[open_.size()]);
+          logger_.started_suite(open_);
+        }
+      }
+
+      void flush() {
+        while(!queue_.empty() && queue_.front().event) {
+          auto event = std::move(queue_.front().event);
+          queue_.pop_front();
+          popped_++;
+          event(logger_);
+        }
+      }
+
+      log::test_logger &logger_;
+      report_order order_;
+      std::deque<entry> queue_;
+      std::size_t popped_ = 0;
+      std::vector<std::string> open_;
     };
 
-    template<typename Suites, typename Filter>
+    // Return the indices of `estimates` in the order they should be started
+    // to minimize the total time of a parallel run: longest first. Items with
+    // no estimate might be slow too, so they go before everything else, in
+    // their original order.
+    inline std::vector<std::size_t> longest_first(
+      const std::vector<std::optional<log::test_duration>> &estimates
+    ) {
+      std::vector<std::size_t> order(estimates.size());
+      for(std::size_t i = 0; i != order.size(); i++)
+        order[i] = i;
+
+      std::stable_sort(order.begin(), order.end(), [&estimates](
+        std::size_t lhs, std::size_t rhs
+      ) {
+        const auto &l = estimates[lhs], &r = estimates[rhs];
+        if(!l || !r)
+          return !l && r;
+        return *l > *r;
+      });
+      return order;
+    }
+
+    template<typename Suite, typename Filter, typename Run>
     void run_tests_impl(
-      const Suites &suites, log::test_logger &logger, const test_runner &runner,
-      const Filter &filter, suite_stack &parents
+      const basic_test_index<Suite> &index, log::test_logger &logger,
+      const Run &run, const Filter &filter
     ) {
-      for(const auto &suite : suites) {
-        parents.push(suite.name());
+      const auto &suites = index.suites();
+      const auto &tests = index.tests();
 
-        for(const auto &test : suite.tests()) {
-          const test_name name = {parents.all(), test.name, test.id,
-                                  test.loc.file_name(), test.loc.line()};
-          auto action = filter(name, test.attrs);
+      // The suites containing the current one, and how many of them have been
+      // reported as started. A suite is only started once we find a test in
+      // it (or one of its subsuites) that isn't hidden.
+      std::vector<std::size_t> open;
+      std::size_t started = 0;
+      auto close = [&]() {
+        if(started == open.size()) {
+          logger.ended_suite(suites[open.back()].path);
+          started--;
+        }
+        open.pop_back();
+      };
+
+      for(std::size_t i = 0; i != suites.size(); i++) {
+        while(!open.empty() && suites[open.back()].subsuites_end <= i)
+          close();
+
+        // Skip the whole suite if the filter can tell that it'd hide
+        // every test in it.
+        if(index.hides_suite(filter, i)) {
+          i = suites[i].subsuites_end - 1;
+          continue;
+        }
+        open.push_back(i);
+
+        for(auto t = suites[i].tests_begin; t != suites[i].tests_end; t++) {
+          const auto &test = tests[t];
+          auto action = filter_test(filter, test.name, test.full_name,
+                                    test.info->attrs);
           if(action.action == test_action::indeterminate)
-            action = filter_by_attr(test.attrs);
+            action = filter_by_attr(test.info->attrs);
 
           if(action.action == test_action::hide)
             continue;
-          parents.commit([&logger](const auto &committed) {
-            logger.started_suite(committed);
-          });
+          for(; started != open.size(); started++)
+            logger.started_suite(suites[open[started]].path);
 
-          logger.started_test(name);
+          logger.started_test(test.name);
 
           if(action.action == test_action::skip) {
-            logger.skipped_test(name, action.message);
+            logger.skipped_test(test.name, action.message);
             continue;
           }
 
-          log::test_output output;
-
-          using namespace std::chrono;
-          auto then = steady_clock::now();
-          auto result = runner(test, output);
-          auto now = steady_clock::now();
-          auto duration = duration_cast<log::test_duration>(now - then);
-
-          if(result.passed)
-            logger.passed_test(name, output, duration);
-          else
-            logger.failed_test(name, result.message, output, duration);
+          run(*test.info, test.name);
         }
+      }
 
-        run_tests_impl(suite.subsuites(), logger, runner, filter, parents);
+      while(!open.empty())
+        close();
+    }
 
-        if(!parents.has_queued())
-          logger.ended_suite(parents.committed());
-        parents.pop();
-      }
+    template<typename Suites, typename Filter, typename Run>
+    void run_tests_impl(
+      const Suites &suites, log::test_logger &logger, const Run &run,
+      const Filter &filter
+    ) {
+      run_tests_impl(make_test_index(suites), logger, run, filter);
     }
 
   } // namespace detail
@@ -114,19 +393,136 @@ namespace mettle {
     return test.function();
   }
 
+  // If `fail_fast` is set, stop running tests once its limit is reached and
+  // report the rest as skipped.
   template<typename Suites, typename Filter>
   void run_tests(const Suites &suites, log::test_logger &logger,
-                 const test_runner &runner, const Filter &filter) {
-    detail::suite_stack parents;
+                 const test_runner &runner, const Filter &filter,
+                 failure_limit *fail_fast = nullptr) {
     logger.started_run();
-    detail::run_tests_impl(suites, logger, runner, filter, parents);
+    detail::run_tests_impl(
+      suites, logger, [&logger, &runner, fail_fast](const test_info &test,
+                                                    const test_name &name) {
+        if(fail_fast && fail_fast->reached()) {
+          logger.skipped_test(name, fail_fast->cancelled_message());
+          return;
+        }
+
+        log::test_output output;
+
+        using namespace std::chrono;
+        auto then = steady_clock::now();
+        auto result = runner(test, output);
+        auto now = steady_clock::now();
+        auto duration = duration_cast<log::test_duration>(now - then);
+
+        if(result.passed) {
+          logger.passed_test(name, output, duration);
+        } else {
+          logger.failed_test(name, result.message, output, duration);
+          if(fail_fast)
+            fail_fast->add_failure();
+        }
+      }, filter
+    );
     logger.ended_run();
   }
 
+  // If `stream_output` is set, each chunk of a test's output is passed to
+  // the logger's `test_output_chunk` as it's written (if the pool supports
+  // it).
+  template<typename Suites, typename Filter>
+  void run_tests(const Suites &suites, log::test_logger &logger,
+                 test_pool &pool, const Filter &filter,
+                 report_order order = report_order::suite,
+                 const test_estimator &estimate = nullptr,
+                 failure_limit *fail_fast = nullptr,
+                 bool stream_output = false) {
+    detail::test_sequencer sequencer(logger, order);
+
+    // Once we've hit the failure limit, stop starting tests and cancel the
+    // ones in progress. Any that haven't finished are reported as skipped at
+    // the end.
+    auto start = [&sequencer, &pool, fail_fast, stream_output](
+      const test_info &test, const test_name &name, std::size_t slot
+    ) {
+      if(fail_fast && fail_fast->reached())
+        return;
+
+      auto done = [&sequencer, &pool, fail_fast, slot](
+        test_result result, log::test_output output,
+        log::test_duration duration
+      ) {
+        bool failed = !result.passed;
+        sequencer.finished_test(slot, std::move(result), std::move(output),
+                                duration);
+        if(failed && fail_fast) {
+          fail_fast->add_failure();
+          if(fail_fast->reached())
+            pool.cancel();
+        }
+      };
+
+      if(!stream_output) {
+        pool.start(test, std::move(done));
+        return;
+      }
+      pool.start(test, std::move(done), [&sequencer, name](
+        log::output_stream stream, std::string_view data
+      ) {
+        sequencer.test_output_chunk(name, stream, data);
+      });
+    };
+
+    // Without estimates, just start each test as we find it. Otherwise, find
+    // every test first so we can start them longest-first. Either way, the
+    // sequencer reports them in the order they were found.
+    struct pending {
+      const test_info *test;
+      test_name name;
+      std::size_t slot;
+    };
+    std::vector<pending> tests;
+    std::vector<std::optional<log::test_duration>> estimates;
+
+    sequencer.started_run();
+    detail::run_tests_impl(
+      suites, sequencer, [&](const test_info &test, const test_name &name) {
+        auto slot = sequencer.pending_test(name);
+        if(!estimate) {
+          start(test, name, slot);
+        } else {
+          tests.push_back({&test, name, slot});
+          estimates.push_back(estimate(name));
+        }
+      }, filter
+    );
+
+    for(auto i : detail::longest_first(estimates))
+      start(*tests[i].test, tests[i].name, tests[i].slot);
+
+    pool.wait();
+    if(fail_fast && fail_fast->reached())
+      sequencer.skip_pending(fail_fast->cancelled_message());
+    sequencer.ended_run();
+  }
+
+  template<typename Suites, typename Filter>
+  inline void run_tests(const Suites &suites, log::test_logger &&logger,
+                        test_pool &pool, const Filter &filter,
+                        report_order order = report_order::suite,
+                        const test_estimator &estimate = nullptr,
+                        failure_limit *fail_fast = nullptr,
+                        bool stream_output = false) {
+    run_tests(suites, logger, pool, filter, order, estimate, fail_fast,
+              stream_output);
+  }
+
   template<typename Suites, typename Filter>
   inline void run_tests(const Suites &suites, log::test_logger &&logger,
-                        const test_runner &runner, const Filter &filter) {
-    run_tests(suites, logger, runner, filter);
+                        const test_runner &runner, const Filter &filter,
+                        failure_limit *fail_fast = nullptr) {
+    run_tests(suites, logger, runner, filter, fail_fast);
   }
 
   template<typename Suites>
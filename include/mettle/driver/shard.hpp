@@ -0,0 +1,105 @@
+#ifndef INC_METTLE_DRIVER_SHARD_HPP
+#define INC_METTLE_DRIVER_SHARD_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "filters_core.hpp"
+#include "run_tests.hpp"
+#include "test_index.hpp"
+#include "detail/export.hpp"
+#include "log/core.hpp"
+
+namespace mettle {
+
+  // A hash of `value` that's the same on every platform and in every process,
+  // unlike std::hash.
+  METTLE_PUBLIC std::uint64_t stable_hash(const std::string &value);
+
+  // Split a list of items (identified by `keys`) into `count` shards,
+  // returning the shard of each item. If any item has an estimated duration,
+  // the shards are balanced by their total duration (items with no estimate
+  // are assumed to take the average time); otherwise, each item is assigned
+  // by hashing its key. Either way, the result depends only on the inputs, so
+  // each machine in a sharded run can compute it independently.
+  METTLE_PUBLIC std::vector<std::size_t> assign_shards(
+    const std::vector<std::string> &keys,
+    const std::vector<std::optional<log::test_duration>> &estimates,
+    std::size_t count
+  );
+
+  // Hide every test not in the current shard, passing the rest through to
+  // the wrapped filter.
+  template<typename Filter>
+  using shard_filter = id_filter<Filter>;
+
+  namespace detail {
+    template<typename Suite, typename Filter>
+    std::unordered_set<test_uid>
+    shard_tests(const basic_test_index<Suite> &suites, const Filter &filter,
+                std::size_t index, std::size_t count,
+                const test_estimator &estimate) {
+      std::vector<test_uid> ids;
+      std::vector<std::string> keys;
+      std::vector<std::optional<log::test_duration>> estimates;
+
+      // Shard every test that the filter shows, including skipped ones, so
+      // that each skipped test is reported by exactly one shard.
+      const auto &entries = suites.suites();
+      for(std::size_t i = 0; i != entries.size(); i++) {
+        if(suites.hides_suite(filter, i)) {
+          i = entries[i].subsuites_end - 1;
+          continue;
+        }
+
+        for(auto t = entries[i].tests_begin; t != entries[i].tests_end; t++) {
+          const auto &test = suites.tests()[t];
+          auto action = filter_test(filter, test.name, test.full_name,
+                                    test.info->attrs).action;
+          if(action == test_action::indeterminate)
+            action = filter_by_attr(test.info->attrs).action;
+          if(action == test_action::hide)
+            continue;
+
+          ids.push_back(test.name.id);
+          keys.push_back(test.full_name);
+          estimates.push_back(estimate ? estimate(test.name) : std::nullopt);
+        }
+      }
+
+      auto shards = assign_shards(keys, estimates, count);
+      std::unordered_set<test_uid> tests;
+      for(std::size_t i = 0; i != ids.size(); i++) {
+        if(shards[i] == index)
+          tests.insert(ids[i]);
+      }
+      return tests;
+    }
+  }
+
+  // The filter can skip whole suites of `suites` outside this shard, so it
+  // mustn't outlive `suites`.
+  template<typename Suite, typename Filter>
+  shard_filter<Filter>
+  make_shard_filter(const basic_test_index<Suite> &suites, Filter filter,
+                    std::size_t index, std::size_t count,
+                    const test_estimator &estimate = nullptr) {
+    auto tests = detail::shard_tests(suites, filter, index, count, estimate);
+    return {std::move(filter), std::move(tests), suites};
+  }
+
+  template<typename Suites, typename Filter>
+  shard_filter<Filter>
+  make_shard_filter(const Suites &suites, Filter filter, std::size_t index,
+                    std::size_t count, const test_estimator &estimate = nullptr) {
+    auto tests = detail::shard_tests(make_test_index(suites), filter, index,
+                                     count, estimate);
+    return {std::move(filter), std::move(tests)};
+  }
+
+} // namespace mettle
+
+#endif
@@ -2,7 +2,10 @@
 #define INC_METTLE_DRIVER_SUBPROCESS_TEST_RUNNER_HPP
 
 #include <chrono>
+#include <deque>
+#include <memory>
 #include <optional>
+#include <vector>
 
 #ifdef _WIN32
 #  include <wtypes.h>
@@ -10,7 +13,13 @@
 
 #include <mettle/suite/compiled_suite.hpp>
 #include <mettle/driver/log/core.hpp>
+#include <mettle/driver/resource_limits.hpp>
+#include <mettle/driver/run_tests.hpp>
 #include <mettle/driver/detail/export.hpp>
+#ifndef _WIN32
+#  include <mettle/driver/posix/child_monitor.hpp>
+#  include <mettle/driver/posix/scoped_signal.hpp>
+#endif
 
 // Ignore warnings from MSVC about DLL interfaces.
 #if defined(_MSC_VER) && !defined(__clang__)
@@ -20,24 +29,117 @@
 
 namespace mettle {
 
+#ifndef _WIN32
+  class subprocess_test_pool;
+#endif
+
   class METTLE_PUBLIC subprocess_test_runner {
   public:
     using timeout_t = std::optional<std::chrono::milliseconds>;
 
-    subprocess_test_runner(timeout_t timeout = {}) : timeout_(timeout) {}
+    // If `output_limit` is non-zero, only the first and last `output_limit`
+    // bytes (in total) of each of a test's stdout and stderr are kept; the
+    // number of bytes dropped from the middle is recorded in its output.
+    //
+    // `capture` and `limits` are only used on POSIX systems; elsewhere,
+    // output is always captured with pipes, and tests have no resource
+    // limits. A test's `limit::max_rss` and `limit::cpu_time` attributes
+    // override `limits`.
+    subprocess_test_runner(timeout_t timeout = {},
+                           std::size_t output_limit = 0,
+                           output_capture capture = output_capture::pipe,
+                           resource_limits limits = {})
+      : timeout_(timeout), output_limit_(output_limit), capture_(capture),
+        limits_(limits) {}
 
     template<class Rep, class Period>
-    subprocess_test_runner(std::chrono::duration<Rep, Period> timeout)
-      : timeout_(timeout) {}
+    subprocess_test_runner(std::chrono::duration<Rep, Period> timeout,
+                           std::size_t output_limit = 0,
+                           output_capture capture = output_capture::pipe,
+                           resource_limits limits = {})
+      : timeout_(timeout), output_limit_(output_limit), capture_(capture),
+        limits_(limits) {}
 
     test_result
     operator ()(const test_info &test, log::test_output &output) const;
   private:
     timeout_t timeout_;
+    std::size_t output_limit_;
+    output_capture capture_;
+    resource_limits limits_;
+#ifndef _WIN32
+    // Created on the first test and kept for the rest, so that each test
+    // doesn't have to set up its own pool (and child monitor).
+    mutable std::shared_ptr<subprocess_test_pool> pool_;
+#endif
   };
 
 #ifndef _WIN32
 
+  class METTLE_PUBLIC subprocess_test_pool : public test_pool {
+  public:
+    using timeout_t = subprocess_test_runner::timeout_t;
+
+    // If `batch_size` is greater than 1, each subprocess runs that many tests
+    // in a row. When one crashes or times out, only the test that was running
+    // is blamed, and the rest of its batch is run in a new subprocess.
+    //
+    // Consecutive tests from a suite that forks after setup are always run in
+    // one batch, regardless of `batch_size`: the subprocess sets up the
+    // suite's fixture once and then forks a new process for each test.
+    //
+    // `output_limit`, `capture`, and `limits` work just like they do for
+    // `subprocess_test_runner`. Batches always capture their output with
+    // files, since each test's output has to be collected separately. In a
+    // batch, the CPU time limit applies to each test, but the memory limit
+    // applies to the whole subprocess.
+    subprocess_test_pool(std::size_t jobs, timeout_t timeout = {},
+                         std::size_t batch_size = 1,
+                         std::size_t output_limit = 0,
+                         output_capture capture = output_capture::pipe,
+                         resource_limits limits = {});
+    subprocess_test_pool(const subprocess_test_pool &) = delete;
+    subprocess_test_pool & operator =(const subprocess_test_pool &) = delete;
+    ~subprocess_test_pool();
+
+    void start(const test_info &test, callback_type done) override;
+    // Output can only be streamed from tests that capture it with pipes and
+    // aren't run in a batch; for anything else, `chunk` is never called.
+    void start(const test_info &test, callback_type done,
+               chunk_callback_type chunk) override;
+    void wait() override;
+    void cancel() override;
+  private:
+    struct queued_test {
+      const test_info *test;
+      callback_type done;
+      chunk_callback_type chunk = nullptr;
+      resource_limits limits = {};
+    };
+    struct child;
+    struct completed;
+
+    std::size_t next_batch(bool all) const;
+    void launch_pending(bool all);
+    void launch(std::vector<queued_test> tests);
+    void read_records(child &c, std::vector<completed> &finished);
+    void supervise(bool all);
+    int watch(child &c);
+    void unwatch(child &c);
+    void restore_signals();
+
+    std::size_t jobs_, batch_size_, output_limit_;
+    output_capture capture_;
+    resource_limits limits_;
+    timeout_t timeout_;
+    std::deque<queued_test> pending_;
+    std::vector<std::unique_ptr<child>> running_;
+    posix::child_monitor monitor_;
+    // Used to drain a test's pipes after it exits; see `supervise`.
+    posix::child_monitor reap_monitor_;
+    posix::scoped_sigaction sigint_, sigquit_, sigchld_;
+  };
+
   using fd_type = int;
   int make_fd_private(int fd);
 
@@ -0,0 +1,60 @@
+#ifndef INC_METTLE_DRIVER_TEST_HISTORY_HPP
+#define INC_METTLE_DRIVER_TEST_HISTORY_HPP
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "test_name.hpp"
+#include "detail/export.hpp"
+#include "log/core.hpp"
+
+// Ignore warnings from MSVC about DLL interfaces.
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(push)
+#  pragma warning(disable:4251)
+#endif
+
+namespace mettle {
+
+  // The most recent duration and outcome of each test (keyed by its source
+  // file and full name) and of each test file, stored on disk in a compact
+  // binary format so that it can be loaded quickly even for huge test suites.
+  class METTLE_PUBLIC test_history {
+  public:
+    struct entry {
+      log::test_duration duration;
+      bool passed;
+    };
+
+    test_history() = default;
+
+    static test_history load(const std::string &filename);
+    void save(const std::string &filename) const;
+
+    std::optional<entry> find(const test_name &test) const;
+    std::optional<entry> find_file(const std::string &file) const;
+
+    void record(const test_name &test, log::test_duration duration,
+                bool passed);
+    void record_file(const std::string &file, log::test_duration duration,
+                     bool passed);
+
+    std::size_t size() const;
+    bool empty() const {
+      return size() == 0;
+    }
+  private:
+    using name_map = std::unordered_map<std::string, entry>;
+
+    std::unordered_map<std::string, name_map> tests_;
+    name_map files_;
+  };
+
+} // namespace mettle
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  pragma warning(pop)
+#endif
+
+#endif
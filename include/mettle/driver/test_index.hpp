@@ -0,0 +1,123 @@
+#ifndef INC_METTLE_DRIVER_TEST_INDEX_HPP
+#define INC_METTLE_DRIVER_TEST_INDEX_HPP
+
+#include <concepts>
+#include <iterator>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "filters_core.hpp"
+#include "test_name.hpp"
+#include "../suite/compiled_suite.hpp"
+
+namespace mettle {
+
+  // A flattened view of a tree of suites, built once so that tests can be
+  // filtered, listed, and run (any number of times) without building their
+  // names again. Suites are stored in the order they're run (each suite before
+  // its subsuites), and so are tests, so every suite's tests, including those
+  // of its subsuites, are a contiguous range. The index refers to the tests in
+  // `suites`, so it mustn't outlive them.
+  //
+  // Each test's full name is built along with the index, from its suite's
+  // prefix, so that filters can match against it (see `filter_test`) without
+  // building it again for every test on every pass.
+  template<typename Suite>
+  class basic_test_index {
+  public:
+    using test_info = typename Suite::test_info;
+
+    struct suite_entry {
+      // Shared by the names of every test directly in this suite.
+      suite_path path;
+
+      // The start of the full name of every test in this suite, and the
+      // attributes they all have.
+      std::string prefix;
+      const attributes *attrs;
+
+      // This suite's own tests.
+      std::size_t tests_begin, tests_end;
+
+      // One past the last suite, and the last test, nested in this one.
+      std::size_t subsuites_end, subtree_tests_end;
+    };
+
+    struct test_entry {
+      const test_info *info;
+      test_name name;
+      std::string full_name;
+      std::size_t suite;
+    };
+
+    template<typename Suites>
+    explicit basic_test_index(const Suites &suites) {
+      std::vector<std::string> parents;
+      add(suites, parents);
+    }
+
+    const std::vector<suite_entry> & suites() const {
+      return suites_;
+    }
+
+    const std::vector<test_entry> & tests() const {
+      return tests_;
+    }
+
+    // Return true if `filter` is sure to hide every test in `suites()[suite]`,
+    // including those in its subsuites.
+    template<typename Filter>
+    bool hides_suite(const Filter &filter, std::size_t suite) const {
+      if constexpr(requires {
+        { filter.hides_suite(*this, suite) } -> std::convertible_to<bool>;
+      }) {
+        return filter.hides_suite(*this, suite);
+      } else {
+        return filter_hides_suite(filter, suites_[suite].prefix,
+                                  *suites_[suite].attrs);
+      }
+    }
+  private:
+    template<typename Suites>
+    void add(const Suites &suites, std::vector<std::string> &parents,
+             const std::string &parent_prefix = "") {
+      for(const auto &suite : suites) {
+        parents.push_back(suite.name());
+
+        std::size_t index = suites_.size();
+        suites_.push_back({parents, parent_prefix + suite.name() + " > ",
+                           &suite.attrs(), tests_.size(), 0, 0, 0});
+        const suite_path &path = suites_[index].path;
+        for(const auto &test : suite.tests()) {
+          tests_.push_back({&test, {path, test.name, test.id,
+                                    test.loc.file_name(), test.loc.line()},
+                            suites_[index].prefix + test.name, index});
+        }
+        suites_[index].tests_end = tests_.size();
+
+        // Copy the prefix, since adding subsuites may reallocate `suites_`.
+        add(suite.subsuites(), parents, std::string(suites_[index].prefix));
+        suites_[index].subsuites_end = suites_.size();
+        suites_[index].subtree_tests_end = tests_.size();
+        parents.pop_back();
+      }
+    }
+
+    std::vector<suite_entry> suites_;
+    std::vector<test_entry> tests_;
+  };
+
+  using test_index = basic_test_index<runnable_suite>;
+
+  template<typename Suites>
+  inline auto make_test_index(const Suites &suites) {
+    using suite_type = std::remove_cv_t<std::remove_reference_t<
+      decltype(*std::begin(suites))
+    >>;
+    return basic_test_index<suite_type>(suites);
+  }
+
+} // namespace mettle
+
+#endif
@@ -1,7 +1,8 @@
 #ifndef INC_METTLE_DRIVER_TEST_NAME_HPP
 #define INC_METTLE_DRIVER_TEST_NAME_HPP
 
-#include <sstream>
+#include <initializer_list>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -9,19 +10,84 @@
 
 namespace mettle {
 
+  // The names of the suites containing a test. This is immutable, so copies
+  // can share the same data; e.g. every test in a suite can refer to a single
+  // list of names.
+  class suite_path {
+  public:
+    using value_type = std::string;
+    using container_type = std::vector<std::string>;
+    using const_iterator = container_type::const_iterator;
+    using iterator = const_iterator;
+    using size_type = container_type::size_type;
+
+    suite_path() = default;
+    suite_path(container_type suites)
+      : suites_(std::make_shared<const container_type>(std::move(suites))) {}
+    suite_path(std::initializer_list<std::string> suites)
+      : suite_path(container_type(suites)) {}
+
+    const container_type & get() const {
+      static const container_type empty;
+      return suites_ ? *suites_ : empty;
+    }
+
+    operator const container_type &() const {
+      return get();
+    }
+
+    const_iterator begin() const {
+      return get().begin();
+    }
+    const_iterator end() const {
+      return get().end();
+    }
+
+    size_type size() const {
+      return get().size();
+    }
+    bool empty() const {
+      return get().empty();
+    }
+
+    const std::string & operator [](size_type i) const {
+      return get()[i];
+    }
+    const std::string & back() const {
+      return get().back();
+    }
+
+    friend bool operator ==(const suite_path &lhs, const suite_path &rhs) {
+      return lhs.suites_ == rhs.suites_ || lhs.get() == rhs.get();
+    }
+    friend bool operator !=(const suite_path &lhs, const suite_path &rhs) {
+      return !(lhs == rhs);
+    }
+  private:
+    std::shared_ptr<const container_type> suites_;
+  };
+
   struct test_name {
-    std::vector<std::string> suites;
+    test_name() = default;
+    test_name(suite_path suites, std::string name, test_uid id,
+              std::string file = "", long long line = 0)
+      : suites(std::move(suites)), name(std::move(name)), id(id),
+        file(std::move(file)), line(line) {}
+
+    suite_path suites;
     std::string name;
     test_uid id;
     std::string file = "";
     long long line = 0;
 
     std::string full_name() const {
-      std::ostringstream ss;
-      for(const auto &i : suites)
-        ss << i << " > ";
-      ss << name;
-      return ss.str();
+      std::string result;
+      for(const auto &i : suites) {
+        result += i;
+        result += " > ";
+      }
+      result += name;
+      return result;
     }
   };
 
@@ -3,11 +3,16 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <initializer_list>
 #include <iterator>
 #include <set>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace mettle {
 
@@ -20,17 +25,47 @@ namespace mettle {
 
   class attr_base;
 
-  struct attr_instance {
+  namespace detail {
+    // Attributes are identified by a hash of their name rather than by an
+    // index into a global table, since the test driver and header-only test
+    // code don't necessarily share globals (e.g. with DLLs on Windows).
+    inline std::uint64_t attr_id(std::string_view name) {
+      std::uint64_t hash = 0xcbf29ce484222325;
+      for(char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+      }
+      return hash;
+    }
+
+    inline std::uint64_t attr_mask(std::uint64_t id) {
+      return std::uint64_t(1) << (id & 63);
+    }
+  }
+
+  // An attribute applied to a test, along with its value(s). This refers to
+  // its attribute by pointer, rather than reference, so that instances can be
+  // assigned (e.g. when inserting into the middle of an `attributes`).
+  class attr_instance {
+  public:
     using value_type = std::set<std::string>;
 
-    const attr_base &attribute;
-    const value_type value;
+    attr_instance(const attr_base &attribute, value_type value = {})
+      : value(std::move(value)), attribute_(&attribute) {}
+
+    const attr_base & attribute() const {
+      return *attribute_;
+    }
+
+    value_type value;
+  private:
+    const attr_base *attribute_;
   };
 
   class attr_base {
   protected:
     attr_base(std::string name, test_action action = test_action::run)
-      : name_(std::move(name)), action_(action) {
+      : name_(std::move(name)), id_(detail::attr_id(name_)), action_(action) {
       assert(action == test_action::run || action == test_action::skip);
     }
   public:
@@ -40,18 +75,23 @@ namespace mettle {
       return name_;
     }
 
+    std::uint64_t id() const {
+      return id_;
+    }
+
     test_action action() const {
       return action_;
     }
 
     virtual const attr_instance
     compose(const attr_instance &lhs, const attr_instance &rhs) const {
-      assert(&lhs.attribute == this && &rhs.attribute == this);
+      assert(&lhs.attribute() == this && &rhs.attribute() == this);
       (void)rhs;
       return lhs;
     }
   private:
     std::string name_;
+    std::uint64_t id_;
     test_action action_;
   };
 
@@ -61,17 +101,17 @@ namespace mettle {
 
       bool
       operator ()(const attr_instance &lhs, const attr_instance &rhs) const {
-        return lhs.attribute.name() < rhs.attribute.name();
+        return lhs.attribute().name() < rhs.attribute().name();
       }
 
       bool
       operator ()(const attr_instance &lhs, const std::string &rhs) const {
-        return lhs.attribute.name() < rhs;
+        return lhs.attribute().name() < rhs;
       }
 
       bool
       operator ()(const std::string &lhs, const attr_instance &rhs) const {
-        return lhs < rhs.attribute.name();
+        return lhs < rhs.attribute().name();
       }
     };
   }
@@ -114,7 +154,7 @@ namespace mettle {
 
     const attr_instance
     compose(const attr_instance &lhs, const attr_instance &rhs) const override {
-      assert(&lhs.attribute == this && &rhs.attribute == this);
+      assert(&lhs.attribute() == this && &rhs.attribute() == this);
       attr_instance::value_type merged;
       std::set_union(
         lhs.value.begin(), lhs.value.end(),
@@ -125,7 +165,146 @@ namespace mettle {
     }
   };
 
-  using attributes = std::set<attr_instance, detail::attr_less>;
+  // A set of attribute instances, ordered by name. Tests rarely have more
+  // than a few attributes, so these are stored in a flat vector, along with a
+  // bitmask of the attributes' IDs that rules out most lookups for attributes
+  // that aren't there without touching the vector at all.
+  class attributes {
+  public:
+    using value_type = attr_instance;
+    using container_type = std::vector<attr_instance>;
+    using iterator = container_type::const_iterator;
+    using const_iterator = iterator;
+
+    attributes() = default;
+    attributes(const attributes &) = default;
+    attributes(attributes &&) = default;
+
+    attributes(std::initializer_list<attr_instance> i) {
+      // Like a `std::set`, keep the first of any duplicates.
+      std::vector<const attr_instance *> sorted;
+      sorted.reserve(i.size());
+      for(const auto &attr : i)
+        sorted.push_back(&attr);
+      std::stable_sort(sorted.begin(), sorted.end(), [](auto *lhs, auto *rhs) {
+        return detail::attr_less{}(*lhs, *rhs);
+      });
+
+      attrs_.reserve(sorted.size());
+      for(auto *attr : sorted) {
+        if(attrs_.empty() || detail::attr_less{}(attrs_.back(), *attr))
+          push_back(*attr);
+      }
+    }
+
+    attributes & operator =(const attributes &) = default;
+    attributes & operator =(attributes &&) = default;
+
+    iterator begin() const {
+      return attrs_.begin();
+    }
+
+    iterator end() const {
+      return attrs_.end();
+    }
+
+    std::size_t size() const {
+      return attrs_.size();
+    }
+
+    bool empty() const {
+      return attrs_.empty();
+    }
+
+    // True if any of these attributes would cause a test to be skipped.
+    bool has_skip() const {
+      return has_skip_;
+    }
+
+    iterator find(std::string_view name) const {
+      return find(name, detail::attr_id(name));
+    }
+
+    // Look up an attribute by its name and its ID (from `detail::attr_id`).
+    iterator find(std::string_view name, std::uint64_t id) const {
+      if(!(mask_ & detail::attr_mask(id)))
+        return end();
+      for(auto i = begin(); i != end(); ++i) {
+        if(i->attribute().id() == id && i->attribute().name() == name)
+          return i;
+      }
+      return end();
+    }
+
+    std::size_t count(std::string_view name) const {
+      return find(name) != end();
+    }
+
+    std::pair<iterator, bool> insert(const attr_instance &attr) {
+      auto pos = std::lower_bound(attrs_.begin(), attrs_.end(), attr,
+                                  detail::attr_less{});
+      if(pos != attrs_.end() && !detail::attr_less{}(attr, *pos))
+        return {pos, false};
+
+      pos = attrs_.insert(pos, attr);
+      mask_ |= detail::attr_mask(attr.attribute().id());
+      has_skip_ |= attr.attribute().action() == test_action::skip;
+      return {pos, true};
+    }
+
+    // Attributes are kept sorted by name, so `hint` is ignored; this is just
+    // for compatibility with `std::set` (e.g. for `std::inserter`).
+    iterator insert(const_iterator, const attr_instance &attr) {
+      return insert(attr).first;
+    }
+
+    template<typename InputIter>
+    void insert(InputIter first, InputIter last) {
+      for(; first != last; ++first)
+        insert(*first);
+    }
+
+    iterator erase(const_iterator pos) {
+      auto next = attrs_.erase(pos);
+      update_summary();
+      return next;
+    }
+
+    std::size_t erase(std::string_view name) {
+      auto i = find(name);
+      if(i == end())
+        return 0;
+      erase(i);
+      return 1;
+    }
+
+    // Append `attr`, which must sort after every attribute already here.
+    void push_back(const attr_instance &attr) {
+      assert(attrs_.empty() || detail::attr_less{}(attrs_.back(), attr));
+      attrs_.push_back(attr);
+      mask_ |= detail::attr_mask(attr.attribute().id());
+      has_skip_ |= attr.attribute().action() == test_action::skip;
+    }
+
+    void reserve(std::size_t n) {
+      attrs_.reserve(n);
+    }
+  private:
+    // Recompute `mask_` and `has_skip_` after removing an attribute, since
+    // other attributes may share its bit in the mask.
+    void update_summary() {
+      mask_ = 0;
+      has_skip_ = false;
+      for(const auto &attr : attrs_) {
+        mask_ |= detail::attr_mask(attr.attribute().id());
+        has_skip_ |= attr.attribute().action() == test_action::skip;
+      }
+    }
+
+    container_type attrs_;
+    std::uint64_t mask_ = 0;
+    bool has_skip_ = false;
+  };
 
   namespace detail {
     template<typename Input1, typename Input2, typename Output,
@@ -149,17 +328,18 @@ namespace mettle {
 
   inline attr_instance
   unite(const attr_instance &lhs, const attr_instance &rhs) {
-    if(&lhs.attribute != &rhs.attribute)
+    if(&lhs.attribute() != &rhs.attribute())
       throw std::invalid_argument("mismatched attributes");
-    return lhs.attribute.compose(lhs, rhs);
+    return lhs.attribute().compose(lhs, rhs);
   }
 
   inline attributes
   unite(const attributes &lhs, const attributes &rhs) {
     attributes all_attrs;
+    all_attrs.reserve(lhs.size() + rhs.size());
     detail::merge_union(
       lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
-      std::inserter(all_attrs, all_attrs.begin()), detail::attr_less(),
+      std::back_inserter(all_attrs), detail::attr_less(),
       [](const attr_instance &lhs, const attr_instance &rhs) {
         return unite(lhs, rhs);
       }
@@ -169,6 +349,13 @@ namespace mettle {
 
   inline bool_attr skip("skip", test_action::skip);
 
+  // Attributes to limit the memory (e.g. "512M") or CPU time (e.g. "30s") a
+  // test may use. These are only enforced when the test runs in a subprocess.
+  namespace limit {
+    inline string_attr max_rss("max_rss");
+    inline string_attr cpu_time("cpu_time");
+  }
+
 } // namespace mettle
 
 #endif
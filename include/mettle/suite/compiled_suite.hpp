@@ -3,6 +3,7 @@
 
 #include <functional>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "attributes.hpp"
@@ -17,23 +18,52 @@ namespace mettle {
     std::string message;
   };
 
+  // For tests in a suite that forks after setup, the group of tests sharing
+  // that suite's fixture and this test's index within the group. Test runners
+  // can use this to set up the fixture once and fork each test from there.
+  struct shared_setup_info {
+    const void *group = nullptr;
+    std::size_t index = 0;
+
+    explicit operator bool() const {
+      return group;
+    }
+  };
+
   template<typename Function>
   struct basic_test_info {
     using function_type = std::function<Function>;
 
     basic_test_info(std::string name, function_type function, attributes attrs,
-                      detail::source_location loc = detail::source_location::current())
+                      detail::source_location loc = detail::source_location::current(),
+                      shared_setup_info shared_setup = {})
       : name(std::move(name)), function(std::move(function)),
         attrs(std::move(attrs)), id(detail::make_test_uid()),
-        loc(std::move(loc)) {}
+        loc(std::move(loc)), shared_setup(shared_setup) {}
 
     std::string name;
     function_type function;
     attributes attrs;
     test_uid id;
     detail::source_location loc;
+    shared_setup_info shared_setup;
   };
 
+  namespace detail {
+    // Compile a test's function, letting the compiler update the test's shared
+    // setup info if it accepts it.
+    template<typename Compile, typename Function>
+    inline auto
+    compile_test(Compile &compile, Function &&function,
+                 shared_setup_info &shared_setup) {
+      if constexpr(std::is_invocable_v<Compile&, Function&&,
+                                       shared_setup_info&>)
+        return compile(std::forward<Function>(function), shared_setup);
+      else
+        return compile(std::forward<Function>(function));
+    }
+  }
+
   template<typename Function>
   class compiled_suite {
     template<typename>
@@ -47,13 +77,16 @@ namespace mettle {
     compiled_suite(
       String &&name, Tests &&tests, Subsuites &&subsuites,
       const attributes &attrs, Compile &&compile
-    ) : name_(std::forward<String>(name)) {
+    ) : name_(std::forward<String>(name)), attrs_(attrs) {
       for(auto &&test : tests) {
+        shared_setup_info shared_setup = test.shared_setup;
+        auto function = detail::compile_test(
+          compile, detail::forward_like<Tests>(test.function), shared_setup
+        );
         tests_.emplace_back(
-          detail::forward_like<Tests>(test.name),
-          compile(detail::forward_like<Tests>(test.function)),
+          detail::forward_like<Tests>(test.name), std::move(function),
           unite(detail::forward_like<Tests>(test.attrs), attrs),
-          detail::forward_like<Tests>(test.loc)
+          detail::forward_like<Tests>(test.loc), shared_setup
         );
       }
       for(auto &&ss : subsuites) {
@@ -67,19 +100,28 @@ namespace mettle {
     compiled_suite(const compiled_suite<Function2> &suite,
                    const attributes &attrs, Compile &&compile)
       : compiled_suite(suite.name_, suite.tests_, suite.subsuites_, attrs,
-                       std::forward<Compile>(compile)) {}
+                       std::forward<Compile>(compile)) {
+      attrs_ = unite(suite.attrs_, attrs);
+    }
 
     template<typename Function2, typename Compile>
     compiled_suite(compiled_suite<Function2> &&suite,
                    const attributes &attrs, Compile &&compile)
       : compiled_suite(std::move(suite.name_), std::move(suite.tests_),
                        std::move(suite.subsuites_), attrs,
-                       std::forward<Compile>(compile)) {}
+                       std::forward<Compile>(compile)) {
+      attrs_ = unite(suite.attrs_, attrs);
+    }
 
     const std::string & name() const {
       return name_;
     }
 
+    // The attributes shared by every test in this suite (and its subsuites).
+    const attributes & attrs() const {
+      return attrs_;
+    }
+
     const std::vector<test_info> & tests() const {
       return tests_;
     }
@@ -89,6 +131,7 @@ namespace mettle {
     }
   private:
     std::string name_;
+    attributes attrs_;
     std::vector<test_info> tests_;
     std::vector<compiled_suite> subsuites_;
   };
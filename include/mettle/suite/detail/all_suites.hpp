@@ -1,11 +1,88 @@
 #ifndef INC_METTLE_SUITE_DETAIL_ALL_SUITES_HPP
 #define INC_METTLE_SUITE_DETAIL_ALL_SUITES_HPP
 
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../attributes.hpp"
 #include "../compiled_suite.hpp"
+#include "../../detail/move_only_function.hpp"
+#include "../../test_uid.hpp"
 
 namespace mettle::detail {
 
-  inline suites_list all_suites;
+  // The global suites, which are registered during static initialization but
+  // only built once something asks for them. This way, a test binary that
+  // only needs some of its suites (e.g. to run a single test) doesn't pay to
+  // build the rest.
+  class suite_registry {
+  public:
+    using builder_type = move_only_function<
+      void(suites_list &, const std::string &, const attributes &)
+    >;
+
+    void add(std::string name, attributes attrs, builder_type build) {
+      entries_.push_back({std::move(name), std::move(attrs), std::move(build),
+                          std::nullopt});
+    }
+
+    std::size_t size() const {
+      return entries_.size();
+    }
+
+    // Build every registration that `keep(index, name, attrs)` accepts and
+    // that hasn't been built yet, and return all the suites built so far, in
+    // the order they were registered.
+    template<typename Keep>
+    const suites_list & materialize(Keep &&keep) {
+      std::size_t pos = 0;
+      for(std::size_t i = 0; i != entries_.size(); i++) {
+        auto &e = entries_[i];
+        if(!e.built && keep(i, std::as_const(e.name), std::as_const(e.attrs))) {
+          suites_list built;
+          {
+            scoped_test_uids uids(registration_uid_base(i));
+            e.build(built, e.name, e.attrs);
+            if(uids.used() > max_registration_tests) {
+              throw std::length_error(
+                "too many tests in suite \"" + e.name + "\""
+              );
+            }
+          }
+
+          suites_.insert(suites_.begin() + pos,
+                         std::make_move_iterator(built.begin()),
+                         std::make_move_iterator(built.end()));
+          e.built = built.size();
+          e.build = nullptr;
+        }
+        pos += e.built.value_or(0);
+      }
+      return suites_;
+    }
+
+    const suites_list & materialize() {
+      return materialize([](std::size_t, const std::string &,
+                            const attributes &) { return true; });
+    }
+  private:
+    struct entry {
+      std::string name;
+      attributes attrs;
+      builder_type build;
+      // The number of suites this registration built, once it's been built.
+      std::optional<std::size_t> built;
+    };
+
+    std::vector<entry> entries_;
+    suites_list suites_;
+  };
+
+  inline suite_registry all_suites;
 
 } // namespace mettle::detail
 
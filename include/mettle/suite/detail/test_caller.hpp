@@ -1,9 +1,13 @@
 #ifndef INC_METTLE_SUITE_DETAIL_TEST_CALLER_HPP
 #define INC_METTLE_SUITE_DETAIL_TEST_CALLER_HPP
 
-#include <functional>
+#include <cstddef>
+#include <memory>
 #include <tuple>
 #include <utility>
+#include <vector>
+
+#include "../../detail/move_only_function.hpp"
 
 namespace mettle::detail {
 
@@ -24,28 +28,71 @@ namespace mettle::detail {
     Factory, Child
   >::type;
 
+  // Called by tests in a suite that forks after setup, once the suite's setup
+  // is done. A test runner can install a hook here to fork a process for each
+  // test in `group` from the current one, returning the index of the test the
+  // new process should run; by default, we just run the test we were asked to.
+  using fork_hook_type = std::size_t (*)(const void *group, std::size_t index);
+  inline fork_hook_type fork_hook = nullptr;
+
+  inline std::size_t fork_shared_test(const void *group, std::size_t index) {
+    return fork_hook ? fork_hook(group, index) : index;
+  }
+
+  // What every test in a suite shares: the suite's setup and teardown, and
+  // the bodies of its tests (including those of its subsuites). Each test
+  // refers to this by index, so a suite's hooks are only stored once, however
+  // many tests it has.
+  template<typename ...Args>
+  struct shared_suite {
+    using function_type = move_only_function<void(Args&...)>;
+
+    function_type setup, teardown;
+    std::vector<function_type> tests = {};
+    bool fork_after_setup = false;
+  };
+
   template<typename ...Args>
   struct test_caller {
-    using function_type = std::function<void(Args&...)>;
+    using function_type = move_only_function<void(Args&...)>;
+    using suite_type = shared_suite<Args...>;
+
+    test_caller(std::shared_ptr<suite_type> suite, std::size_t index)
+      : suite(std::move(suite)), index(index) {}
+
+    // Make a caller for a single test with its own setup and teardown.
+    test_caller(function_type setup, function_type teardown,
+                function_type test)
+      : suite(std::make_shared<suite_type>(
+          suite_type{std::move(setup), std::move(teardown)}
+        )) {
+      suite->tests.push_back(std::move(test));
+    }
 
     void operator ()(Args &...args) {
-      if(setup)
-        setup(args...);
+      auto &s = *suite;
+      if(s.setup)
+        s.setup(args...);
 
+      // If the suite forks after setup, the test runner may ask us to run a
+      // different test from the suite here.
+      auto &f = s.tests[s.fork_after_setup ?
+                        fork_shared_test(&s, index) : index];
       try {
-        test(args...);
+        f(args...);
       } catch(...) {
-        if(teardown) {
-          try { teardown(args...); } catch(...) {}
+        if(s.teardown) {
+          try { s.teardown(args...); } catch(...) {}
         }
         throw;
       }
 
-      if(teardown)
-        teardown(args...);
+      if(s.teardown)
+        s.teardown(args...);
     }
 
-    function_type setup, teardown, test;
+    std::shared_ptr<suite_type> suite;
+    std::size_t index = 0;
   };
 
   template<typename Factory, typename Child, typename ...Parent>
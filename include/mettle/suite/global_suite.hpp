@@ -22,11 +22,18 @@ namespace mettle {
     basic_suite(suites_list &list, const std::string &name, Args &&...args)
       : basic_suite(list, name, {}, std::forward<Args>(args)...) {}
 
+    // Suites declared without a list are only registered here; they're built
+    // later, when the driver asks for them.
     template<typename ...Args>
     basic_suite(const std::string &name, const attributes &attrs,
-                Args &&...args)
-      : basic_suite(detail::all_suites, name, attrs,
-                    std::forward<Args>(args)...) {}
+                Args &&...args) {
+      detail::all_suites.add(name, attrs, [
+        ...args = std::forward<Args>(args)
+      ](suites_list &list, const std::string &name,
+        const attributes &attrs) mutable {
+        basic_suite(list, name, attrs, std::move(args)...);
+      });
+    }
 
     template<typename ...Args>
     basic_suite(const std::string &name, Args &&...args)
@@ -5,6 +5,7 @@
 #include <array>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <type_traits>
@@ -77,8 +78,8 @@ namespace mettle {
       return {
         std::move(b.name_), std::move(b.tests_), std::move(b.subsuites_),
         std::move(b.attrs_),
-        [&b, &wrap](auto &&test) {
-          return wrap(b.make_test_caller(std::move(test)));
+        [&b, &wrap](auto &&test, shared_setup_info &shared_setup) {
+          return wrap(b.make_test_caller(std::move(test), shared_setup));
         }
       };
     }
@@ -232,7 +233,7 @@ namespace mettle {
   class suite_builder_base {
   public:
     using tuple_type = std::tuple<T...>;
-    using function_type = std::function<void(T&...)>;
+    using function_type = detail::move_only_function<void(T&...)>;
 
     suite_builder_base(std::string name, attributes attrs)
       : name_(std::move(name)), attrs_(std::move(attrs)) {}
@@ -247,6 +248,10 @@ namespace mettle {
       teardown_ = std::move(f);
     }
 
+    void fork_after_setup() {
+      fork_after_setup_ = true;
+    }
+
     void test(std::string name, function_type f,
                 detail::source_location loc = detail::source_location::current()) {
       tests_.push_back({ std::move(name), std::move(f), {}, std::move(loc) });
@@ -287,11 +292,37 @@ namespace mettle {
       function_type function;
       attributes attrs;
       detail::source_location loc;
+      shared_setup_info shared_setup = {};
     };
 
+    using shared_suite_type = detail::shared_suite<T...>;
+
+    // Get the caller for a test (or a subsuite's test) in this suite. Every
+    // test is added to the suite's shared state, which holds the suite's setup
+    // and teardown; if the suite forks after setup, `shared_setup` is updated
+    // to point to it, so the test runner can group these tests together.
+    template<typename Caller>
+    Caller make_caller(function_type &&test, shared_setup_info &shared_setup) {
+      // Once we're making callers, the suite's hooks are final, so move them
+      // into the shared state.
+      if(!shared_) {
+        shared_ = std::make_shared<shared_suite_type>(shared_suite_type{
+          std::move(setup_), std::move(teardown_), {}, fork_after_setup_
+        });
+      }
+      shared_->tests.push_back(std::move(test));
+
+      std::size_t index = shared_->tests.size() - 1;
+      if(fork_after_setup_)
+        shared_setup = {shared_.get(), index};
+      return {shared_, index};
+    }
+
     std::string name_;
     attributes attrs_;
     function_type setup_, teardown_;
+    bool fork_after_setup_ = false;
+    std::shared_ptr<shared_suite_type> shared_;
     std::vector<test_info> tests_;
     std::vector<compiled_suite<void(T&...)>> subsuites_;
   };
@@ -313,8 +344,11 @@ namespace mettle {
       : base(name, attrs) {}
   private:
     detail::test_caller<ParentFixture...>
-    make_test_caller(typename base::function_type &&test) {
-      return {base::setup_, base::teardown_, std::move(test)};
+    make_test_caller(typename base::function_type &&test,
+                     shared_setup_info &shared_setup) {
+      return base::template make_caller<detail::test_caller<ParentFixture...>>(
+        std::move(test), shared_setup
+      );
     }
 
     template<typename Builder, typename Wrap>
@@ -341,8 +375,14 @@ namespace mettle {
       : base(name, attrs), factory_(factory) {}
   private:
     detail::fixture_test_caller<Factory, Fixture, ParentFixture...>
-    make_test_caller(typename base::function_type &&test) {
-      return {{base::setup_, base::teardown_, std::move(test)}, factory_};
+    make_test_caller(typename base::function_type &&test,
+                     shared_setup_info &shared_setup) {
+      using caller_base = detail::test_caller<
+        ParentFixture..., detail::transform_fixture_t<Factory, Fixture>
+      >;
+      return {base::template make_caller<caller_base>(
+        std::move(test), shared_setup
+      ), factory_};
     }
 
     template<typename Builder, typename Wrap>
@@ -377,6 +417,11 @@ namespace mettle {
     p.teardown(std::forward<F>(f));
   }
 
+  template<typename Parent>
+  inline void fork_after_setup(Parent &p) {
+    p.fork_after_setup();
+  }
+
 
   template<typename Parent, typename F>
   inline void
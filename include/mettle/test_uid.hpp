@@ -2,6 +2,7 @@
 #define INC_METTLE_TEST_UID_HPP
 
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 
 namespace mettle {
@@ -12,10 +13,48 @@ namespace mettle {
     inline std::atomic<test_uid> next_test_uid(1);
     inline test_uid make_test_uid() { return next_test_uid++; }
 
+    // Tests in globally-registered suites are numbered from a base determined
+    // by their registration's index, so that a test's UID is the same no
+    // matter which other registrations have been built.
+    inline constexpr int registration_uid_bits = 24;
+    inline constexpr test_uid max_registration_tests =
+      (test_uid(1) << registration_uid_bits) - 1;
+
+    inline test_uid registration_uid_base(std::size_t index) {
+      return test_uid(index + 1) << registration_uid_bits;
+    }
+
+    inline bool is_registered_uid(test_uid id) {
+      return id >= registration_uid_base(0);
+    }
+
+    inline std::size_t registration_index(test_uid id) {
+      return static_cast<std::size_t>(id >> registration_uid_bits) - 1;
+    }
+
+    // Number new tests from `base` for as long as this object lives.
+    class scoped_test_uids {
+    public:
+      explicit scoped_test_uids(test_uid base)
+        : base_(base), saved_(next_test_uid.exchange(base)) {}
+      scoped_test_uids(const scoped_test_uids &) = delete;
+      scoped_test_uids & operator =(const scoped_test_uids &) = delete;
+
+      ~scoped_test_uids() {
+        next_test_uid = saved_;
+      }
+
+      test_uid used() const {
+        return next_test_uid - base_;
+      }
+    private:
+      test_uid base_, saved_;
+    };
+
     class file_uid_maker {
     public:
       test_uid make_file_uid() {
-        return next_file_uid++ << 32;
+        return next_file_uid++ << 48;
       }
     private:
       test_uid next_file_uid = 0;
@@ -24,7 +63,7 @@ namespace mettle {
     // This is useful for maxing out a file-only UID so that it sorts *after*
     // file-and-test UIDs.
     inline test_uid max_local_bits(test_uid id) {
-      return id | 0xffffffff;
+      return id | 0xffffffffffff;
     }
   }
 
@@ -41,6 +41,25 @@ namespace mettle {
     desc.add_options()
       ("attr,a", value(&opts.filters.by_attr)->value_name("ATTR[=VALUE]"),
        "attributes of tests to run")
+      ("cpu-limit", value<std::string>()->value_name("TIME")
+         ->notifier([&opts](const std::string &value) {
+           opts.limits.cpu_time = parse_cpu_time(value);
+         }), "limit the CPU time each test can use (e.g. 30s)")
+      ("history", value(&opts.history)->value_name("FILE"),
+       "file to read and record test durations and outcomes in")
+      ("memory-limit", value<std::string>()->value_name("SIZE")
+         ->notifier([&opts](const std::string &value) {
+           opts.limits.max_rss = parse_memory_size(value);
+         }), "limit the memory each test can use (e.g. 512M)")
+      ("output-limit", value(&opts.output_limit)->value_name("BYTES"),
+       "keep at most BYTES of each test's stdout and stderr (the beginning "
+       "and end)")
+      ("shard-count", value(&opts.shard_count)->value_name("N"),
+       "number of shards to split the tests into")
+      ("shard-index", value(&opts.shard_index)->value_name("I"),
+       "index of the shard to run (from 0 to N-1)")
+      ("stream-output", value(&opts.stream_output)->zero_tokens(),
+       "pass each test's output to the logger as it's written")
       ("test,T", value(&opts.filters.by_name)->value_name("REGEX"),
        "regex matching names of tests to run")
       ("timeout,t", value(&opts.timeout)->value_name("MS"), "timeout in ms")
@@ -95,6 +114,13 @@ namespace mettle {
     return desc;
   }
 
+  std::pair<std::string, std::string>
+  parse_fail_fast(const std::string &arg) {
+    if(arg == "--fail-fast")
+      return {"fail-fast", "1"};
+    return {};
+  }
+
   boost::program_options::option_description *
   has_option(const boost::program_options::options_description &options,
              const boost::program_options::variables_map &args) {
@@ -212,6 +238,86 @@ namespace mettle {
       boost::throw_exception(invalid_option_value(val));
   }
 
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                report_order*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    if(val == "suite")
+      v = report_order::suite;
+    else if(val == "completion")
+      v = report_order::completion;
+    else
+      boost::throw_exception(invalid_option_value(val));
+  }
+
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                output_capture*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    if(val == "pipe")
+      v = output_capture::pipe;
+    else if(val == "file")
+      v = output_capture::file;
+    else
+      boost::throw_exception(invalid_option_value(val));
+  }
+
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                list_format*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    if(val == "text")
+      v = list_format::text;
+    else if(val == "json")
+      v = list_format::json;
+    else if(val == "binary")
+      v = list_format::binary;
+    else
+      boost::throw_exception(invalid_option_value(val));
+  }
+
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                test_id_range*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    try {
+      auto dash = val.find('-');
+      test_id_range range;
+      range.first = boost::lexical_cast<test_uid>(val.substr(0, dash));
+      range.last = dash == std::string::npos ? range.first :
+        boost::lexical_cast<test_uid>(val.substr(dash + 1));
+      if(range.last < range.first)
+        throw std::invalid_argument("invalid range");
+      v = range;
+    } catch(...) {
+      boost::throw_exception(invalid_option_value(val));
+    }
+  }
+
+  namespace log {
+    void validate(boost::any &v, const std::vector<std::string> &values,
+                  child_protocol*, int) {
+      using namespace boost::program_options;
+      validators::check_first_occurrence(v);
+      const std::string &val = validators::get_single_string(values);
+
+      if(val == "bencode")
+        v = child_protocol::bencode;
+      else if(val == "binary")
+        v = child_protocol::binary;
+      else
+        boost::throw_exception(invalid_option_value(val));
+    }
+  }
+
   void validate(boost::any &v, const std::vector<std::string> &values,
                 attr_filter_set*, int) {
     using namespace boost::program_options;
@@ -237,7 +343,7 @@ namespace mettle {
     assert(filters != nullptr);
     for(const auto &i : values) {
       try {
-        filters->insert(std::regex(i));
+        filters->insert(i);
       } catch(...) {
         boost::throw_exception(invalid_option_value(i));
       }
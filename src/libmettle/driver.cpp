@@ -1,8 +1,16 @@
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <optional>
+#include <unordered_set>
 #include <vector>
 
+#ifdef _WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#endif
+
 #define NOMINMAX
 
 // Ignore warnings about deprecated implicit copy constructor.
@@ -22,36 +30,86 @@
 
 #include <mettle/driver/cmd_line.hpp>
 #include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/list_tests.hpp>
 #include <mettle/driver/run_tests.hpp>
+#include <mettle/driver/shard.hpp>
 #include <mettle/driver/subprocess_test_runner.hpp>
+#include <mettle/driver/test_index.hpp>
 #include <mettle/driver/log/child.hpp>
+#include <mettle/driver/log/history.hpp>
 #include <mettle/driver/log/summary.hpp>
 #include <mettle/driver/log/term.hpp>
 #include <mettle/driver/detail/export.hpp>
 #include <mettle/suite/compiled_suite.hpp>
+#include <mettle/suite/detail/all_suites.hpp>
 
 namespace mettle {
 
   namespace {
     struct all_options : generic_options, driver_options, output_options {
       std::optional<fd_type> output_fd;
+      log::child_protocol output_protocol = log::child_protocol::bencode;
+      std::size_t output_buffer = 0;
 #ifdef _WIN32
       std::optional<test_uid> test_id;
       std::optional<HANDLE> log_fd;
 #endif
       bool no_subproc = false;
+      std::optional<std::size_t> fail_fast;
+      bool list = false;
+      list_format list_as = list_format::text;
+#ifndef _WIN32
+      std::vector<test_id_range> test_ids;
+      std::size_t jobs = 1;
+      std::size_t batch_size = 1;
+      report_order order = report_order::suite;
+      output_capture capture = output_capture::pipe;
+#endif
     };
 
     void report_error(const std::string &program_name,
                       const std::string &message) {
       std::cerr << program_name << ": " << message << std::endl;
     }
-  }
 
-  namespace detail {
+    // The environment variables the `mettle` driver sets in place of hidden
+    // options (see `log::protocol_env` and `log::buffer_env`).
+    const char *const driver_env[] = {log::protocol_env, log::buffer_env};
 
-    METTLE_PUBLIC int
-    drive_tests(int argc, const char *argv[], const suites_list &suites) {
+    std::string driver_env_option(const std::string &var) {
+      if(var == log::protocol_env)
+        return "output-protocol";
+      else if(var == log::buffer_env)
+        return "output-buffer";
+      return "";
+    }
+
+    // Once we've read those variables, remove them so that they don't leak
+    // into our tests (or any test binaries they run in turn).
+    void clear_driver_env() {
+      for(const char *var : driver_env) {
+#ifdef _WIN32
+        _putenv_s(var, "");
+#else
+        unsetenv(var);
+#endif
+      }
+    }
+
+#ifndef _WIN32
+    bool has_shared_setup(const test_index &index) {
+      for(const auto &test : index.tests()) {
+        if(test.info->shared_setup)
+          return true;
+      }
+      return false;
+    }
+#endif
+
+    // `materialize(keep)` returns the suites to run, building (at least) the
+    // global registrations that `keep` accepts.
+    template<typename Materialize>
+    int drive(int argc, const char *argv[], Materialize &&materialize) {
       using namespace mettle;
       namespace opts = boost::program_options;
 
@@ -65,15 +123,44 @@ namespace mettle {
       driver.add_options()
         ("no-subproc", opts::value(&args.no_subproc)->zero_tokens(),
          "don't create a subprocess for each test")
+        ("fail-fast", opts::value(&args.fail_fast)->value_name("N")
+                        ->implicit_value(std::size_t(1), "1"),
+         "stop running tests after N failures (default: 1)")
+        ("list", opts::value(&args.list)->zero_tokens(),
+         "list the tests instead of running them")
+        ("list-format", opts::value(&args.list_as)->value_name("FORMAT"),
+         "list the tests in this format instead of running them (one of: "
+         "text, json, binary; default: text)")
+#ifndef _WIN32
+        ("jobs,j", opts::value(&args.jobs)->value_name("N"),
+         "number of tests to run in parallel")
+        ("batch-size", opts::value(&args.batch_size)->value_name("N"),
+         "number of tests to run in each subprocess")
+        ("report-order", opts::value(&args.order)->value_name("ORDER"),
+         "order to report parallel tests in (one of: suite, completion; "
+         "default: suite)")
+        ("output-capture", opts::value(&args.capture)->value_name("MODE"),
+         "how to capture the output of each test (one of: pipe, file; "
+         "default: pipe)")
+#endif
       ;
 
       opts::options_description hidden("Hidden options");
       hidden.add_options()
         ("output-fd", opts::value(&args.output_fd),
          "pipe the results to this file descriptor")
+        ("output-protocol", opts::value(&args.output_protocol),
+         "format of the results sent to --output-fd (one of: bencode, binary; "
+         "default: bencode)")
+        ("output-buffer", opts::value(&args.output_buffer)->value_name("N"),
+         "hold up to N bytes of results before sending them to --output-fd")
 #ifdef _WIN32
         ("test-id", opts::value(&args.test_id), "internal id of a test to run")
         ("log-fd", opts::value(&args.log_fd), "HANDLE to log pipe")
+#else
+        ("test-id", opts::value(&args.test_ids),
+         "internal id (or FIRST-LAST range of ids) of tests to run (may be "
+         "specified multiple times)")
 #endif
       ;
 
@@ -83,14 +170,17 @@ namespace mettle {
         opts::positional_options_description pos;
         all.add(generic).add(driver).add(output).add(hidden);
         auto parsed = opts::command_line_parser(argc, argv)
-          .options(all).positional(pos).run();
+          .options(all).positional(pos).extra_parser(parse_fail_fast).run();
 
         opts::store(parsed, vm);
+        // Options on the command line take precedence over the environment.
+        opts::store(opts::parse_environment(hidden, driver_env_option), vm);
         opts::notify(vm);
       } catch(const std::exception &e) {
         report_error(argv[0], e.what());
         return exit_code::bad_args;
       }
+      clear_driver_env();
 
       if(args.show_help) {
         opts::options_description displayed;
@@ -102,6 +192,45 @@ namespace mettle {
         return exit_code::success;
       }
 
+      // Only build the global suites that could have tests we'll run: those
+      // the given test IDs were registered with, if any, and that the filters
+      // don't rule out. Each registration numbers its tests on its own, so
+      // their IDs don't depend on what else gets built.
+      std::optional<std::unordered_set<std::size_t>> registrations;
+      auto want_tests = [&registrations](test_uid first, test_uid last) {
+        if(!registrations)
+          registrations.emplace();
+        if(!detail::is_registered_uid(last))
+          return;
+        std::size_t i = detail::is_registered_uid(first) ?
+          detail::registration_index(first) : 0;
+        for(; i <= detail::registration_index(last); i++)
+          registrations->insert(i);
+      };
+#ifdef _WIN32
+      if(args.test_id)
+        want_tests(*args.test_id, *args.test_id);
+#else
+      for(const auto &range : args.test_ids)
+        want_tests(range.first, range.last);
+#endif
+
+      const suites_list *built_suites;
+      try {
+        built_suites = &materialize([&registrations, &args](
+          std::size_t index, const std::string &name, const attributes &attrs
+        ) {
+          if(registrations && !registrations->count(index))
+            return false;
+          // Every test in the registration's suites starts with its name.
+          return !filter_hides_suite(args.filters, name, attrs);
+        });
+      } catch(const std::exception &e) {
+        report_error(argv[0], e.what());
+        return exit_code::unknown_error;
+      }
+      const suites_list &suites = *built_suites;
+
 #ifdef _WIN32
       if(args.test_id || args.log_fd) {
         if(!args.test_id || !args.log_fd) {
@@ -120,6 +249,21 @@ namespace mettle {
       }
 #endif
 
+      // Index the tests once so that sharding, listing, and every run can
+      // share their names instead of building them again.
+      const test_index index(suites);
+
+      if(args.output_limit && *args.output_limit == 0) {
+        report_error(argv[0], "--output-limit must be at least 1");
+        return exit_code::bad_args;
+      }
+      std::size_t output_limit = args.output_limit.value_or(0);
+#ifndef _WIN32
+      output_capture capture = args.capture;
+#else
+      output_capture capture = output_capture::pipe;
+#endif
+
       test_runner runner;
       if(args.no_subproc) {
         if(args.timeout) {
@@ -127,12 +271,191 @@ namespace mettle {
             argv[0], "--timeout requires running tests in subprocesses"
           );
           return exit_code::bad_args;
+        } else if(args.output_limit) {
+          report_error(
+            argv[0], "--output-limit requires running tests in subprocesses"
+          );
+          return exit_code::bad_args;
+        } else if(!args.limits.empty()) {
+          report_error(
+            argv[0], "--memory-limit and --cpu-limit require running tests in "
+            "subprocesses"
+          );
+          return exit_code::bad_args;
         }
         runner = inline_test_runner;
       } else {
-        runner = subprocess_test_runner(args.timeout);
+#ifdef _WIN32
+        if(!args.limits.empty()) {
+          report_error(
+            argv[0], "--memory-limit and --cpu-limit aren't supported on this "
+            "platform"
+          );
+          return exit_code::bad_args;
+        }
+#endif
+        runner = subprocess_test_runner(args.timeout, output_limit, capture,
+                                        args.limits);
+      }
+
+#ifndef _WIN32
+      if(args.jobs == 0) {
+        report_error(argv[0], "--jobs must be at least 1");
+        return exit_code::bad_args;
+      } else if(args.no_subproc && args.jobs > 1) {
+        report_error(
+          argv[0], "--jobs requires running tests in subprocesses"
+        );
+        return exit_code::bad_args;
+      }
+
+      if(args.batch_size == 0) {
+        report_error(argv[0], "--batch-size must be at least 1");
+        return exit_code::bad_args;
+      } else if(args.no_subproc && args.batch_size > 1) {
+        report_error(
+          argv[0], "--batch-size requires running tests in subprocesses"
+        );
+        return exit_code::bad_args;
+      }
+
+      if(args.no_subproc && capture == output_capture::file) {
+        report_error(
+          argv[0], "--output-capture requires running tests in subprocesses"
+        );
+        return exit_code::bad_args;
+      } else if(args.no_subproc && args.stream_output) {
+        report_error(
+          argv[0], "--stream-output requires running tests in subprocesses"
+        );
+        return exit_code::bad_args;
+      } else if(args.stream_output && args.batch_size > 1) {
+        // Batched tests share their output files, so there's nothing to
+        // stream until each test is done.
+        report_error(argv[0], "--stream-output can't be used with --batch-size");
+        return exit_code::bad_args;
+      } else if(args.stream_output && capture == output_capture::file) {
+        report_error(
+          argv[0], "--stream-output can't be used with --output-capture=file"
+        );
+        return exit_code::bad_args;
+      }
+
+      // Suites that fork after setup need the pool to share their fixtures
+      // between tests, and only the pool can stream output, so use it for
+      // those even when running one test at a time.
+      std::optional<subprocess_test_pool> pool;
+      if(args.jobs > 1 || args.batch_size > 1 ||
+         (!args.no_subproc && (args.stream_output ||
+                               has_shared_setup(index))))
+        pool.emplace(args.jobs, args.timeout, args.batch_size, output_limit,
+                     capture, args.limits);
+#endif
+
+      if(args.fail_fast && *args.fail_fast == 0) {
+        report_error(argv[0], "--fail-fast must be at least 1");
+        return exit_code::bad_args;
+      }
+
+      if(args.shard_count.has_value() != args.shard_index.has_value()) {
+        report_error(
+          argv[0], "--shard-count and --shard-index must be specified together"
+        );
+        return exit_code::bad_args;
+      } else if(args.shard_count && *args.shard_count == 0) {
+        report_error(argv[0], "--shard-count must be at least 1");
+        return exit_code::bad_args;
+      } else if(args.shard_count && *args.shard_index >= *args.shard_count) {
+        report_error(argv[0], "--shard-index must be less than --shard-count");
+        return exit_code::bad_args;
       }
 
+      std::optional<test_history> history;
+      if(args.history) {
+        try {
+          history = test_history::load(*args.history);
+        } catch(const std::exception &e) {
+          report_error(argv[0], e.what());
+          return exit_code::unknown_error;
+        }
+      }
+
+      test_estimator estimate;
+      if(history) {
+        estimate = [&history](const test_name &test)
+          -> std::optional<log::test_duration> {
+          if(auto entry = history->find(test))
+            return entry->duration;
+          return std::nullopt;
+        };
+      }
+
+      // When the mettle driver passes --test-id, it's already picked this
+      // shard's tests out of the whole file. Sharding again would only see
+      // the registrations that were built for those tests, and so could
+      // assign them differently.
+      std::optional<shard_filter<filter_set>> shard;
+#ifdef _WIN32
+      if(args.shard_count && !args.test_id) {
+#else
+      if(args.shard_count && args.test_ids.empty()) {
+#endif
+        shard.emplace(make_shard_filter(
+          index, args.filters, *args.shard_index, *args.shard_count, estimate
+        ));
+      }
+
+#ifndef _WIN32
+      // The mettle driver passes --test-id to run only part of a file when
+      // it's scheduling individual tests across several processes.
+      std::unordered_set<test_uid> test_ids;
+      for(const auto &range : args.test_ids) {
+        for(auto id = range.first; id != range.last; id++)
+          test_ids.insert(id);
+        test_ids.insert(range.last);
+      }
+#endif
+      auto with_filter = [&](auto &&f) {
+        auto restrict_ids = [&](const auto &filter) {
+#ifndef _WIN32
+          if(!test_ids.empty())
+            return f(id_filter(filter, test_ids, index));
+#endif
+          return f(filter);
+        };
+        return shard ? restrict_ids(*shard) : restrict_ids(args.filters);
+      };
+
+      if(args.list || vm.count("list-format")) {
+#ifdef _WIN32
+        if(args.list_as == list_format::binary)
+          _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        write_test_list(std::cout, with_filter([&index](const auto &filter) {
+          return list_tests(index, filter);
+        }), args.list_as);
+        return exit_code::success;
+      }
+
+      std::optional<failure_limit> fail_fast;
+      if(args.fail_fast)
+        fail_fast.emplace(*args.fail_fast);
+      failure_limit *limit = fail_fast ? &*fail_fast : nullptr;
+
+      auto run_filtered = [&](log::test_logger &logger, const auto &filter) {
+#ifndef _WIN32
+        if(pool) {
+          run_tests(index, logger, *pool, filter, args.order, estimate,
+                    limit, args.stream_output);
+          return;
+        }
+#endif
+        run_tests(index, logger, runner, filter, limit);
+      };
+      auto run = [&](log::test_logger &logger) {
+        with_filter([&](const auto &filter) { run_filtered(logger, filter); });
+      };
+
       if(args.output_fd) {
         if(auto output_opt = has_option(output, vm)) {
           using namespace opts::command_line_style;
@@ -146,8 +469,19 @@ namespace mettle {
         io::stream<io::file_descriptor_sink> fds(
           *args.output_fd, io::never_close_handle
         );
-        log::child logger(fds);
-        run_tests(suites, logger, runner, args.filters);
+        // Don't let buffered results sit around for too long, so that the
+        // parent can still report progress on slow tests.
+        log::child_buffering buffering;
+        if(args.output_buffer)
+          buffering = {args.output_buffer, std::chrono::milliseconds(100)};
+
+        if(args.output_protocol == log::child_protocol::binary) {
+          log::binary_child logger(fds, buffering);
+          run(logger);
+        } else {
+          log::child logger(fds, buffering);
+          run(logger);
+        }
         return exit_code::success;
       }
 
@@ -167,14 +501,21 @@ namespace mettle {
         term::enable(std::cout, color_enabled(args.color));
         indenting_ostream out(std::cout);
 
+        auto inner = factory.make(args.output, out, args);
+        if(history)
+          inner = std::make_unique<log::history>(*history, std::move(inner));
         log::summary logger(
-          out, factory.make(args.output, out, args), args.show_time,
-          args.show_terminal
+          out, std::move(inner), args.show_time, args.show_terminal
         );
-        for(std::size_t i = 0; i != args.runs; i++)
-          run_tests(suites, logger, runner, args.filters);
+        for(std::size_t i = 0; i != args.runs; i++) {
+          run(logger);
+          if(fail_fast && fail_fast->reached())
+            break;
+        }
 
         logger.summarize();
+        if(history)
+          history->save(*args.history);
         return logger.good() ? exit_code::success : exit_code::failure;
       } catch(const std::out_of_range &) {
         report_error(argv[0], "unknown output format \"" + args.output + "\"");
@@ -186,4 +527,23 @@ namespace mettle {
     }
   }
 
+  namespace detail {
+
+    METTLE_PUBLIC int
+    drive_tests(int argc, const char *argv[], const suites_list &suites) {
+      return drive(argc, argv, [&suites](const auto &) -> const suites_list & {
+        return suites;
+      });
+    }
+
+    METTLE_PUBLIC int
+    drive_tests(int argc, const char *argv[], suite_registry &registry) {
+      return drive(argc, argv, [&registry](const auto &keep)
+                   -> const suites_list & {
+        return registry.materialize(keep);
+      });
+    }
+
+  }
+
 } // namespace mettle
@@ -1,29 +1,92 @@
 #include <mettle/driver/filters.hpp>
 
+#include <cctype>
+#include <cstring>
+
 namespace mettle {
 
+  namespace {
+    // Get the literal text that every string matching the (ECMAScript) regex
+    // `pattern` must start with, or nothing if the pattern isn't anchored to
+    // the start. This is conservative: it's fine to return less than the
+    // full prefix.
+    std::optional<std::string> literal_prefix(std::string_view pattern) {
+      // An alternation could apply to the anchor, so give up on those.
+      if(pattern.empty() || pattern[0] != '^' ||
+         pattern.find('|') != std::string_view::npos)
+        return std::nullopt;
+
+      std::string prefix;
+      for(std::size_t i = 1; i != pattern.size();) {
+        char c = pattern[i];
+        std::size_t next = i + 1;
+        if(c == '\\') {
+          // Escaped punctuation is literal, but escaped letters and digits
+          // are character classes, assertions, or backreferences.
+          if(next == pattern.size() ||
+             std::isalnum(static_cast<unsigned char>(pattern[next])))
+            break;
+          c = pattern[next++];
+        } else if(std::strchr("^$.|?*+()[]{}", c)) {
+          break;
+        }
+
+        // A quantifier might make this character optional.
+        if(next != pattern.size() && std::strchr("?*{", pattern[next]))
+          break;
+        prefix += c;
+        i = next;
+      }
+      return prefix;
+    }
+  }
+
   filter_result attr_filter::operator ()(const test_name &,
                                          const attributes &attrs) const {
     using namespace detail;
 
-    std::set<const attr_instance*> explicitly_shown;
-    for(const auto &f : filters_) {
-      auto i = attrs.find(f.attribute);
+    for(std::size_t n = 0; n != filters_.size(); n++) {
+      const auto &f = filters_[n];
+      auto i = attrs.find(f.attribute, ids_[n]);
       const attr_instance *attr = i == attrs.end() ? nullptr: &*i;
 
       if(!f.func(attr))
         return {test_action::hide, attr ? stringify(joined(attr->value)) : ""};
-      else if(attr)
-        explicitly_shown.insert(attr);
     }
+    if(!attrs.has_skip())
+      return test_action::run;
+
+    // Every filter passed, so any attribute one of them named was explicitly
+    // asked for, and shouldn't cause the test to be skipped.
+    auto explicitly_shown = [this](const attr_instance &attr) {
+      for(std::size_t n = 0; n != filters_.size(); n++) {
+        if(ids_[n] == attr.attribute().id() &&
+           filters_[n].attribute == attr.attribute().name())
+          return true;
+      }
+      return false;
+    };
     for(const auto &attr : attrs) {
-      if(attr.attribute.action() == test_action::skip &&
-         !explicitly_shown.count(&attr))
+      if(attr.attribute().action() == test_action::skip &&
+         !explicitly_shown(attr))
         return {test_action::skip, stringify(joined(attr.value))};
     }
     return test_action::run;
   }
 
+  bool attr_filter::hides_suite(std::string_view,
+                                const attributes &attrs) const {
+    // Every test in the suite has the suite's attributes, so if a filter
+    // rejects any instance of one of them, it rejects all those tests.
+    for(std::size_t n = 0; n != filters_.size(); n++) {
+      const auto &f = filters_[n];
+      if(f.if_present == false &&
+         attrs.find(f.attribute, ids_[n]) != attrs.end())
+        return true;
+    }
+    return false;
+  }
+
   filter_result attr_filter_set::operator ()(const test_name &name,
                                              const attributes &attrs) const {
     if(filters_.empty())
@@ -55,16 +118,55 @@ namespace mettle {
     return result;
   }
 
+  bool attr_filter_set::hides_suite(std::string_view prefix,
+                                    const attributes &attrs) const {
+    if(filters_.empty())
+      return false;
+    for(const auto &f : filters_) {
+      if(!f.hides_suite(prefix, attrs))
+        return false;
+    }
+    return true;
+  }
+
   filter_result name_filter_set::operator ()(const test_name &name,
+                                             const attributes &attrs) const {
+    if(filters_.empty())
+      return test_action::indeterminate;
+    return (*this)(name, name.full_name(), attrs);
+  }
+
+  filter_result name_filter_set::operator ()(const test_name &,
+                                             std::string_view full_name,
                                              const attributes &) const {
     if(filters_.empty())
       return test_action::indeterminate;
 
     for(const auto &f : filters_) {
-      if(std::regex_search(name.full_name(), f))
+      if(std::regex_search(full_name.begin(), full_name.end(), f))
         return test_action::run;
     }
     return test_action::hide;
   }
 
+  bool name_filter_set::hides_suite(std::string_view prefix,
+                                    const attributes &) const {
+    if(filters_.empty())
+      return false;
+
+    // A name can start with both `prefix` and a pattern's literal prefix only
+    // if one of them starts with the other.
+    for(const auto &p : prefixes_) {
+      if(!p || std::string_view(*p).starts_with(prefix) ||
+         prefix.starts_with(*p))
+        return false;
+    }
+    return true;
+  }
+
+  void name_filter_set::insert(const std::string &pattern) {
+    filters_.emplace_back(pattern);
+    prefixes_.push_back(literal_prefix(pattern));
+  }
+
 } // namespace mettle
@@ -0,0 +1,201 @@
+#include <mettle/driver/list_tests.hpp>
+
+#include <cstdio>
+#include <stdexcept>
+
+#include <mettle/driver/log/frame.hpp>
+
+namespace mettle {
+
+  namespace {
+    void write_json_string(std::ostream &out, const std::string &value) {
+      out << '"';
+      for(char c : value) {
+        switch(c) {
+        case '"':  out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\b': out << "\\b";  break;
+        case '\f': out << "\\f";  break;
+        case '\n': out << "\\n";  break;
+        case '\r': out << "\\r";  break;
+        case '\t': out << "\\t";  break;
+        default:
+          if(static_cast<unsigned char>(c) < 0x20) {
+            char buf[7];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out << buf;
+          } else {
+            out << c;
+          }
+        }
+      }
+      out << '"';
+    }
+
+    void write_text(std::ostream &out, const std::vector<listed_test> &tests) {
+      for(const auto &test : tests) {
+        out << "#" << test.name.id << " " << test.name.full_name();
+        if(!test.name.file.empty())
+          out << " (" << test.name.file << ":" << test.name.line << ")";
+
+        if(!test.attrs.empty()) {
+          out << " [";
+          bool first = true;
+          for(const auto &attr : test.attrs) {
+            if(!first)
+              out << ", ";
+            first = false;
+
+            out << attr.attribute().name();
+            bool first_value = true;
+            for(const auto &v : attr.value) {
+              out << (first_value ? "=" : ",") << v;
+              first_value = false;
+            }
+          }
+          out << "]";
+        }
+
+        if(test.skipped)
+          out << " SKIPPED";
+        out << "\n";
+      }
+    }
+
+    void write_json(std::ostream &out, const std::vector<listed_test> &tests) {
+      out << "[";
+      bool first = true;
+      for(const auto &test : tests) {
+        out << (first ? "\n" : ",\n") << "  {\"id\": " << test.name.id
+            << ", \"suites\": [";
+        first = false;
+
+        bool first_suite = true;
+        for(const auto &suite : test.name.suites) {
+          if(!first_suite)
+            out << ", ";
+          first_suite = false;
+          write_json_string(out, suite);
+        }
+
+        out << "], \"name\": ";
+        write_json_string(out, test.name.name);
+        out << ", \"file\": ";
+        write_json_string(out, test.name.file);
+        out << ", \"line\": " << test.name.line << ", \"attributes\": {";
+
+        bool first_attr = true;
+        for(const auto &attr : test.attrs) {
+          if(!first_attr)
+            out << ", ";
+          first_attr = false;
+
+          write_json_string(out, attr.attribute().name());
+          out << ": [";
+          bool first_value = true;
+          for(const auto &v : attr.value) {
+            if(!first_value)
+              out << ", ";
+            first_value = false;
+            write_json_string(out, v);
+          }
+          out << "]";
+        }
+        out << "}, \"skipped\": " << (test.skipped ? "true" : "false") << "}";
+      }
+      out << (first ? "]\n" : "\n]\n");
+    }
+
+    void write_binary(std::ostream &out,
+                      const std::vector<listed_test> &tests) {
+      using namespace log;
+      frame::writer w;
+      frame::interner names;
+      auto send = [&out, &w]() {
+        auto &data = w.end();
+        out.write(data.data(), data.size());
+      };
+
+      for(const auto &test : tests) {
+        auto [suites_id, new_suites] = names.suites(test.name.suites);
+        if(new_suites) {
+          w.begin(frame::event_type::define_suites);
+          w.u64(suites_id);
+          w.suites(test.name.suites);
+          send();
+        }
+
+        auto [file_id, new_file] = names.file(test.name.file);
+        if(new_file) {
+          w.begin(frame::event_type::define_file);
+          w.u64(file_id);
+          w.str(test.name.file);
+          send();
+        }
+
+        w.begin(frame::event_type::listed_test);
+        w.test(test.name, suites_id, file_id);
+        w.u64(test.skipped);
+        w.attrs(test.attrs);
+        send();
+      }
+    }
+  }
+
+  void write_test_list(std::ostream &out, const std::vector<listed_test> &tests,
+                       list_format format) {
+    switch(format) {
+    case list_format::text:
+      write_text(out, tests);
+      break;
+    case list_format::json:
+      write_json(out, tests);
+      break;
+    case list_format::binary:
+      write_binary(out, tests);
+      break;
+    }
+    out.flush();
+  }
+
+  std::vector<test_name> read_test_list(std::string_view data) {
+    using namespace log;
+    frame::name_table names;
+    std::vector<test_name> tests;
+    while(!data.empty()) {
+      auto size = frame::frame_size(data);
+      if(size == 0)
+        throw std::runtime_error("unexpected end of test list");
+      auto [type, payload_size] = frame::read_header(data);
+      frame::reader r(data.substr(frame::header_size, payload_size));
+      data.remove_prefix(size);
+
+      switch(type) {
+      case frame::event_type::define_suites: {
+        auto id = r.u64();
+        names.define_suites(id, r.suites());
+        break;
+      }
+      case frame::event_type::define_file: {
+        auto id = r.u64();
+        names.define_file(id, r.str());
+        break;
+      }
+      case frame::event_type::listed_test: {
+        test_name test;
+        test.id = r.u64();
+        test.suites = names.suites(r.u64());
+        test.name = r.str();
+        test.file = names.file(r.u64());
+        test.line = static_cast<long long>(r.u64());
+        tests.push_back(std::move(test));
+        break;
+      }
+      default:
+        throw std::runtime_error("unexpected event in test list");
+      }
+    }
+    return tests;
+  }
+
+} // namespace mettle
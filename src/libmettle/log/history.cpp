@@ -0,0 +1,71 @@
+#include <mettle/driver/log/history.hpp>
+
+namespace mettle::log {
+
+  history::history(test_history &history, std::unique_ptr<file_logger> &&log)
+    : history_(history), log_(std::move(log)) {}
+
+  void history::started_run() {
+    if(log_) log_->started_run();
+  }
+
+  void history::ended_run() {
+    if(log_) log_->ended_run();
+  }
+
+  void history::started_suite(const std::vector<std::string> &suites) {
+    if(log_) log_->started_suite(suites);
+  }
+
+  void history::ended_suite(const std::vector<std::string> &suites) {
+    if(log_) log_->ended_suite(suites);
+  }
+
+  void history::started_test(const test_name &test) {
+    if(log_) log_->started_test(test);
+  }
+
+  void history::passed_test(const test_name &test, const test_output &output,
+                            test_duration duration) {
+    history_.record(test, duration, true);
+    file_duration_ += duration;
+    if(log_) log_->passed_test(test, output, duration);
+  }
+
+  void history::failed_test(const test_name &test, const std::string &message,
+                            const test_output &output,
+                            test_duration duration) {
+    history_.record(test, duration, false);
+    file_duration_ += duration;
+    file_passed_ = false;
+    if(log_) log_->failed_test(test, message, output, duration);
+  }
+
+  void history::skipped_test(const test_name &test,
+                             const std::string &message) {
+    if(log_) log_->skipped_test(test, message);
+  }
+
+  void history::test_output_chunk(const test_name &test, output_stream stream,
+                                  std::string_view data) {
+    if(log_) log_->test_output_chunk(test, stream, data);
+  }
+
+  void history::started_file(const test_file &file) {
+    file_duration_ = test_duration(0);
+    file_passed_ = true;
+    if(log_) log_->started_file(file);
+  }
+
+  void history::ended_file(const test_file &file) {
+    history_.record_file(file.name, file_duration_, file_passed_);
+    if(log_) log_->ended_file(file);
+  }
+
+  void history::failed_file(const test_file &file,
+                            const std::string &message) {
+    history_.record_file(file.name, file_duration_, false);
+    if(log_) log_->failed_file(file, message);
+  }
+
+} // namespace mettle::log
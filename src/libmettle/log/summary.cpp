@@ -7,6 +7,8 @@
 
 #include <mettle/driver/log/term.hpp>
 
+#include "write_log.hpp"
+
 namespace mettle::log {
 
   summary::summary(indenting_ostream &out, std::unique_ptr<file_logger> &&log,
@@ -63,6 +65,11 @@ namespace mettle::log {
     add_unpass(test.id, test.full_name(), skip).skip_message = message;
   }
 
+  void summary::test_output_chunk(const test_name &test, output_stream stream,
+                                  std::string_view data) {
+    if(log_) log_->test_output_chunk(test, stream, data);
+  }
+
   void summary::started_file(const test_file &file) {
     if(log_) log_->started_file(file);
   }
@@ -198,14 +205,10 @@ namespace mettle::log {
     if(extra_newline && has_output)
       out_ << std::endl;
 
-    if(!output.stdout_log.empty()) {
-      out_ << format(fg(color::yellow), sgr::underline) << "stdout" << reset()
-           << ":" << std::endl << output.stdout_log << std::endl;
-    }
-    if(!output.stderr_log.empty()) {
-      out_ << format(fg(color::yellow), sgr::underline) << "stderr" << reset()
-           << ":" << std::endl << output.stderr_log << std::endl;
-    }
+    if(!output.stdout_log.empty())
+      write_log(out_, "stdout", output.stdout_log, output.stdout_elided);
+    if(!output.stderr_log.empty())
+      write_log(out_, "stderr", output.stderr_log, output.stderr_elided);
   }
 
 } // namespace mettle::log
@@ -4,6 +4,8 @@
 
 #include <mettle/driver/log/term.hpp>
 
+#include "write_log.hpp"
+
 namespace mettle::log {
 
   verbose::verbose(indenting_ostream &out, std::size_t runs, bool show_time,
@@ -51,36 +53,42 @@ namespace mettle::log {
 
   void verbose::started_test(const test_name &test) {
     out_ << test.name << " " << std::flush;
+    current_test_ = test.id;
   }
 
-  void verbose::passed_test(const test_name &, const test_output &output,
+  void verbose::passed_test(const test_name &test, const test_output &output,
                             test_duration duration) {
     using namespace term;
+    bool streamed = end_stream(test);
     out_ << format(sgr::bold, fg(color::green)) << "PASSED" << reset();
     summarize_output(output);
-    log_time(duration);
+    log_time(duration, output);
     out_ << std::endl;
 
     scoped_indent si(out_);
-    log_output(output, false);
+    if(!streamed)
+      log_output(output, false);
   }
 
-  void verbose::failed_test(const test_name &, const std::string &message,
+  void verbose::failed_test(const test_name &test, const std::string &message,
                             const test_output &output, test_duration duration) {
     using namespace term;
+    bool streamed = end_stream(test);
     out_ << format(sgr::bold, fg(color::red)) << "FAILED" << reset();
     summarize_output(output);
-    log_time(duration);
+    log_time(duration, output);
     out_ << std::endl;
 
     scoped_indent si(out_);
     if(!message.empty())
       out_ << message << std::endl;
-    log_output(output, !message.empty());
+    if(!streamed)
+      log_output(output, !message.empty());
   }
 
   void verbose::skipped_test(const test_name &, const std::string &message) {
     using namespace term;
+    current_test_.reset();
     out_ << format(sgr::bold, fg(color::blue)) << "SKIPPED" << reset()
          << std::endl;
 
@@ -90,6 +98,38 @@ namespace mettle::log {
     }
   }
 
+  void verbose::test_output_chunk(const test_name &test, output_stream,
+                                  std::string_view data) {
+    // Only the test on the current line can print its output as it runs; any
+    // others (e.g. when running in parallel) are logged once they finish.
+    if(!show_terminal_ || data.empty() || current_test_ != test.id)
+      return;
+
+    if(!streamed_) {
+      out_ << std::endl;
+      out_.indent(1, indent_style::logical);
+      streamed_ = true;
+    }
+    out_.write(data.data(), static_cast<std::streamsize>(data.size()));
+    out_.flush();
+    stream_newline_ = data.back() == '\n';
+  }
+
+  // Finish a test's streamed output (if any) and repeat its name so that its
+  // result is still shown next to it. Returns true if output was streamed.
+  bool verbose::end_stream(const test_name &test) {
+    current_test_.reset();
+    if(!streamed_)
+      return false;
+
+    if(!stream_newline_)
+      out_ << std::endl;
+    out_.indent(-1, indent_style::logical);
+    out_ << test.name << " ";
+    streamed_ = false;
+    return true;
+  }
+
   void verbose::started_file(const test_file &) {}
 
   void verbose::ended_file(const test_file &) {
@@ -112,11 +152,18 @@ namespace mettle::log {
     out_ << message << std::endl;
   }
 
-  void verbose::log_time(test_duration duration) const {
+  void verbose::log_time(test_duration duration,
+                         const test_output &output) const {
     using namespace term;
     if(show_time_) {
       out_ << " " << format(sgr::bold, fg(color::black)) << "("
-           << duration.count() << " ms)" << reset();
+           << duration.count() << " ms";
+      if(auto &r = output.resources) {
+        using std::chrono::duration_cast;
+        out_ << ", " << duration_cast<test_duration>(r->cpu_time()).count()
+             << " ms cpu, " << r->max_rss / 1024 << " KiB rss";
+      }
+      out_ << ")" << reset();
     }
   }
 
@@ -138,14 +185,10 @@ namespace mettle::log {
     if(extra_newline)
       out_ << std::endl;
 
-    if(!output.stdout_log.empty()) {
-      out_ << format(fg(color::yellow), sgr::underline) << "stdout" << reset()
-           << ":" << std::endl << output.stdout_log << std::endl;
-    }
-    if(!output.stderr_log.empty()) {
-      out_ << format(fg(color::yellow), sgr::underline) << "stderr" << reset()
-           << ":" << std::endl << output.stderr_log << std::endl;
-    }
+    if(!output.stdout_log.empty())
+      write_log(out_, "stdout", output.stdout_log, output.stdout_elided);
+    if(!output.stderr_log.empty())
+      write_log(out_, "stderr", output.stderr_log, output.stderr_elided);
   }
 
 } // namespace mettle::log
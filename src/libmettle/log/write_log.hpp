@@ -0,0 +1,32 @@
+#ifndef INC_METTLE_SRC_LIBMETTLE_LOG_WRITE_LOG_HPP
+#define INC_METTLE_SRC_LIBMETTLE_LOG_WRITE_LOG_HPP
+
+#include <cstddef>
+#include <string>
+
+#include <mettle/driver/log/core.hpp>
+#include <mettle/driver/log/indent.hpp>
+#include <mettle/driver/log/term.hpp>
+
+namespace mettle::log {
+
+  // Write one of a test's logs (stdout or stderr) under a heading, noting
+  // where any bytes were elided from the middle of it.
+  inline void write_log(indenting_ostream &out, const char *name,
+                        const std::string &log, std::size_t elided) {
+    using namespace term;
+    auto [head, tail] = split_elided(log, elided);
+    out << format(fg(color::yellow), sgr::underline) << name << reset()
+        << ":" << std::endl << head;
+    if(elided) {
+      if(!head.empty() && head.back() != '\n')
+        out << std::endl;
+      out << format(fg(color::yellow)) << "[... " << elided
+          << " bytes elided ...]" << reset() << std::endl;
+    }
+    out << tail << std::endl;
+  }
+
+} // namespace mettle::log
+
+#endif
@@ -29,16 +29,64 @@ namespace mettle::log {
     return e;
   }
 
+  static std::string log_text(const std::string &log, std::size_t elided) {
+    if(!elided)
+      return log;
+    auto [head, tail] = split_elided(log, elided);
+    std::string text(head);
+    text += "\n[... " + std::to_string(elided) + " bytes elided ...]\n";
+    text += tail;
+    return text;
+  }
+
+  static void append_property(xml::element_ptr &properties, std::string name,
+                              std::string value) {
+    auto e = xml::element::make("property");
+    e->attr("name", std::move(name));
+    e->attr("value", std::move(value));
+    properties->append_child(std::move(e));
+  }
+
+  static void append_test_resources(xml::element_ptr &test,
+                                    const test_output &output) {
+    if(!output.resources)
+      return;
+
+    using seconds = std::chrono::duration<
+      double, std::chrono::seconds::period
+    >;
+    auto &r = *output.resources;
+    auto properties = xml::element::make("properties");
+    append_property(properties, "user_time",
+                    std::to_string(seconds(r.user_time).count()));
+    append_property(properties, "system_time",
+                    std::to_string(seconds(r.system_time).count()));
+    append_property(properties, "max_rss", std::to_string(r.max_rss));
+    append_property(properties, "minor_faults",
+                    std::to_string(r.minor_faults));
+    append_property(properties, "major_faults",
+                    std::to_string(r.major_faults));
+    append_property(properties, "voluntary_context_switches",
+                    std::to_string(r.voluntary_switches));
+    append_property(properties, "involuntary_context_switches",
+                    std::to_string(r.involuntary_switches));
+    test->append_child(std::move(properties));
+  }
+
   static void append_test_output(xml::element_ptr &test,
                                  const test_output &output) {
     if(!output.stdout_log.empty()) {
       auto sysout = xml::element::make("system-out");
-      sysout->append_child(xml::text::make(output.stdout_log));
+      sysout->append_child(xml::text::make(
+        log_text(output.stdout_log, output.stdout_elided)
+      ));
       test->append_child(std::move(sysout));
     }
     if(!output.stderr_log.empty()) {
       auto syserr = xml::element::make("system-err");
-      syserr->append_child(xml::text::make(output.stderr_log));
+      syserr->append_child(xml::text::make(
+        log_text(output.stderr_log, output.stderr_elided)
+      ));
       test->append_child(std::move(syserr));
     }
   }
@@ -89,6 +137,7 @@ namespace mettle::log {
     auto &suite = current_suite();
     auto t = test_element(test);
     t->attr("time", get_duration(duration));
+    append_test_resources(t, output);
     append_test_output(t, output);
     suite.elt->append_child(std::move(t));
     tests_++;
@@ -101,6 +150,7 @@ namespace mettle::log {
     auto &suite = current_suite();
     auto t = test_element(test);
     t->attr("time", get_duration(duration));
+    append_test_resources(t, output);
     t->append_child(message_element("failure", message));
     append_test_output(t, output);
     suite.elt->append_child(std::move(t));
@@ -0,0 +1,209 @@
+#include <mettle/driver/posix/child_monitor.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#  include <sys/epoll.h>
+#  include <sys/syscall.h>
+#else
+#  include <sys/select.h>
+#endif
+
+namespace mettle::posix {
+
+  namespace {
+#ifdef __linux__
+    int pidfd_open(pid_t pid) {
+#  ifdef SYS_pidfd_open
+      return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#  else
+      (void)pid;
+      errno = ENOSYS;
+      return -1;
+#  endif
+    }
+
+    int timeout_ms(const timespec *timeout) {
+      if(!timeout)
+        return -1;
+
+      // Round up so that we don't wake up just before the deadline.
+      long long ms = static_cast<long long>(timeout->tv_sec) * 1000 +
+                     (timeout->tv_nsec + 999999) / 1000000;
+      return static_cast<int>(std::min<long long>(ms, INT_MAX));
+    }
+#endif
+  }
+
+  int child_monitor::open() {
+#ifdef __linux__
+    if((epoll_fd_ = epoll_create1(EPOLL_CLOEXEC)) < 0)
+      return -1;
+#endif
+    open_ = true;
+    return 0;
+  }
+
+  int child_monitor::close() {
+    if(!open_)
+      return 0;
+
+    int err = 0;
+    for(const auto &i : watches_) {
+      if(i.second.type == event_type::exited && ::close(i.first) < 0)
+        err = -1;
+    }
+    watches_.clear();
+    polled_children_.clear();
+
+    if(epoll_fd_ >= 0 && ::close(epoll_fd_) < 0)
+      err = -1;
+    epoll_fd_ = -1;
+    open_ = false;
+    return err;
+  }
+
+  int child_monitor::watch_fd(int fd, void *data) {
+    return add(fd, {event_type::readable, 0, data});
+  }
+
+  int child_monitor::unwatch_fd(int fd) {
+    return remove(fd);
+  }
+
+  int child_monitor::watch_child(pid_t pid, void *data) {
+#ifdef __linux__
+    int pidfd = pidfd_open(pid);
+    if(pidfd >= 0) {
+      if(add(pidfd, {event_type::exited, pid, data}) < 0) {
+        int err = errno;
+        ::close(pidfd);
+        errno = err;
+        return -1;
+      }
+      return 0;
+    } else if(errno != ENOSYS) {
+      return -1;
+    }
+#endif
+
+    polled_children_.push_back({pid, data});
+    return 0;
+  }
+
+  int child_monitor::unwatch_child(pid_t pid) {
+    auto w = std::find_if(watches_.begin(), watches_.end(), [pid](auto &&i) {
+      return i.second.type == event_type::exited && i.second.pid == pid;
+    });
+    if(w != watches_.end()) {
+      int pidfd = w->first;
+      int err = remove(pidfd);
+      if(::close(pidfd) < 0)
+        err = -1;
+      return err;
+    }
+
+    auto c = std::find_if(
+      polled_children_.begin(), polled_children_.end(),
+      [pid](auto &&i) { return i.pid == pid; }
+    );
+    if(c == polled_children_.end()) {
+      errno = ENOENT;
+      return -1;
+    }
+    polled_children_.erase(c);
+    return 0;
+  }
+
+  int child_monitor::wait(std::vector<event> &events, const timespec *timeout,
+                          const sigset_t *sigmask) {
+    events.clear();
+
+    // Check any children we can't watch directly without reaping them. If
+    // one has already exited, don't block waiting for anything else.
+    for(const auto &c : polled_children_) {
+      siginfo_t info;
+      info.si_pid = 0;
+      if(waitid(P_PID, c.pid, &info, WEXITED | WNOHANG | WNOWAIT) < 0)
+        return -1;
+      if(info.si_pid != 0)
+        events.push_back({event_type::exited, c.data});
+    }
+
+    timespec zero = {0, 0};
+    if(!events.empty())
+      timeout = &zero;
+
+#ifdef __linux__
+    std::vector<epoll_event> ready(std::max<std::size_t>(watches_.size(), 1));
+    int rv = epoll_pwait(epoll_fd_, ready.data(), ready.size(),
+                         timeout_ms(timeout), sigmask);
+    if(rv < 0)
+      return events.empty() ? rv : events.size();
+
+    for(int i = 0; i != rv; i++) {
+      const auto &w = watches_.at(ready[i].data.fd);
+      events.push_back({w.type, w.data});
+    }
+#else
+    int maxfd = -1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    for(const auto &i : watches_) {
+      maxfd = std::max(maxfd, i.first);
+      FD_SET(i.first, &fds);
+    }
+
+    int rv = pselect(maxfd + 1, &fds, nullptr, nullptr, timeout, sigmask);
+    if(rv < 0)
+      return events.empty() ? rv : events.size();
+
+    for(const auto &i : watches_) {
+      if(FD_ISSET(i.first, &fds))
+        events.push_back({i.second.type, i.second.data});
+    }
+#endif
+
+    return events.size();
+  }
+
+  int child_monitor::add(int fd, const watch &w) {
+#ifdef __linux__
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+      return -1;
+#endif
+
+    try {
+      watches_.emplace(fd, w);
+    } catch(...) {
+#ifdef __linux__
+      epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#endif
+      errno = ENOMEM;
+      return -1;
+    }
+    return 0;
+  }
+
+  int child_monitor::remove(int fd) {
+    if(watches_.erase(fd) == 0) {
+      errno = ENOENT;
+      return -1;
+    }
+
+#ifdef __linux__
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#else
+    return 0;
+#endif
+  }
+
+} // namespace mettle::posix
@@ -1,26 +1,15 @@
 #include <mettle/driver/posix/subprocess.hpp>
 
-#include <cassert>
-#include <initializer_list>
-#include <thread>
-
-#include <pthread.h>
-#include <signal.h>
-#include <sys/select.h>
-#include <sys/wait.h>
+#include <algorithm>
+#include <cerrno>
+
 #include <unistd.h>
 
-#include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/log/core.hpp>
 
 namespace mettle::posix {
 
   namespace {
-    [[noreturn]] void monitor_failed(std::initializer_list<int> pids = {}) {
-      for(int pid : pids)
-        kill(pid, SIGKILL);
-      _exit(exit_code::fatal);
-    }
-
     inline int size_to_status(int size) {
       if(size < 0)
         return size;
@@ -31,72 +20,97 @@ namespace mettle::posix {
     }
   }
 
-  void make_timeout_monitor(std::chrono::milliseconds timeout) {
-    pid_t timer_pid;
-    if((timer_pid = fork()) < 0)
-      monitor_failed();
-    if(timer_pid == 0) {
-      std::this_thread::sleep_for(timeout);
-      _exit(exit_code::timeout);
-    }
-
-    pid_t test_pid;
-    if((test_pid = fork()) < 0)
-      monitor_failed({timer_pid});
-    if(test_pid != 0) {
-      // Wait for the first child process (the timer or the test) to finish,
-      // then kill (and wait) for the other one. If the timer finishes first,
-      // kill the test's entire process group.
-      int status;
-      pid_t exited_pid;
-      if((exited_pid = wait(&status)) < 0)
-        monitor_failed({timer_pid, test_pid});
-      if(kill(exited_pid == test_pid ? timer_pid : test_pid, SIGKILL) < 0)
-        monitor_failed({timer_pid, test_pid});
-      wait(nullptr);
-
-      if(WIFEXITED(status))
-        _exit(WEXITSTATUS(status));
-      else // WIFSIGNALED
-        raise(WTERMSIG(status));
-    }
+  timespec to_timespec(std::chrono::nanoseconds duration) {
+    if(duration.count() < 0)
+      return {0, 0};
+    using namespace std::chrono;
+    auto secs = duration_cast<seconds>(duration);
+    return {static_cast<time_t>(secs.count()),
+            static_cast<long>((duration - secs).count())};
   }
 
   int read_into(std::vector<readfd> &dests, const timespec *timeout,
                 const sigset_t *sigmask) {
-    while(true) {
-      int maxfd = -1;
-      fd_set fds;
-      FD_ZERO(&fds);
-      for(const auto &i : dests) {
-        if(i.fd >= 0) {
-          maxfd = std::max(maxfd, i.fd);
-          FD_SET(i.fd, &fds);
-        }
+    child_monitor monitor;
+    if(monitor.open() < 0)
+      return -1;
+    return read_into(dests, monitor, timeout, sigmask);
+  }
+
+  int read_into(std::vector<readfd> &dests, child_monitor &monitor,
+                const timespec *timeout, const sigset_t *sigmask) {
+    using namespace std::chrono;
+    steady_clock::time_point deadline;
+    if(timeout) {
+      deadline = steady_clock::now() + seconds(timeout->tv_sec) +
+                 nanoseconds(timeout->tv_nsec);
+    }
+
+    // Leave `monitor` as we found it so that it can be used again, keeping
+    // `errno` from whatever made us stop.
+    auto unwatch_all = [&dests, &monitor](int rv) {
+      int err = errno;
+      for(auto &i : dests) {
+        if(i.fd >= 0)
+          monitor.unwatch_fd(i.fd);
       }
-      if(maxfd < 0)
+      errno = err;
+      return rv;
+    };
+
+    for(auto &i : dests) {
+      if(i.fd >= 0 && monitor.watch_fd(i.fd, &i) < 0)
+        return unwatch_all(-1);
+    }
+
+    std::vector<child_monitor::event> events;
+    while(true) {
+      if(std::none_of(dests.begin(), dests.end(),
+                      [](auto &&i) { return i.fd >= 0; }))
         return 0;
 
-      int rv = pselect(maxfd + 1, &fds, nullptr, nullptr, timeout, sigmask);
+      timespec remaining;
+      if(timeout)
+        remaining = to_timespec(deadline - steady_clock::now());
+
+      int rv = monitor.wait(events, timeout ? &remaining : nullptr, sigmask);
       if(rv <= 0)
-        return rv;
+        return unwatch_all(rv);
 
-      for(auto &i : dests) {
-        if(i.fd >= 0 && FD_ISSET(i.fd, &fds)) {
-          ssize_t size;
-          char buf[BUFSIZ];
-
-          if((size = read(i.fd, buf, sizeof(buf))) < 0)
-            return size;
-          if(size == 0)
-            i.fd = -i.fd;
-          else
-            i.dest->append(buf, size);
-        }
+      for(const auto &e : events) {
+        if(read_chunk(*static_cast<readfd*>(e.data), monitor) < 0)
+          return unwatch_all(-1);
       }
     }
   }
 
+  int read_chunk(readfd &src, child_monitor &monitor) {
+    ssize_t size;
+    char buf[BUFSIZ];
+
+    if((size = read(src.fd, buf, sizeof(buf))) < 0)
+      return -1;
+    if(size == 0) {
+      if(monitor.unwatch_fd(src.fd) < 0)
+        return -1;
+      src.fd = -src.fd;
+    } else {
+      if(src.on_chunk)
+        src.on_chunk({buf, static_cast<std::size_t>(size)});
+      src.dest->append(buf, size);
+      // Only trim once we've read well past the limit so that we aren't
+      // shuffling the tail around after every chunk.
+      if(src.limit && src.dest->size() > 2 * src.limit)
+        finish_read(src);
+    }
+    return 0;
+  }
+
+  void finish_read(readfd &src) {
+    if(src.limit)
+      log::elide_log(*src.dest, *src.elided, src.limit);
+  }
+
   int send_pgid(int fd, int pgid) {
     return size_to_status( write(fd, &pgid, sizeof(pgid)) );
   }
@@ -4,8 +4,17 @@
 #include <poll.h>
 #include <signal.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
 #include <sstream>
 
 #include <mettle/detail/source_location.hpp>
@@ -13,6 +22,7 @@
 #include <mettle/driver/posix/scoped_pipe.hpp>
 #include <mettle/driver/posix/scoped_signal.hpp>
 #include <mettle/driver/posix/subprocess.hpp>
+#include <mettle/suite/detail/test_caller.hpp>
 
 #include "../../err_string.hpp"
 
@@ -35,12 +45,12 @@ namespace mettle {
   using namespace posix;
 
   namespace {
-    pid_t test_pgid = 0;
+    std::vector<pid_t> test_pgids;
     struct sigaction old_sigint, old_sigquit;
 
     void sig_handler(int signum) {
-      assert(test_pgid != 0);
-      killpg(test_pgid, signum);
+      for(pid_t pgid : test_pgids)
+        killpg(pgid, signum);
 
       // Restore the previous signal action and re-raise the signal.
       struct sigaction *old_act = signum == SIGINT ? &old_sigint : &old_sigquit;
@@ -50,12 +60,14 @@ namespace mettle {
 
     void sig_chld(int) {}
 
+    void forget_pgid(pid_t pgid) {
+      auto i = std::find(test_pgids.begin(), test_pgids.end(), pgid);
+      if(i != test_pgids.end())
+        test_pgids.erase(i);
+    }
+
     test_result parent_failed(detail::source_location loc =
                                 detail::source_location::current()) {
-      if(test_pgid)
-        killpg(test_pgid, SIGKILL);
-      test_pgid = 0;
-
       std::ostringstream ss;
       ss << "Fatal error at " << loc.file_name() << ":" << loc.line() << "\n"
          << err_string(errno);
@@ -70,45 +82,585 @@ namespace mettle {
     void atfork_close_fd() {
       close(fd_to_close);
     }
+
+    // The limits a child started with, so that a test in a batch without any
+    // limits of its own can go back to them.
+    struct base_limits {
+      struct rlimit address_space, cpu;
+      std::new_handler new_handler;
+    };
+
+    int get_base_limits(base_limits &base) {
+      if(getrlimit(RLIMIT_AS, &base.address_space) < 0 ||
+         getrlimit(RLIMIT_CPU, &base.cpu) < 0)
+        return -1;
+      base.new_handler = std::get_new_handler();
+      return 0;
+    }
+
+    // When a test runs out of memory, operator new calls this instead of
+    // throwing `std::bad_alloc`, so that the parent can tell the test was
+    // stopped by its limit (rather than the test handling the failure
+    // itself).
+    void exceeded_memory() {
+      fflush(nullptr);
+      _exit(exit_code::out_of_memory);
+    }
+
+    rlim_t clamp_limit(std::uint64_t value, rlim_t max) {
+      if(max != RLIM_INFINITY && value > max)
+        return max;
+      return static_cast<rlim_t>(value);
+    }
+
+    // Apply a test's limits to the current process. The CPU time limit counts
+    // from now, since a batch may have already used some.
+    int apply_limits(const resource_limits &limits, const base_limits &base) {
+      struct rlimit address_space = base.address_space, cpu = base.cpu;
+      if(limits.max_rss) {
+        address_space.rlim_cur = clamp_limit(*limits.max_rss,
+                                             address_space.rlim_max);
+      }
+      if(limits.cpu_time) {
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) < 0)
+          return -1;
+        // RLIMIT_CPU is in whole seconds, so round up what we've used so far.
+        std::uint64_t used = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                             (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec +
+                              999999) / 1000000;
+        cpu.rlim_cur = clamp_limit(used + limits.cpu_time->count(),
+                                   cpu.rlim_max);
+      }
+
+      if(setrlimit(RLIMIT_AS, &address_space) < 0 ||
+         setrlimit(RLIMIT_CPU, &cpu) < 0)
+        return -1;
+      std::set_new_handler(limits.max_rss ? exceeded_memory : base.new_handler);
+      return 0;
+    }
+
+    // If a test was stopped for going over its limits, say so.
+    std::optional<test_result>
+    exceeded_limits(int status, const resource_limits &limits) {
+      if(limits.max_rss && WIFEXITED(status) &&
+         WEXITSTATUS(status) == exit_code::out_of_memory) {
+        return test_result{false, "Exceeded memory limit of " +
+                           format_memory_size(*limits.max_rss)};
+      } else if(limits.cpu_time && WIFSIGNALED(status) &&
+                WTERMSIG(status) == SIGXCPU) {
+        return test_result{false, "Exceeded CPU time limit of " +
+                           std::to_string(limits.cpu_time->count()) + " s"};
+      }
+      return std::nullopt;
+    }
   }
 
+  namespace {
+    // The header of each record a batched child sends over its log pipe. A
+    // `started` record is sent just before each test runs, so that we know
+    // which test to blame if the child dies, and a `finished` record (followed
+    // by the message, stdout, and stderr) is sent once it completes.
+    struct batch_record {
+      enum record_type : char {
+        started,
+        finished
+      } type;
+      bool passed;
+      log::test_duration::rep duration;
+      std::uint32_t message_size, stdout_size, stderr_size;
+      std::uint64_t stdout_elided, stderr_elided;
+      log::test_resources resources;
+    };
+
+    log::test_resources to_resources(const struct rusage &usage) {
+      using namespace std::chrono;
+      auto time = [](const timeval &tv) {
+        return seconds(tv.tv_sec) + microseconds(tv.tv_usec);
+      };
+#ifdef __APPLE__
+      std::uint64_t rss_unit = 1;
+#else
+      std::uint64_t rss_unit = 1024;
+#endif
+      return {
+        time(usage.ru_utime), time(usage.ru_stime),
+        static_cast<std::uint64_t>(usage.ru_maxrss) * rss_unit,
+        static_cast<std::uint64_t>(usage.ru_minflt),
+        static_cast<std::uint64_t>(usage.ru_majflt),
+        static_cast<std::uint64_t>(usage.ru_nvcsw),
+        static_cast<std::uint64_t>(usage.ru_nivcsw)
+      };
+    }
+
+    int self_resources(log::test_resources &resources) {
+      struct rusage usage;
+      if(getrusage(RUSAGE_SELF, &usage) < 0)
+        return -1;
+      resources = to_resources(usage);
+      return 0;
+    }
+
+    // Get the resources used between two snapshots of the same process. The
+    // peak RSS can't be split up like this, so it's just the peak so far.
+    log::test_resources resources_since(const log::test_resources &then,
+                                        const log::test_resources &now) {
+      return {
+        now.user_time - then.user_time, now.system_time - then.system_time,
+        now.max_rss,
+        now.minor_faults - then.minor_faults,
+        now.major_faults - then.major_faults,
+        now.voluntary_switches - then.voluntary_switches,
+        now.involuntary_switches - then.involuntary_switches
+      };
+    }
+
+    int write_all(int fd, const void *data, std::size_t size) {
+      auto buf = static_cast<const char *>(data);
+      while(size) {
+        ssize_t written = write(fd, buf, size);
+        if(written < 0) {
+          if(errno == EINTR)
+            continue;
+          return -1;
+        }
+        buf += written;
+        size -= written;
+      }
+      return 0;
+    }
+
+    // Make an anonymous file to capture a test's output in. On Linux, this is
+    // a memfd, which never touches the disk; elsewhere (or on kernels without
+    // memfd), it's an unlinked temporary file.
+    int make_capture_file() {
+#ifdef __linux__
+      int memfd = memfd_create("mettle", MFD_CLOEXEC);
+      if(memfd >= 0 || errno != ENOSYS)
+        return memfd;
+#endif
+
+      const char *tmpdir = getenv("TMPDIR");
+      std::string path = std::string(tmpdir ? tmpdir : "/tmp") +
+                         "/mettle.XXXXXX";
+      int fd = mkstemp(path.data());
+      if(fd < 0)
+        return -1;
+      if(unlink(path.c_str()) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+      }
+      return fd;
+    }
+
+    int reset_capture(int fd) {
+      if(ftruncate(fd, 0) < 0)
+        return -1;
+      return lseek(fd, 0, SEEK_SET) < 0 ? -1 : 0;
+    }
+
+    // Read a capture file into `dest` by mapping it into memory. If `limit` is
+    // non-zero, only copy the parts `log::elide_log` would keep, so that the
+    // rest of the output never has to be paged in at all.
+    int read_capture(int fd, std::string &dest, std::size_t limit = 0,
+                     std::size_t *elided = nullptr) {
+      struct stat st;
+      if(fstat(fd, &st) < 0)
+        return -1;
+
+      std::size_t size = st.st_size;
+      if(size == 0) {
+        dest.clear();
+        return 0;
+      }
+
+      void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(addr == MAP_FAILED)
+        return -1;
+
+      auto data = static_cast<const char *>(addr);
+      if(limit && size > limit) {
+        std::size_t head = limit - limit / 2, tail = limit / 2;
+        dest.assign(data, head);
+        dest.append(data + size - tail, tail);
+        *elided += size - limit;
+      } else {
+        dest.assign(data, size);
+      }
+      return munmap(addr, size);
+    }
+
+    // Get ready to run the next test in a batch and tell the parent about it.
+    int begin_test(int log_fd) {
+      batch_record record = {batch_record::started, false, 0, 0, 0, 0, 0, 0,
+                             {}};
+      if(reset_capture(STDOUT_FILENO) < 0 ||
+         reset_capture(STDERR_FILENO) < 0)
+        return -1;
+      return write_all(log_fd, &record, sizeof(record));
+    }
+
+    // Send the parent the result of the current test in a batch, along with
+    // its captured output.
+    int end_test(int log_fd, const test_result &result,
+                 log::test_duration duration,
+                 const log::test_resources &resources,
+                 std::size_t output_limit) {
+      log::test_output output;
+      if(read_capture(STDOUT_FILENO, output.stdout_log, output_limit,
+                      &output.stdout_elided) < 0 ||
+         read_capture(STDERR_FILENO, output.stderr_log, output_limit,
+                      &output.stderr_elided) < 0)
+        return -1;
+
+      batch_record record = {
+        batch_record::finished, result.passed, duration.count(),
+        static_cast<std::uint32_t>(result.message.size()),
+        static_cast<std::uint32_t>(output.stdout_log.size()),
+        static_cast<std::uint32_t>(output.stderr_log.size()),
+        output.stdout_elided, output.stderr_elided, resources
+      };
+      if(write_all(log_fd, &record, sizeof(record)) < 0 ||
+         write_all(log_fd, result.message.data(), result.message.size()) < 0 ||
+         write_all(log_fd, output.stdout_log.data(),
+                   output.stdout_log.size()) < 0 ||
+         write_all(log_fd, output.stderr_log.data(),
+                   output.stderr_log.size()) < 0)
+        return -1;
+      return 0;
+    }
+
+    // A batch of tests that all share their suite's fixture. Once the first
+    // test's setup is done, the child acts as a template for the rest of the
+    // batch: it forks a new process for each test, which inherits the fixture
+    // and writes its message to `message_fd` before exiting.
+    struct shared_batch {
+      std::vector<const test_info *> tests;
+      std::vector<resource_limits> limits;
+      base_limits base;
+      std::size_t current = 0, output_limit = 0;
+      int log_fd = -1, message_fd = -1;
+      bool forked = false;
+    };
+    shared_batch *current_batch = nullptr;
+
+    std::size_t serve_shared_tests(const void *group, std::size_t index) {
+      auto *b = current_batch;
+      if(!b || b->forked || b->tests[b->current]->shared_setup.group != group)
+        return index;
+
+      for(std::size_t i = b->current; i != b->tests.size(); i++) {
+        if((i != b->current && begin_test(b->log_fd) < 0) ||
+           reset_capture(b->message_fd) < 0)
+          child_failed();
+
+        fflush(nullptr);
+        using namespace std::chrono;
+        auto then = steady_clock::now();
+
+        pid_t pid = fork();
+        if(pid < 0)
+          child_failed();
+        if(pid == 0) {
+          b->forked = true;
+          if(apply_limits(b->limits[i], b->base) < 0)
+            child_failed();
+          return b->tests[i]->shared_setup.index;
+        }
+
+        int status;
+        struct rusage usage;
+        while(wait4(pid, &status, 0, &usage) < 0) {
+          if(errno != EINTR)
+            child_failed();
+        }
+        auto duration = duration_cast<log::test_duration>(
+          steady_clock::now() - then
+        );
+
+        test_result result;
+        if(auto exceeded = exceeded_limits(status, b->limits[i])) {
+          result = std::move(*exceeded);
+        } else if(WIFEXITED(status)) {
+          result.passed = WEXITSTATUS(status) == exit_code::success;
+          if(read_capture(b->message_fd, result.message) < 0)
+            child_failed();
+        } else { // WIFSIGNALED
+          result = { false, strsignal(WTERMSIG(status)) };
+        }
+
+        if(end_test(b->log_fd, result, duration, to_resources(usage),
+                    b->output_limit) < 0)
+          child_failed();
+      }
+
+      fflush(nullptr);
+      EXIT_FUNC(exit_code::success);
+    }
+  }
+
+  struct subprocess_test_pool::child {
+    ~child() {
+      for(int fd : capture) {
+        if(fd >= 0)
+          close(fd);
+      }
+    }
+
+    pid_t pid, pgid;
+    std::vector<queued_test> tests;
+    std::size_t next = 0;
+    bool batched = false;
+    scoped_pipe stdout_pipe, stderr_pipe, log_pipe;
+    int capture[2] = {-1, -1};
+    std::vector<readfd> dests;
+    log::test_output output;
+    std::string message;
+    std::optional<test_result> result;
+    bool fail_rest = false;
+    bool exited = false;
+    std::chrono::steady_clock::time_point start, test_start;
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+  };
+
+  struct subprocess_test_pool::completed {
+    callback_type done;
+    test_result result;
+    log::test_output output;
+    log::test_duration duration;
+  };
+
   test_result subprocess_test_runner::operator ()(
     const test_info &test, log::test_output &output
   ) const {
-    assert(test_pgid == 0);
+    if(!pool_) {
+      pool_ = std::make_shared<subprocess_test_pool>(
+        1, timeout_, 1, output_limit_, capture_, limits_
+      );
+    }
+
+    test_result result;
+    pool_->start(test, [&result, &output](
+      test_result r, log::test_output o, log::test_duration
+    ) {
+      result = std::move(r);
+      output = std::move(o);
+    });
+    pool_->wait();
+    return result;
+  }
+
+  subprocess_test_pool::subprocess_test_pool(
+    std::size_t jobs, timeout_t timeout, std::size_t batch_size,
+    std::size_t output_limit, output_capture capture, resource_limits limits
+  ) : jobs_(jobs), batch_size_(batch_size), output_limit_(output_limit),
+      capture_(capture), limits_(limits), timeout_(timeout) {
+    assert(jobs_ > 0);
+    assert(batch_size_ > 0);
+  }
+
+  subprocess_test_pool::~subprocess_test_pool() {
+    for(auto &c : running_) {
+      killpg(c->pgid, SIGKILL);
+      waitpid(c->pid, nullptr, 0);
+      forget_pgid(c->pgid);
+    }
+  }
+
+  void subprocess_test_pool::start(const test_info &test, callback_type done) {
+    start(test, std::move(done), nullptr);
+  }
+
+  void subprocess_test_pool::start(const test_info &test, callback_type done,
+                                   chunk_callback_type chunk) {
+    resource_limits limits;
+    try {
+      limits = get_resource_limits(test.attrs, limits_);
+    } catch(const std::exception &e) {
+      done({false, e.what()}, {}, {});
+      return;
+    }
 
-    scoped_pipe stdout_pipe, stderr_pipe, pgid_pipe, log_pipe;
-    if(stdout_pipe.open() < 0 ||
-       stderr_pipe.open() < 0 ||
-       pgid_pipe.open() < 0 ||
-       log_pipe.open(O_CLOEXEC) < 0)
-      return PARENT_FAILED();
+    pending_.push_back({&test, std::move(done), std::move(chunk), limits});
+    launch_pending(false);
+  }
+
+  void subprocess_test_pool::wait() {
+    while(true) {
+      launch_pending(true);
+      if(running_.empty())
+        break;
+      supervise(false);
+    }
+  }
+
+  void subprocess_test_pool::cancel() {
+    pending_.clear();
+    for(auto &c : running_) {
+      killpg(c->pgid, SIGKILL);
+      unwatch(*c);
+      waitpid(c->pid, nullptr, 0);
+      forget_pgid(c->pgid);
+    }
+    running_.clear();
+    restore_signals();
+  }
+
+  void subprocess_test_pool::restore_signals() {
+    sigint_.close();
+    sigquit_.close();
+    sigchld_.close();
+  }
+
+  int subprocess_test_pool::watch(child &c) {
+    for(auto &i : c.dests) {
+      if(monitor_.watch_fd(i.fd, &i) < 0)
+        return -1;
+    }
+    return monitor_.watch_child(c.pid, &c);
+  }
+
+  void subprocess_test_pool::unwatch(child &c) {
+    for(auto &i : c.dests) {
+      if(i.fd >= 0)
+        monitor_.unwatch_fd(i.fd);
+    }
+    monitor_.unwatch_child(c.pid);
+  }
+
+  std::size_t subprocess_test_pool::next_batch(bool all) const {
+    if(pending_.empty())
+      return 0;
+
+    // Tests sharing a fixture go in one batch; wait until we've seen the whole
+    // run of them (or we're told to launch everything).
+    if(auto group = pending_.front().test->shared_setup.group) {
+      std::size_t n = 1;
+      while(n != pending_.size() && pending_[n].test->shared_setup.group == group)
+        n++;
+      return n != pending_.size() || all ? n : 0;
+    }
+
+    std::size_t n = 1;
+    while(n != pending_.size() && n != batch_size_ &&
+          !pending_[n].test->shared_setup)
+      n++;
+    return n == batch_size_ || n != pending_.size() || all ? n : 0;
+  }
+
+  void subprocess_test_pool::launch_pending(bool all) {
+    // Launch a child for each full batch of pending tests (or for whatever's
+    // left if `all` is set), waiting for a free slot as needed.
+    while(next_batch(all)) {
+      while(running_.size() >= jobs_)
+        supervise(false);
+
+      // A test we just finished may have cancelled everything else, or put the
+      // rest of its batch back in the queue.
+      auto n = next_batch(all);
+      if(!n)
+        break;
+
+      std::vector<queued_test> tests(
+        std::make_move_iterator(pending_.begin()),
+        std::make_move_iterator(pending_.begin() + n)
+      );
+      pending_.erase(pending_.begin(), pending_.begin() + n);
+      launch(std::move(tests));
+    }
+  }
+
+  void subprocess_test_pool::launch(std::vector<queued_test> tests) {
+    auto c = std::make_unique<child>();
+    c->tests = std::move(tests);
+    c->batched = batch_size_ > 1 || bool(c->tests[0].test->shared_setup);
+
+    auto fail = [&c](const test_result &result) {
+      for(auto &t : c->tests)
+        t.done(result, {}, {});
+    };
+
+    scoped_pipe pgid_pipe;
+    if(pgid_pipe.open() < 0 ||
+       c->log_pipe.open(O_CLOEXEC) < 0)
+      return fail(PARENT_FAILED());
+
+    bool use_files = c->batched || capture_ == output_capture::file;
+    if(use_files) {
+      if((c->capture[0] = make_capture_file()) < 0 ||
+         (c->capture[1] = make_capture_file()) < 0)
+        return fail(PARENT_FAILED());
+    } else {
+      if(c->stdout_pipe.open() < 0 ||
+         c->stderr_pipe.open() < 0)
+        return fail(PARENT_FAILED());
+    }
+
+    if((!monitor_.is_open() && monitor_.open() < 0) ||
+       (!reap_monitor_.is_open() && reap_monitor_.open() < 0))
+      return fail(PARENT_FAILED());
 
     fflush(nullptr);
 
     scoped_sigprocmask mask;
-    if(mask.push(SIG_BLOCK, SIGCHLD) < 0 ||
-       mask.push(SIG_BLOCK, {SIGINT, SIGQUIT}) < 0)
-      return PARENT_FAILED();
+    if(mask.push(SIG_BLOCK, {SIGCHLD, SIGINT, SIGQUIT}) < 0)
+      return fail(PARENT_FAILED());
 
-    pid_t pid;
-    if((pid = fork()) < 0)
-      return PARENT_FAILED();
+    // Forward SIGINT and SIGQUIT to our tests for as long as any are running.
+    if(running_.empty()) {
+      if(sigaction(SIGINT, nullptr, &old_sigint) < 0 ||
+         sigaction(SIGQUIT, nullptr, &old_sigquit) < 0)
+        return fail(PARENT_FAILED());
 
-    if(pid == 0) {
-      if(mask.clear() < 0)
-        child_failed();
+      if(sigint_.open(SIGINT, sig_handler) < 0 ||
+         sigquit_.open(SIGQUIT, sig_handler) < 0 ||
+         sigchld_.open(SIGCHLD, sig_chld) < 0) {
+        restore_signals();
+        return fail(PARENT_FAILED());
+      }
+    }
 
-      if(stdout_pipe.close_read() < 0 ||
-         stderr_pipe.close_read() < 0 ||
-         pgid_pipe.close_read() < 0 ||
-         log_pipe.close_read() < 0)
+    c->start = c->test_start = std::chrono::steady_clock::now();
+    if(timeout_)
+      c->deadline = c->start + *timeout_;
+
+    if((c->pid = fork()) < 0) {
+      auto result = PARENT_FAILED();
+      if(running_.empty()) {
+        restore_signals();
+      }
+      return fail(result);
+    }
+
+    if(c->pid == 0) {
+      // Our signal handlers only make sense in the parent, so put back the
+      // original ones before unblocking anything.
+      restore_signals();
+      test_pgids.clear();
+      if(monitor_.close() < 0 || reap_monitor_.close() < 0 ||
+         mask.clear() < 0)
         child_failed();
 
-      if(stdout_pipe.move_write(STDOUT_FILENO) < 0 ||
-         stderr_pipe.move_write(STDERR_FILENO) < 0)
+      if(pgid_pipe.close_read() < 0 ||
+         c->log_pipe.close_read() < 0)
         child_failed();
 
+      if(use_files) {
+        if(dup2(c->capture[0], STDOUT_FILENO) < 0 ||
+           dup2(c->capture[1], STDERR_FILENO) < 0)
+          child_failed();
+      } else {
+        if(c->stdout_pipe.close_read() < 0 ||
+           c->stderr_pipe.close_read() < 0)
+          child_failed();
+
+        if(c->stdout_pipe.move_write(STDOUT_FILENO) < 0 ||
+           c->stderr_pipe.move_write(STDERR_FILENO) < 0)
+          child_failed();
+      }
+
       // Make a new process group so we can kill the test and all its children
       // as a group.
       if(setpgid(0, 0) < 0)
@@ -120,83 +672,360 @@ namespace mettle {
       if(pgid_pipe.close_write() < 0)
         child_failed();
 
-      if(timeout_)
-        make_timeout_monitor(*timeout_);
-
-      auto result = test.function();
-      if(write(log_pipe.write_fd, result.message.c_str(),
-               result.message.length()) < 0)
+      base_limits base;
+      if(get_base_limits(base) < 0)
         child_failed();
 
-      fflush(nullptr);
+      if(!c->batched) {
+        if(!c->tests[0].limits.empty() &&
+           apply_limits(c->tests[0].limits, base) < 0)
+          child_failed();
 
-      EXIT_FUNC(result.passed ? exit_code::success : exit_code::failure);
-    } else {
-      scoped_sigaction sigint, sigquit, sigchld;
+        auto result = c->tests[0].test->function();
+        if(write(c->log_pipe.write_fd, result.message.c_str(),
+                 result.message.length()) < 0)
+          child_failed();
+
+        fflush(nullptr);
+
+        EXIT_FUNC(result.passed ? exit_code::success : exit_code::failure);
+      }
 
-      if(stdout_pipe.close_write() < 0 ||
-         stderr_pipe.close_write() < 0 ||
+      // We may have been forked from a test that was itself part of a shared
+      // batch, so always reset the current batch.
+      shared_batch batch;
+      batch.log_fd = c->log_pipe.write_fd;
+      batch.output_limit = output_limit_;
+      batch.base = base;
+      current_batch = nullptr;
+      if(c->tests[0].test->shared_setup) {
+        if((batch.message_fd = make_capture_file()) < 0)
+          child_failed();
+        for(const auto &t : c->tests) {
+          batch.tests.push_back(t.test);
+          batch.limits.push_back(t.limits);
+        }
+        current_batch = &batch;
+        detail::fork_hook = serve_shared_tests;
+      }
+
+      for(std::size_t i = 0; i != c->tests.size(); i++) {
+        batch.current = i;
+        if(begin_test(batch.log_fd) < 0 ||
+           apply_limits(c->tests[i].limits, base) < 0)
+          child_failed();
+
+        using namespace std::chrono;
+        log::test_resources usage_before, usage_after;
+        if(self_resources(usage_before) < 0)
+          child_failed();
+        auto then = steady_clock::now();
+        auto result = c->tests[i].test->function();
+        fflush(nullptr);
+
+        // If we're a process forked from a shared batch, the template will
+        // report our result once we exit.
+        if(batch.forked) {
+          if(write_all(batch.message_fd, result.message.data(),
+                       result.message.size()) < 0)
+            child_failed();
+          EXIT_FUNC(result.passed ? exit_code::success : exit_code::failure);
+        }
+
+        auto duration = duration_cast<log::test_duration>(
+          steady_clock::now() - then
+        );
+        if(self_resources(usage_after) < 0 ||
+           end_test(batch.log_fd, result, duration,
+                    resources_since(usage_before, usage_after),
+                    batch.output_limit) < 0)
+          child_failed();
+      }
+
+      EXIT_FUNC(exit_code::success);
+    } else {
+      if((!use_files && (c->stdout_pipe.close_write() < 0 ||
+                         c->stderr_pipe.close_write() < 0)) ||
          pgid_pipe.close_write() < 0 ||
-         log_pipe.close_write() < 0)
-        return PARENT_FAILED();
+         c->log_pipe.close_write() < 0 ||
+         recv_pgid(pgid_pipe.read_fd, &c->pgid) < 0) {
+        auto result = PARENT_FAILED();
+        kill(c->pid, SIGKILL);
+        waitpid(c->pid, nullptr, 0);
+        if(running_.empty()) {
+          restore_signals();
+        }
+        return fail(result);
+      }
 
-      if(recv_pgid(pgid_pipe.read_fd, &test_pgid) < 0)
-        return PARENT_FAILED();
+      if(use_files) {
+        c->dests = {
+          {c->log_pipe.read_fd, &c->message}
+        };
+      } else {
+        c->dests = {
+          {c->stdout_pipe.read_fd, &c->output.stdout_log, output_limit_,
+           &c->output.stdout_elided},
+          {c->stderr_pipe.read_fd, &c->output.stderr_log, output_limit_,
+           &c->output.stderr_elided},
+          {c->log_pipe.read_fd,    &c->message}
+        };
+        if(auto &chunk = c->tests[0].chunk) {
+          c->dests[0].on_chunk = [&chunk](std::string_view data) {
+            chunk(log::output_stream::stdout_log, data);
+          };
+          c->dests[1].on_chunk = [&chunk](std::string_view data) {
+            chunk(log::output_stream::stderr_log, data);
+          };
+        }
+      }
+      if(watch(*c) < 0) {
+        auto result = PARENT_FAILED();
+        unwatch(*c);
+        killpg(c->pgid, SIGKILL);
+        waitpid(c->pid, nullptr, 0);
+        if(running_.empty()) {
+          restore_signals();
+        }
+        return fail(result);
+      }
 
-      if(sigaction(SIGINT, nullptr, &old_sigint) < 0 ||
-         sigaction(SIGQUIT, nullptr, &old_sigquit) < 0)
-        return PARENT_FAILED();
+      test_pgids.push_back(c->pgid);
+      running_.push_back(std::move(c));
+    }
+  }
+
+  void subprocess_test_pool::read_records(
+    child &c, std::vector<completed> &finished
+  ) {
+    using namespace std::chrono;
+    std::size_t offset = 0;
+    while(c.message.size() - offset >= sizeof(batch_record)) {
+      batch_record record;
+      std::memcpy(&record, c.message.data() + offset, sizeof(record));
 
-      if(sigint.open(SIGINT, sig_handler) < 0 ||
-         sigquit.open(SIGQUIT, sig_handler) < 0 ||
-         sigchld.open(SIGCHLD, sig_chld) < 0)
-        return PARENT_FAILED();
+      if(record.type == batch_record::started) {
+        c.test_start = steady_clock::now();
+        if(timeout_)
+          c.deadline = c.test_start + *timeout_;
+        offset += sizeof(record);
+        continue;
+      }
 
-      if(mask.pop() < 0)
-        return PARENT_FAILED();
+      std::size_t size = sizeof(record) + record.message_size +
+                         record.stdout_size + record.stderr_size;
+      if(c.message.size() - offset < size)
+        break;
 
-      std::string message;
-      std::vector<readfd> dests = {
-        {stdout_pipe.read_fd, &output.stdout_log},
-        {stderr_pipe.read_fd, &output.stderr_log},
-        {log_pipe.read_fd,    &message}
+      const char *data = c.message.data() + offset + sizeof(record);
+      test_result result = {
+        record.passed, std::string(data, record.message_size)
+      };
+      data += record.message_size;
+      log::test_output output = {
+        std::string(data, record.stdout_size),
+        std::string(data + record.stdout_size, record.stderr_size),
+        record.stdout_elided, record.stderr_elided, record.resources
       };
 
-      // Read from the piped stdout, stderr, and log. If we're interrupted
-      // (probably by SIGCHLD), do one last non-blocking read to get any data we
-      // might have missed.
-      sigset_t empty;
-      sigemptyset(&empty);
-      if(read_into(dests, nullptr, &empty) < 0) {
-        if(errno != EINTR)
-          return PARENT_FAILED();
-        timespec timeout = {0, 0};
-        if(read_into(dests, &timeout, nullptr) < 0)
-          return PARENT_FAILED();
-      }
+      finished.push_back({
+        std::move(c.tests[c.next++].done), std::move(result),
+        std::move(output), log::test_duration(record.duration)
+      });
+      offset += size;
+    }
+    c.message.erase(0, offset);
+  }
 
-      int status;
-      if(waitpid(pid, &status, 0) < 0)
-        return PARENT_FAILED();
+  void subprocess_test_pool::supervise(bool all) {
+    std::vector<completed> finished;
+
+    auto finish = [this, &finished](std::size_t i, int status) {
+      auto &c = running_[i];
 
       // Make sure everything in the test's process group is dead. Don't worry
       // about reaping.
-      killpg(test_pgid, SIGKILL);
-      test_pgid = 0;
-
-      if(WIFEXITED(status)) {
-        int exit_status = WEXITSTATUS(status);
-        if(exit_status == exit_code::timeout) {
-          std::ostringstream ss;
-          ss << "Timed out after " << timeout_->count() << " ms";
-          return { false, ss.str() };
+      killpg(c->pgid, SIGKILL);
+      forget_pgid(c->pgid);
+
+      using namespace std::chrono;
+      auto now = steady_clock::now();
+
+      std::size_t current = c->batched ? c->next : 0;
+      std::optional<test_result> exceeded;
+      if(!c->result && current != c->tests.size())
+        exceeded = exceeded_limits(status, c->tests[current].limits);
+
+      if(c->result) {
+        // We already know how this test went.
+      } else if(exceeded) {
+        c->result = std::move(exceeded);
+      } else if(WIFEXITED(status)) {
+        c->result = {
+          WEXITSTATUS(status) == exit_code::success,
+          c->batched ? "" : c->message
+        };
+      } else { // WIFSIGNALED
+        c->result = { false, strsignal(WTERMSIG(status)) };
+      }
+
+      if(!c->batched) {
+        if(c->capture[0] >= 0) {
+          if(read_capture(c->capture[0], c->output.stdout_log, output_limit_,
+                          &c->output.stdout_elided) < 0 ||
+             read_capture(c->capture[1], c->output.stderr_log, output_limit_,
+                          &c->output.stderr_elided) < 0)
+            c->result = PARENT_FAILED();
+        }
+        for(auto &i : c->dests)
+          finish_read(i);
+        finished.push_back({
+          std::move(c->tests[0].done), std::move(*c->result),
+          std::move(c->output),
+          duration_cast<log::test_duration>(now - c->start)
+        });
+      } else if(c->next != c->tests.size()) {
+        // Blame the test that was running when the child exited, using
+        // whatever it managed to write before dying. Then, run the rest of
+        // the batch in a new child (unless we're giving up entirely).
+        log::test_output output;
+        read_capture(c->capture[0], output.stdout_log, output_limit_,
+                     &output.stdout_elided);
+        read_capture(c->capture[1], output.stderr_log, output_limit_,
+                     &output.stderr_elided);
+        finished.push_back({
+          std::move(c->tests[c->next].done), *c->result, std::move(output),
+          duration_cast<log::test_duration>(now - c->test_start)
+        });
+
+        auto rest = c->tests.begin() + c->next + 1;
+        if(c->fail_rest) {
+          for(auto t = rest; t != c->tests.end(); ++t)
+            finished.push_back({std::move(t->done), *c->result, {}, {}});
         } else {
-          return { exit_status == exit_code::success, message };
+          pending_.insert(pending_.begin(), std::make_move_iterator(rest),
+                          std::make_move_iterator(c->tests.end()));
         }
-      } else { // WIFSIGNALED
-        return { false, strsignal(WTERMSIG(status)) };
+      }
+
+      running_.erase(running_.begin() + i);
+    };
+
+    // Stop watching a test that has exited (or that we've killed) and do one
+    // last non-blocking read to get any data still sitting in its pipes. We
+    // can't wait for EOF, since the test may have left behind a child in
+    // another process group that still holds the pipes open.
+    auto reap = [this, &finished](child &c, int *status) {
+      unwatch(c);
+      timespec timeout = {0, 0};
+      struct rusage usage;
+      if(wait4(c.pid, status, 0, &usage) < 0 ||
+         read_into(c.dests, reap_monitor_, &timeout, nullptr) < 0)
+        c.result = PARENT_FAILED();
+      else if(!c.batched)
+        c.output.resources = to_resources(usage);
+      if(c.batched)
+        read_records(c, finished);
+    };
+
+    auto fail_all = [this, &finish, &reap](const test_result &result) {
+      while(!running_.empty()) {
+        auto &c = running_.back();
+        killpg(c->pgid, SIGKILL);
+        reap(*c, nullptr);
+        c->result = result;
+        c->fail_rest = true;
+        finish(running_.size() - 1, 0);
+      }
+    };
+
+    {
+      scoped_sigprocmask mask;
+      if(mask.push(SIG_BLOCK, {SIGCHLD, SIGINT, SIGQUIT}) < 0)
+        fail_all(PARENT_FAILED());
+
+      sigset_t empty;
+      sigemptyset(&empty);
+      std::vector<child_monitor::event> events;
+      while(!running_.empty()) {
+        // Reap any tests that have exited.
+        for(std::size_t i = 0; i != running_.size();) {
+          auto &c = running_[i];
+          if(!c->exited) {
+            i++;
+            continue;
+          }
+
+          int status;
+          reap(*c, &status);
+          finish(i, status);
+        }
+
+        // Kill any tests that have run past their deadline, and find out
+        // when the next deadline is.
+        using namespace std::chrono;
+        auto now = steady_clock::now();
+        std::optional<steady_clock::time_point> next_deadline;
+        for(std::size_t i = 0; i != running_.size();) {
+          auto &c = running_[i];
+          if(!c->deadline) {
+            i++;
+          } else if(*c->deadline > now) {
+            if(!next_deadline || *c->deadline < *next_deadline)
+              next_deadline = c->deadline;
+            i++;
+          } else {
+            killpg(c->pgid, SIGKILL);
+            reap(*c, nullptr);
+            if(!c->result) {
+              std::ostringstream ss;
+              ss << "Timed out after " << timeout_->count() << " ms";
+              c->result = { false, ss.str() };
+            }
+            finish(i, 0);
+          }
+        }
+
+        if(running_.empty() || (!all && !finished.empty()))
+          break;
+
+        timespec timeout;
+        if(next_deadline)
+          timeout = to_timespec(*next_deadline - now);
+
+        // Wait for output from any running test, a test to exit, or the next
+        // deadline to pass. We unblock our signals here so that SIGINT and
+        // SIGQUIT can be forwarded to the tests (and, if the platform can't
+        // watch child processes directly, so that SIGCHLD wakes us up).
+        if(monitor_.wait(events, next_deadline ? &timeout : nullptr,
+                         &empty) < 0) {
+          if(errno != EINTR)
+            fail_all(PARENT_FAILED());
+          continue;
+        }
+
+        for(const auto &e : events) {
+          if(e.type == child_monitor::event_type::exited) {
+            static_cast<child*>(e.data)->exited = true;
+          } else if(read_chunk(*static_cast<readfd*>(e.data), monitor_) < 0) {
+            fail_all(PARENT_FAILED());
+            break;
+          }
+        }
+
+        for(auto &c : running_) {
+          if(c->batched)
+            read_records(*c, finished);
+        }
+      }
+
+      if(running_.empty()) {
+        restore_signals();
       }
     }
+
+    for(auto &c : finished)
+      c.done(std::move(c.result), std::move(c.output), c.duration);
   }
 
   int make_fd_private(int fd) {
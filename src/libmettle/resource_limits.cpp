@@ -0,0 +1,94 @@
+#include <mettle/driver/resource_limits.hpp>
+
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+namespace mettle {
+
+  namespace {
+    // Split `value` into a number and a (possibly empty) suffix, multiplying
+    // the number by the suffix's scale.
+    template<typename Scale>
+    std::uint64_t parse_scaled(const std::string &value, const char *what,
+                               Scale &&scale) {
+      auto bad_value = [&]() {
+        return std::invalid_argument(
+          std::string("invalid ") + what + " \"" + value + "\""
+        );
+      };
+
+      std::size_t i = 0;
+      std::uint64_t number = 0;
+      for(; i != value.size() && std::isdigit((unsigned char)value[i]); i++) {
+        auto digit = static_cast<std::uint64_t>(value[i] - '0');
+        if(number > (std::numeric_limits<std::uint64_t>::max() - digit) / 10)
+          throw bad_value();
+        number = number * 10 + digit;
+      }
+      if(i == 0 || number == 0)
+        throw bad_value();
+
+      std::uint64_t factor = scale(value.substr(i));
+      if(factor == 0)
+        throw bad_value();
+      if(number > std::numeric_limits<std::uint64_t>::max() / factor)
+        throw bad_value();
+      return number * factor;
+    }
+  }
+
+  std::uint64_t parse_memory_size(const std::string &value) {
+    return parse_scaled(value, "memory size", [](const std::string &suffix)
+                        -> std::uint64_t {
+      if(suffix.empty() || suffix == "B")
+        return 1;
+      else if(suffix == "K" || suffix == "KiB")
+        return std::uint64_t(1) << 10;
+      else if(suffix == "M" || suffix == "MiB")
+        return std::uint64_t(1) << 20;
+      else if(suffix == "G" || suffix == "GiB")
+        return std::uint64_t(1) << 30;
+      return 0;
+    });
+  }
+
+  std::chrono::seconds parse_cpu_time(const std::string &value) {
+    return std::chrono::seconds(parse_scaled(
+      value, "CPU time", [](const std::string &suffix) -> std::uint64_t {
+        if(suffix.empty() || suffix == "s")
+          return 1;
+        else if(suffix == "m")
+          return 60;
+        else if(suffix == "h")
+          return 60 * 60;
+        return 0;
+      }
+    ));
+  }
+
+  std::string format_memory_size(std::uint64_t bytes) {
+    const char *units[] = {"bytes", "KiB", "MiB", "GiB"};
+    std::size_t unit = 0;
+    for(; unit != 3 && bytes != 0 && bytes % 1024 == 0; unit++)
+      bytes /= 1024;
+    return std::to_string(bytes) + " " + units[unit];
+  }
+
+  resource_limits
+  get_resource_limits(const attributes &attrs, resource_limits defaults) {
+    auto value = [&attrs](const std::string &name) -> const std::string * {
+      auto i = attrs.find(name);
+      if(i == attrs.end() || i->value.empty())
+        return nullptr;
+      return &*i->value.begin();
+    };
+
+    if(auto v = value(limit::max_rss.name()))
+      defaults.max_rss = parse_memory_size(*v);
+    if(auto v = value(limit::cpu_time.name()))
+      defaults.cpu_time = parse_cpu_time(*v);
+    return defaults;
+  }
+
+} // namespace mettle
@@ -0,0 +1,82 @@
+#include <mettle/driver/shard.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+namespace mettle {
+
+  std::uint64_t stable_hash(const std::string &value) {
+    // 64-bit FNV-1a.
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for(unsigned char c : value) {
+      hash ^= c;
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  }
+
+  std::vector<std::size_t> assign_shards(
+    const std::vector<std::string> &keys,
+    const std::vector<std::optional<log::test_duration>> &estimates,
+    std::size_t count
+  ) {
+    std::vector<std::size_t> shards(keys.size(), 0);
+    if(count <= 1)
+      return shards;
+
+    log::test_duration total{0};
+    std::size_t known = 0;
+    for(const auto &i : estimates) {
+      if(i) {
+        total += *i;
+        known++;
+      }
+    }
+
+    if(known == 0) {
+      for(std::size_t i = 0; i != keys.size(); i++)
+        shards[i] = stable_hash(keys[i]) % count;
+      return shards;
+    }
+
+    // Durations are only recorded to the millisecond, so count every item as
+    // taking at least that long; otherwise, a pile of quick tests could all
+    // land in the same shard.
+    auto average = total / static_cast<log::test_duration::rep>(known);
+    auto weight = [&](std::size_t i) {
+      return std::max(estimates[i] ? *estimates[i] : average,
+                      log::test_duration{1});
+    };
+
+    // Place the heaviest items first, each in the least-loaded shard. When
+    // several shards are tied (e.g. at the start), pick one by hashing so that
+    // a handful of items aren't all piled into the first shard.
+    std::vector<std::size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs,
+                                                     std::size_t rhs) {
+      auto l = weight(lhs);
+      auto r = weight(rhs);
+      if(l != r)
+        return l > r;
+      return keys[lhs] < keys[rhs];
+    });
+
+    std::vector<log::test_duration> loads(count, log::test_duration{0});
+    std::vector<std::size_t> lightest;
+    for(auto i : order) {
+      auto least = *std::min_element(loads.begin(), loads.end());
+      lightest.clear();
+      for(std::size_t s = 0; s != count; s++) {
+        if(loads[s] == least)
+          lightest.push_back(s);
+      }
+
+      auto shard = lightest[stable_hash(keys[i]) % lightest.size()];
+      shards[i] = shard;
+      loads[shard] += weight(i);
+    }
+    return shards;
+  }
+
+} // namespace mettle
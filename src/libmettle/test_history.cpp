@@ -0,0 +1,261 @@
+#include <mettle/driver/test_history.hpp>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace mettle {
+
+  namespace {
+    const char magic[] = "METTLEH\x01";
+    constexpr std::size_t magic_size = sizeof(magic) - 1;
+
+    // Write `data` to a new, uniquely-named file in the same directory as
+    // `filename` and return its name, so that runs saving at the same time
+    // don't clobber each other's temporary files.
+    std::string write_temp_file(const std::string &filename,
+                                const std::string &data) {
+      std::string tmp = filename + ".XXXXXX";
+#ifdef _WIN32
+      if(_mktemp_s(tmp.data(), tmp.size() + 1) != 0)
+        throw std::runtime_error("unable to write \"" + filename + "\"");
+      std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+      out.write(data.data(), data.size());
+      if(!out.flush()) {
+        out.close();
+        std::remove(tmp.c_str());
+        throw std::runtime_error("unable to write \"" + tmp + "\"");
+      }
+#else
+      int fd = mkstemp(tmp.data());
+      if(fd < 0)
+        throw std::runtime_error("unable to write \"" + filename + "\"");
+
+      // mkstemp only lets the owner read the file; make it as readable as a
+      // file we'd create normally.
+      bool ok = fchmod(fd, 0644) == 0;
+      for(std::size_t written = 0; ok && written != data.size();) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if(n < 0 && errno == EINTR)
+          continue;
+        ok = n > 0;
+        if(ok)
+          written += n;
+      }
+      if(::close(fd) != 0 || !ok) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("unable to write \"" + tmp + "\"");
+      }
+#endif
+      return tmp;
+    }
+
+    class writer {
+    public:
+      void u8(std::uint8_t value) {
+        data_.push_back(static_cast<char>(value));
+      }
+
+      void u32(std::uint32_t value) {
+        for(int i = 0; i != 4; i++)
+          u8(static_cast<std::uint8_t>(value >> (i * 8)));
+      }
+
+      void u64(std::uint64_t value) {
+        for(int i = 0; i != 8; i++)
+          u8(static_cast<std::uint8_t>(value >> (i * 8)));
+      }
+
+      void str(const std::string &value) {
+        u32(static_cast<std::uint32_t>(value.size()));
+        data_ += value;
+      }
+
+      void raw(const char *value, std::size_t size) {
+        data_.append(value, size);
+      }
+
+      const std::string & data() const {
+        return data_;
+      }
+    private:
+      std::string data_;
+    };
+
+    class reader {
+    public:
+      reader(const std::string &data) : data_(data) {}
+
+      std::uint8_t u8() {
+        need(1);
+        return static_cast<std::uint8_t>(data_[pos_++]);
+      }
+
+      std::uint32_t u32() {
+        need(4);
+        std::uint32_t value = 0;
+        for(int i = 0; i != 4; i++)
+          value |= std::uint32_t(std::uint8_t(data_[pos_++])) << (i * 8);
+        return value;
+      }
+
+      std::uint64_t u64() {
+        need(8);
+        std::uint64_t value = 0;
+        for(int i = 0; i != 8; i++)
+          value |= std::uint64_t(std::uint8_t(data_[pos_++])) << (i * 8);
+        return value;
+      }
+
+      std::string str() {
+        std::size_t size = u32();
+        need(size);
+        std::string value = data_.substr(pos_, size);
+        pos_ += size;
+        return value;
+      }
+
+      bool raw(const char *value, std::size_t size) {
+        if(data_.size() - pos_ < size ||
+           std::memcmp(data_.data() + pos_, value, size) != 0)
+          return false;
+        pos_ += size;
+        return true;
+      }
+
+      bool done() const {
+        return pos_ == data_.size();
+      }
+    private:
+      void need(std::size_t size) const {
+        if(data_.size() - pos_ < size)
+          throw std::runtime_error("unexpected end of history file");
+      }
+
+      const std::string &data_;
+      std::size_t pos_ = 0;
+    };
+
+    void write_entry(writer &w, const std::string &name,
+                     const test_history::entry &e) {
+      w.str(name);
+      w.u64(static_cast<std::uint64_t>(e.duration.count()));
+      w.u8(e.passed);
+    }
+
+    std::pair<std::string, test_history::entry> read_entry(reader &r) {
+      auto name = r.str();
+      auto duration = log::test_duration(r.u64());
+      bool passed = r.u8() != 0;
+      return {std::move(name), {duration, passed}};
+    }
+  }
+
+  test_history test_history::load(const std::string &filename) {
+    test_history history;
+
+    std::ifstream in(filename, std::ios::binary);
+    if(!in)
+      return history;
+    std::string data{std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>()};
+
+    reader r(data);
+    if(!r.raw(magic, magic_size))
+      throw std::runtime_error("invalid history file \"" + filename + "\"");
+
+    for(std::uint32_t groups = r.u32(); groups != 0; groups--) {
+      auto &tests = history.tests_[r.str()];
+      std::uint32_t count = r.u32();
+      tests.reserve(count);
+      for(; count != 0; count--)
+        tests.insert(read_entry(r));
+    }
+
+    std::uint32_t count = r.u32();
+    history.files_.reserve(count);
+    for(; count != 0; count--)
+      history.files_.insert(read_entry(r));
+
+    if(!r.done())
+      throw std::runtime_error("invalid history file \"" + filename + "\"");
+    return history;
+  }
+
+  void test_history::save(const std::string &filename) const {
+    writer w;
+    w.raw(magic, magic_size);
+
+    w.u32(static_cast<std::uint32_t>(tests_.size()));
+    for(const auto &group : tests_) {
+      w.str(group.first);
+      w.u32(static_cast<std::uint32_t>(group.second.size()));
+      for(const auto &i : group.second)
+        write_entry(w, i.first, i.second);
+    }
+
+    w.u32(static_cast<std::uint32_t>(files_.size()));
+    for(const auto &i : files_)
+      write_entry(w, i.first, i.second);
+
+    // Write to a temporary file first so that a crash can't leave a partially
+    // written history behind.
+    std::string tmp = write_temp_file(filename, w.data());
+    // Unlike `std::rename`, this replaces an existing file on Windows too.
+    std::error_code ec;
+    std::filesystem::rename(tmp, filename, ec);
+    if(ec) {
+      std::remove(tmp.c_str());
+      throw std::runtime_error("unable to write \"" + filename + "\"");
+    }
+  }
+
+  std::optional<test_history::entry>
+  test_history::find(const test_name &test) const {
+    auto group = tests_.find(test.file);
+    if(group == tests_.end())
+      return std::nullopt;
+    auto i = group->second.find(test.full_name());
+    if(i == group->second.end())
+      return std::nullopt;
+    return i->second;
+  }
+
+  std::optional<test_history::entry>
+  test_history::find_file(const std::string &file) const {
+    auto i = files_.find(file);
+    if(i == files_.end())
+      return std::nullopt;
+    return i->second;
+  }
+
+  void test_history::record(const test_name &test, log::test_duration duration,
+                            bool passed) {
+    tests_[test.file][test.full_name()] = {duration, passed};
+  }
+
+  void test_history::record_file(const std::string &file,
+                                 log::test_duration duration, bool passed) {
+    files_[file] = {duration, passed};
+  }
+
+  std::size_t test_history::size() const {
+    std::size_t size = files_.size();
+    for(const auto &group : tests_)
+      size += group.second.size();
+    return size;
+  }
+
+} // namespace mettle
@@ -117,6 +117,11 @@ namespace mettle {
     // Do one last non-blocking read to get any data we might have missed.
     read_into(dests, 0, interrupts);
 
+    if(output_limit_) {
+      log::elide_log(output.stdout_log, output.stdout_elided, output_limit_);
+      log::elide_log(output.stderr_log, output.stderr_elided, output_limit_);
+    }
+
     // By now, the child process's main thread has returned, so kill any stray
     // processes in the job.
     TerminateJobObject(job, 1);
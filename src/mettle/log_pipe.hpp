@@ -1,20 +1,35 @@
 #ifndef INC_METTLE_SRC_LOG_PIPE_HPP
 #define INC_METTLE_SRC_LOG_PIPE_HPP
 
+#include <cctype>
 #include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 #include <bencode.hpp>
 
 #include <mettle/driver/log/core.hpp>
+#include <mettle/driver/log/frame.hpp>
+#include <mettle/driver/run_tests.hpp>
 
 namespace mettle::log {
 
   class pipe {
   public:
-    pipe(log::file_logger &logger, test_uid file_uid)
-      : logger_(logger), file_uid_(file_uid) {}
+    pipe(log::file_logger &logger, test_uid file_uid,
+         failure_limit *fail_fast = nullptr)
+      : logger_(logger), file_uid_(file_uid), fail_fast_(fail_fast) {}
 
     void operator ()(std::istream &s) {
+      // Children can send either binary frames or bencoded events; tell them
+      // apart by their first byte.
+      if(s.peek() == std::char_traits<char>::to_int_type(frame::marker)) {
+        read_frame(s);
+        return;
+      }
+
       auto tmp = bencode::decode(s, bencode::no_check_eof);
       auto &data = std::get<bencode::dict>(tmp);
       auto &&event = std::get<bencode::string>(data.at("event"));
@@ -38,17 +53,168 @@ namespace mettle::log {
           read_test_output( std::move(data.at("output")) ),
           read_test_duration( std::move(data.at("duration")) )
         );
+        if(fail_fast_)
+          fail_fast_->add_failure();
       } else if(event == "skipped_test") {
         logger_.skipped_test(read_test_name( std::move(data.at("test")) ),
                              read_string( std::move(data.at("message"))) );
+      } else if(event == "test_output_chunk") {
+        auto &&stream = std::get<bencode::string>(data.at("stream"));
+        logger_.test_output_chunk(
+          read_test_name( std::move(data.at("test")) ),
+          stream == "stdout_log" ? log::output_stream::stdout_log :
+                                   log::output_stream::stderr_log,
+          read_string( std::move(data.at("data")) )
+        );
       } else if(event == "failed_file") {
         logger_.failed_file(
           {read_string( std::move(data.at("file")) ), file_uid_},
           read_string( std::move(data.at("message")) )
         );
+        if(fail_fast_)
+          fail_fast_->add_failure();
+      }
+    }
+
+    // Get the size of the first complete event in `data`, or 0 if the event
+    // is still incomplete. This lets us pick complete events out of a stream
+    // without blocking on the rest of it.
+    static std::size_t event_size(std::string_view data) {
+      if(!data.empty() && data[0] == frame::marker)
+        return frame::frame_size(data);
+
+      std::size_t depth = 0, i = 0;
+      do {
+        if(i == data.size())
+          return 0;
+
+        char c = data[i];
+        if(c == 'i') {
+          if((i = data.find('e', i)) == std::string_view::npos)
+            return 0;
+          i++;
+        } else if(c == 'l' || c == 'd') {
+          depth++;
+          i++;
+        } else if(c == 'e' && depth > 0) {
+          depth--;
+          i++;
+        } else if(std::isdigit(static_cast<unsigned char>(c))) {
+          std::size_t colon = data.find(':', i);
+          if(colon == std::string_view::npos)
+            return 0;
+          auto length = std::stoull(std::string(data.substr(i, colon - i)));
+          if(data.size() - colon - 1 < length)
+            return 0;
+          i = colon + 1 + length;
+        } else {
+          // This isn't valid bencode; let the decoder report the error.
+          return data.size();
+        }
+      } while(depth > 0);
+      return i;
+    }
+
+    // Check if a complete event (see `event_size`) reports a failure.
+    static bool is_failure(std::string_view data) {
+      if(data[0] == frame::marker) {
+        auto type = frame::read_header(data).first;
+        return type == frame::event_type::failed_test ||
+               type == frame::event_type::failed_file;
       }
+
+      std::istringstream ss{std::string(data)};
+      auto tmp = bencode::decode(ss, bencode::no_check_eof);
+      auto &event = std::get<bencode::string>(
+        std::get<bencode::dict>(tmp).at("event")
+      );
+      return event == "failed_test" || event == "failed_file";
     }
   private:
+    void read_frame(std::istream &s) {
+      char header[frame::header_size];
+      if(!s.read(header, frame::header_size))
+        throw std::runtime_error("unexpected end of event");
+      auto [type, size] = frame::read_header({header, frame::header_size});
+
+      payload_.resize(size);
+      if(!s.read(payload_.data(), size))
+        throw std::runtime_error("unexpected end of event");
+      frame::reader r(payload_);
+
+      using frame::event_type;
+      switch(type) {
+      case event_type::started_run:
+      case event_type::ended_run:
+        break;
+      case event_type::started_suite:
+        logger_.started_suite(r.suites());
+        break;
+      case event_type::ended_suite:
+        logger_.ended_suite(r.suites());
+        break;
+      case event_type::started_test:
+        logger_.started_test(read_test_name(r));
+        break;
+      case event_type::passed_test: {
+        auto test = read_test_name(r);
+        auto duration = log::test_duration(r.u64());
+        logger_.passed_test(test, r.output(), duration);
+        break;
+      }
+      case event_type::failed_test: {
+        auto test = read_test_name(r);
+        auto duration = log::test_duration(r.u64());
+        auto message = r.str();
+        logger_.failed_test(test, message, r.output(), duration);
+        if(fail_fast_)
+          fail_fast_->add_failure();
+        break;
+      }
+      case event_type::skipped_test: {
+        auto test = read_test_name(r);
+        logger_.skipped_test(test, r.str());
+        break;
+      }
+      case event_type::failed_file: {
+        auto file = r.str();
+        logger_.failed_file({std::move(file), file_uid_}, r.str());
+        if(fail_fast_)
+          fail_fast_->add_failure();
+        break;
+      }
+      case event_type::define_suites: {
+        auto id = r.u64();
+        names_.define_suites(id, r.suites());
+        break;
+      }
+      case event_type::define_file: {
+        auto id = r.u64();
+        names_.define_file(id, r.str());
+        break;
+      }
+      case event_type::output_chunk: {
+        auto test = read_test_name(r);
+        auto stream = r.u64() == 0 ? log::output_stream::stdout_log :
+                                     log::output_stream::stderr_log;
+        logger_.test_output_chunk(test, stream, r.str());
+        break;
+      }
+      default:
+        throw std::runtime_error("unknown event type");
+      }
+    }
+
+    test_name read_test_name(frame::reader &r) {
+      test_name test;
+      test.id = file_uid_ + static_cast<test_uid>(r.u64());
+      test.suites = names_.suites(r.u64());
+      test.name = r.str();
+      test.file = names_.file(r.u64());
+      test.line = static_cast<long long>(r.u64());
+      return test;
+    }
+
     std::vector<std::string> read_suites(bencode::data &&suites) {
       std::vector<std::string> result;
       for(auto &&i : std::get<bencode::list>(suites))
@@ -75,10 +241,39 @@ namespace mettle::log {
 
     log::test_output read_test_output(bencode::data &&output) {
       auto &data = std::get<bencode::dict>(output);
-      return log::test_output{
+      log::test_output result{
         std::move(std::get<bencode::string>( data.at("stdout_log") )),
-        std::move(std::get<bencode::string>( data.at("stderr_log") ))
+        std::move(std::get<bencode::string>( data.at("stderr_log") )),
+        read_elided(data, "stdout_elided"),
+        read_elided(data, "stderr_elided"),
+        std::nullopt
       };
+
+      auto resources = data.find("resources");
+      if(resources != data.end()) {
+        auto &r = std::get<bencode::dict>(resources->second);
+        auto get = [&r](const char *key) {
+          return std::get<bencode::integer>(r.at(key));
+        };
+        result.resources = log::test_resources{
+          std::chrono::microseconds(get("user_time")),
+          std::chrono::microseconds(get("system_time")),
+          static_cast<std::uint64_t>(get("max_rss")),
+          static_cast<std::uint64_t>(get("minor_faults")),
+          static_cast<std::uint64_t>(get("major_faults")),
+          static_cast<std::uint64_t>(get("voluntary_switches")),
+          static_cast<std::uint64_t>(get("involuntary_switches"))
+        };
+      }
+      return result;
+    }
+
+    // Older test files don't report elided output, so treat it as optional.
+    std::size_t read_elided(const bencode::dict &data, const char *key) {
+      auto i = data.find(key);
+      if(i == data.end())
+        return 0;
+      return static_cast<std::size_t>(std::get<bencode::integer>(i->second));
     }
 
     log::test_duration read_test_duration(bencode::data &&duration) {
@@ -91,6 +286,9 @@ namespace mettle::log {
 
     log::file_logger &logger_;
     test_uid file_uid_;
+    failure_limit *fail_fast_;
+    std::string payload_;
+    frame::name_table names_;
   };
 
 } // namespace mettle::log
@@ -6,6 +6,7 @@
 
 #include <mettle/driver/cmd_line.hpp>
 #include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/log/history.hpp>
 #include <mettle/driver/log/summary.hpp>
 #include <mettle/driver/log/term.hpp>
 
@@ -16,6 +17,11 @@ namespace mettle {
   namespace {
     struct all_options : generic_options, driver_options, output_options {
       std::vector<test_command> files;
+#ifndef _WIN32
+      std::size_t jobs = 1;
+      schedule_mode schedule = schedule_mode::file;
+#endif
+      std::optional<std::size_t> fail_fast;
     };
 
     const char program_name[] = "mettle";
@@ -24,6 +30,22 @@ namespace mettle {
     }
   }
 
+#ifndef _WIN32
+  void validate(boost::any &v, const std::vector<std::string> &values,
+                schedule_mode*, int) {
+    using namespace boost::program_options;
+    validators::check_first_occurrence(v);
+    const std::string &val = validators::get_single_string(values);
+
+    if(val == "file")
+      v = schedule_mode::file;
+    else if(val == "test")
+      v = schedule_mode::test;
+    else
+      boost::throw_exception(invalid_option_value(val));
+  }
+#endif
+
 } // namespace mettle
 
 int main(int argc, const char *argv[]) {
@@ -37,6 +59,22 @@ int main(int argc, const char *argv[]) {
   auto driver = make_driver_options(args);
   auto output = make_output_options(args, factory);
 
+  // These options apply only to the mettle driver itself, so they're kept
+  // separate from the driver options forwarded to each test file.
+  opts::options_description runner("Runner options");
+  runner.add_options()
+    ("fail-fast", opts::value(&args.fail_fast)->value_name("N")
+                    ->implicit_value(std::size_t(1), "1"),
+     "stop running tests after N failures (default: 1)")
+#ifndef _WIN32
+    ("jobs,j", opts::value(&args.jobs)->value_name("N"),
+     "number of test files to run in parallel")
+    ("schedule", opts::value(&args.schedule)->value_name("MODE"),
+     "how to divide the tests between parallel jobs (one of: file, test; "
+     "default: file)")
+#endif
+  ;
+
   opts::options_description hidden("Hidden options");
   hidden.add_options()
     ("input-file", opts::value(&args.files), "input file")
@@ -47,9 +85,9 @@ int main(int argc, const char *argv[]) {
   std::vector<std::string> child_args;
   try {
     opts::options_description all;
-    all.add(generic).add(driver).add(output).add(hidden);
+    all.add(generic).add(driver).add(runner).add(output).add(hidden);
     auto parsed = opts::command_line_parser(argc, argv)
-      .options(all).positional(pos).run();
+      .options(all).positional(pos).extra_parser(parse_fail_fast).run();
 
     opts::variables_map vm;
     opts::store(parsed, vm);
@@ -62,7 +100,7 @@ int main(int argc, const char *argv[]) {
 
   if(args.show_help) {
     opts::options_description displayed;
-    displayed.add(generic).add(driver).add(output);
+    displayed.add(generic).add(driver).add(runner).add(output);
     std::cout << displayed << std::endl;
     return exit_code::success;
   } else if(args.show_version) {
@@ -80,18 +118,86 @@ int main(int argc, const char *argv[]) {
     return exit_code::no_inputs;
   }
 
+#ifndef _WIN32
+  if(args.jobs == 0) {
+    report_error("--jobs must be at least 1");
+    return exit_code::bad_args;
+  }
+  std::size_t jobs = args.jobs;
+  schedule_mode schedule = args.schedule;
+#else
+  std::size_t jobs = 1;
+  schedule_mode schedule = schedule_mode::file;
+#endif
+
+  if(args.fail_fast && *args.fail_fast == 0) {
+    report_error("--fail-fast must be at least 1");
+    return exit_code::bad_args;
+  }
+
+  // The shard options are forwarded to each test file, which picks its own
+  // share of its tests, but check them here so we only report errors once.
+  if(args.shard_count.has_value() != args.shard_index.has_value()) {
+    report_error("--shard-count and --shard-index must be specified together");
+    return exit_code::bad_args;
+  } else if(args.shard_count && *args.shard_count == 0) {
+    report_error("--shard-count must be at least 1");
+    return exit_code::bad_args;
+  } else if(args.shard_count && *args.shard_index >= *args.shard_count) {
+    report_error("--shard-index must be less than --shard-count");
+    return exit_code::bad_args;
+  }
+
+  std::optional<test_history> history;
+  file_estimator estimate;
+  test_estimator estimate_test;
+  if(args.history) {
+    try {
+      history = test_history::load(*args.history);
+    } catch(const std::exception &e) {
+      report_error(e.what());
+      return exit_code::unknown_error;
+    }
+
+    estimate = [&history](const test_command &command)
+      -> std::optional<log::test_duration> {
+      if(auto entry = history->find_file(command))
+        return entry->duration;
+      return std::nullopt;
+    };
+    estimate_test = [&history](const test_name &test)
+      -> std::optional<log::test_duration> {
+      if(auto entry = history->find(test))
+        return entry->duration;
+      return std::nullopt;
+    };
+  }
+
   try {
     term::enable(std::cout, color_enabled(args.color));
     indenting_ostream out(std::cout);
 
+    auto inner = factory.make(args.output, out, args);
+    if(history)
+      inner = std::make_unique<log::history>(*history, std::move(inner));
     log::summary logger(
-      out, factory.make(args.output, out, args), args.show_time,
-      args.show_terminal
+      out, std::move(inner), args.show_time, args.show_terminal
     );
-    for(std::size_t i = 0; i != args.runs; i++)
-      run_test_files(args.files, logger, child_args);
+    std::optional<failure_limit> fail_fast;
+    if(args.fail_fast)
+      fail_fast.emplace(*args.fail_fast);
+
+    for(std::size_t i = 0; i != args.runs; i++) {
+      run_test_files(args.files, logger, child_args, jobs, estimate,
+                     fail_fast ? &*fail_fast : nullptr, schedule,
+                     estimate_test);
+      if(fail_fast && fail_fast->reached())
+        break;
+    }
 
     logger.summarize();
+    if(history)
+      history->save(*args.history);
     return logger.good() ? exit_code::success : exit_code::failure;
   } catch(const std::out_of_range &) {
     report_error("unknown output format \"" + args.output + "\"");
@@ -1,12 +1,17 @@
 #include "run_test_file.hpp"
 
+#include <fcntl.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/resource.h>
 #include <sys/wait.h>
 
+#include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <sstream>
+#include <string_view>
 
 // Ignore warnings about deprecated implicit copy constructor.
 #if defined(__clang__)
@@ -23,10 +28,15 @@
 
 #include <mettle/detail/source_location.hpp>
 #include <mettle/driver/exit_code.hpp>
+#include <mettle/driver/log/child.hpp>
+#include <mettle/driver/posix/child_monitor.hpp>
 #include <mettle/driver/posix/scoped_pipe.hpp>
+#include <mettle/driver/posix/subprocess.hpp>
 
 #include "../../err_string.hpp"
 
+extern char **environ;
+
 #ifdef METTLE_NO_SOURCE_LOCATION
 #  define PARENT_FAILED() parent_failed(                                      \
      ::mettle::detail::source_location::current(__FILE__, __func__, __LINE__) \
@@ -76,63 +86,120 @@ namespace mettle::posix {
       return real_argv;
     }
 
-  }
+    // Copy our environment, replacing or adding each of `vars` (in the form
+    // `NAME=value`). The result refers to `vars`, so it mustn't outlive it.
+    std::unique_ptr<char *[]> make_envp(std::vector<std::string> &vars) {
+      std::size_t size = 0;
+      while(environ[size])
+        size++;
 
-  file_result run_test_file(std::vector<std::string> args, log::pipe &logger) {
-    posix::scoped_pipe message_pipe;
-    if(message_pipe.open() < 0)
-      return PARENT_FAILED();
+      auto envp = std::make_unique<char *[]>(size + vars.size() + 1);
+      std::size_t n = 0;
+      for(std::size_t i = 0; i != size; i++) {
+        std::string_view var = environ[i];
+        bool replaced = std::any_of(
+          vars.begin(), vars.end(), [&var](const std::string &v) {
+            auto name = std::string_view(v).substr(0, v.find('=') + 1);
+            return var.substr(0, name.size()) == name;
+          }
+        );
+        if(!replaced)
+          envp[n++] = environ[i];
+      }
+      for(auto &v : vars)
+        envp[n++] = v.data();
+      envp[n] = nullptr;
+      return envp;
+    }
 
-    rlimit lim;
-    if(getrlimit(RLIMIT_NOFILE, &lim) < 0)
-      return PARENT_FAILED();
-    int max_fd = lim.rlim_cur - 1;
+    // Fork and exec the test file, piping its results to `message_pipe`. The
+    // pipe is close-on-exec so that test files run in parallel don't inherit
+    // each other's pipes; only the child's copy at `max_fd` survives exec.
+    pid_t spawn_test_file(std::vector<std::string> args,
+                          scoped_pipe &message_pipe) {
+      if(message_pipe.open(O_CLOEXEC) < 0)
+        return -1;
 
-    args.insert(args.end(), { "--output-fd", std::to_string(max_fd) });
-    auto argv = make_argv(args);
+      rlimit lim;
+      if(getrlimit(RLIMIT_NOFILE, &lim) < 0)
+        return -1;
+      int max_fd = lim.rlim_cur - 1;
 
-    pid_t pid;
-    if((pid = fork()) < 0)
-      return PARENT_FAILED();
+      args.insert(args.end(), { "--output-fd", std::to_string(max_fd) });
+      auto argv = make_argv(args);
+      std::vector<std::string> env = {
+        std::string(log::protocol_env) + "=binary",
+        std::string(log::buffer_env) + "=65536"
+      };
+      auto envp = make_envp(env);
 
-    if(pid == 0) {
-      if(message_pipe.close_read() < 0)
-        child_failed(message_pipe.write_fd, args[0]);
+      pid_t pid;
+      if((pid = fork()) < 0)
+        return -1;
 
-      if(message_pipe.write_fd != max_fd) {
-        if(dup2(message_pipe.write_fd, max_fd) < 0)
+      if(pid == 0) {
+        if(message_pipe.close_read() < 0)
           child_failed(message_pipe.write_fd, args[0]);
 
-        if(message_pipe.close_write() < 0)
+        if(message_pipe.write_fd != max_fd) {
+          if(dup2(message_pipe.write_fd, max_fd) < 0)
+            child_failed(message_pipe.write_fd, args[0]);
+
+          if(message_pipe.close_write() < 0)
+            child_failed(max_fd, args[0]);
+        } else if(fcntl(max_fd, F_SETFD, 0) < 0) {
           child_failed(max_fd, args[0]);
+        }
+
+        environ = envp.get();
+        execvp(argv[0], argv.get());
+        child_failed(max_fd, args[0]);
       }
 
-      execvp(argv[0], argv.get());
-      child_failed(max_fd, args[0]);
-    } else {
       if(message_pipe.close_write() < 0) {
         kill(pid, SIGKILL);
-        return PARENT_FAILED();
+        waitpid(pid, nullptr, 0);
+        return -1;
       }
+      return pid;
+    }
 
-      std::exception_ptr except;
-      try {
-        namespace io = boost::iostreams;
-        io::stream<io::file_descriptor_source> fds(
-          message_pipe.read_fd, io::never_close_handle
-        );
-        while(fds.peek() != EOF)
-          logger(fds);
-      } catch(...) {
-        except = std::current_exception();
+    // Fork and exec the test file to list its tests, piping the list to
+    // `stdout_pipe`.
+    pid_t spawn_list_file(std::vector<std::string> args,
+                          scoped_pipe &stdout_pipe) {
+      if(stdout_pipe.open(O_CLOEXEC) < 0)
+        return -1;
+
+      args.insert(args.end(), { "--list-format", "binary" });
+      auto argv = make_argv(args);
+
+      pid_t pid;
+      if((pid = fork()) < 0)
+        return -1;
+
+      if(pid == 0) {
+        // Files that can't list their tests will say so on stderr; keep
+        // quiet, since the caller will just run the whole file instead.
+        int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if(devnull < 0 || dup2(devnull, STDERR_FILENO) < 0 ||
+           stdout_pipe.close_read() < 0 ||
+           stdout_pipe.move_write(STDOUT_FILENO) < 0)
+          _exit(exit_code::fatal);
+
+        execvp(argv[0], argv.get());
+        _exit(exit_code::fatal);
       }
 
-      int status;
-      if(waitpid(pid, &status, 0) < 0) {
+      if(stdout_pipe.close_write() < 0) {
         kill(pid, SIGKILL);
-        return PARENT_FAILED();
+        waitpid(pid, nullptr, 0);
+        return -1;
       }
+      return pid;
+    }
 
+    file_result file_status(int status, std::exception_ptr except) {
       if(WIFEXITED(status)) {
         int exit_status = WEXITSTATUS(status);
         if(exit_status != exit_code::success) {
@@ -152,6 +219,310 @@ namespace mettle::posix {
         return {false, strsignal(WTERMSIG(status))};
       }
     }
+
+  }
+
+  file_result run_test_file(std::vector<std::string> args, log::pipe &logger) {
+    scoped_pipe message_pipe;
+    pid_t pid;
+    if((pid = spawn_test_file(std::move(args), message_pipe)) < 0)
+      return PARENT_FAILED();
+
+    std::exception_ptr except;
+    try {
+      namespace io = boost::iostreams;
+      io::stream<io::file_descriptor_source> fds(
+        message_pipe.read_fd, io::never_close_handle
+      );
+      while(fds.peek() != EOF)
+        logger(fds);
+    } catch(...) {
+      except = std::current_exception();
+    }
+
+    int status;
+    if(waitpid(pid, &status, 0) < 0) {
+      kill(pid, SIGKILL);
+      return PARENT_FAILED();
+    }
+    return file_status(status, except);
+  }
+
+  std::optional<std::string> list_test_file(std::vector<std::string> args) {
+    return std::move(list_test_files({std::move(args)}, 1).front());
+  }
+
+  std::vector<std::optional<std::string>>
+  list_test_files(const std::vector<std::vector<std::string>> &files,
+                  std::size_t jobs) {
+    struct listing_file {
+      std::size_t index;
+      pid_t pid;
+      scoped_pipe stdout_pipe;
+      bool failed = false, pipe_closed = false, exited = false;
+    };
+
+    std::vector<std::optional<std::string>> results(files.size());
+    std::vector<std::unique_ptr<listing_file>> running;
+    std::vector<child_monitor::event> events;
+    std::size_t next = 0;
+
+    // As in `run_test_files_parallel`, `reap_monitor` is only used to reap.
+    child_monitor monitor, reap_monitor;
+    if(monitor.open() < 0 || reap_monitor.open() < 0)
+      return results;
+
+    // Stop watching a file, wait for it to exit, and read anything left in
+    // its pipe. Returns true if the file listed its tests successfully.
+    auto reap = [&monitor, &reap_monitor, &results](listing_file &f) {
+      int &fd = f.stdout_pipe.read_fd;
+      monitor.unwatch_child(f.pid);
+      if(fd >= 0)
+        monitor.unwatch_fd(fd);
+
+      int status;
+      if(waitpid(f.pid, &status, 0) < 0 || f.failed)
+        return false;
+
+      std::vector<readfd> dests = {{fd, &*results[f.index]}};
+      timespec timeout = {0, 0};
+      if(fd >= 0 && read_into(dests, reap_monitor, &timeout, nullptr) < 0)
+        return false;
+      return WIFEXITED(status) && WEXITSTATUS(status) == exit_code::success;
+    };
+
+    while(next != files.size() || !running.empty()) {
+      while(next != files.size() && running.size() < jobs) {
+        auto f = std::make_unique<listing_file>();
+        f->index = next++;
+        if((f->pid = spawn_list_file(files[f->index], f->stdout_pipe)) < 0)
+          continue;
+
+        results[f->index].emplace();
+        if(monitor.watch_fd(f->stdout_pipe.read_fd, f.get()) < 0 ||
+           monitor.watch_child(f->pid, f.get()) < 0) {
+          kill(f->pid, SIGKILL);
+          f->failed = true;
+          reap(*f);
+          results[f->index].reset();
+          continue;
+        }
+        running.push_back(std::move(f));
+      }
+      if(running.empty())
+        continue;
+
+      if(monitor.wait(events, nullptr, nullptr) < 0) {
+        if(errno == EINTR)
+          continue;
+        for(auto &f : running) {
+          kill(f->pid, SIGKILL);
+          f->failed = true;
+          reap(*f);
+          results[f->index].reset();
+        }
+        running.clear();
+        continue;
+      }
+
+      for(const auto &e : events) {
+        auto &f = *static_cast<listing_file*>(e.data);
+        if(e.type == child_monitor::event_type::exited) {
+          f.exited = true;
+          continue;
+        } else if(f.pipe_closed) {
+          continue;
+        }
+
+        char buf[BUFSIZ];
+        ssize_t size = read(f.stdout_pipe.read_fd, buf, sizeof(buf));
+        if(size > 0) {
+          results[f.index]->append(buf, size);
+          continue;
+        } else if(size < 0 && (errno == EINTR || errno == EAGAIN)) {
+          continue;
+        }
+
+        if(size < 0) {
+          f.failed = true;
+          kill(f.pid, SIGKILL);
+        }
+        monitor.unwatch_fd(f.stdout_pipe.read_fd);
+        f.stdout_pipe.close_read();
+        f.pipe_closed = true;
+      }
+
+      // Walk backwards so that finished files can be removed as we go.
+      for(std::size_t i = running.size(); i-- != 0;) {
+        auto &f = *running[i];
+        if(!f.exited)
+          continue;
+
+        if(!reap(f))
+          results[f.index].reset();
+        running.erase(running.begin() + i);
+      }
+    }
+    return results;
+  }
+
+  void run_test_files_parallel(
+    const std::vector<std::vector<std::string>> &files, std::size_t jobs,
+    const file_output_callback &output, const file_done_callback &done,
+    const file_cancel_callback &cancel
+  ) {
+    struct running_file {
+      std::size_t index;
+      pid_t pid;
+      scoped_pipe message_pipe;
+      std::optional<file_result> result;
+      bool pipe_closed = false, exited = false;
+    };
+
+    std::vector<std::unique_ptr<running_file>> running;
+    std::vector<child_monitor::event> events;
+    std::size_t next = 0;
+    bool cancelled = false;
+
+    // `reap_monitor` only ever watches the pipe of the file being reaped, so
+    // that we don't have to open a new one for each file.
+    child_monitor monitor, reap_monitor;
+    if(monitor.open() < 0 || reap_monitor.open() < 0) {
+      auto result = PARENT_FAILED();
+      for(std::size_t i = 0; i != files.size(); i++)
+        done(i, result);
+      return;
+    }
+
+    // Stop watching a file, wait for it to exit, and pass along anything left
+    // in its pipe. We don't wait for EOF, since the file may have left behind
+    // a child process that still holds the pipe open. This only blocks when
+    // we've killed the file ourselves; otherwise, we've already been told
+    // that it exited.
+    auto reap = [&monitor, &reap_monitor, &output](running_file &f,
+                                                  int *status) {
+      int &fd = f.message_pipe.read_fd;
+      monitor.unwatch_child(f.pid);
+      if(fd >= 0)
+        monitor.unwatch_fd(fd);
+
+      if(waitpid(f.pid, status, 0) < 0)
+        return -1;
+
+      std::string rest;
+      std::vector<readfd> dests = {{fd, &rest}};
+      timespec timeout = {0, 0};
+      if(fd >= 0 && read_into(dests, reap_monitor, &timeout, nullptr) < 0)
+        return -1;
+      output(f.index, rest.data(), rest.size());
+      return 0;
+    };
+
+    auto fail_all = [&running, &reap, &done](const file_result &result) {
+      for(auto &f : running) {
+        kill(f->pid, SIGKILL);
+        reap(*f, nullptr);
+        done(f->index, result);
+      }
+      running.clear();
+    };
+
+    // Interrupt every running file and skip the rest. The files' drivers
+    // will pass SIGINT along to their tests' process groups before exiting.
+    auto cancel_all = [&](const file_result &result) {
+      cancelled = true;
+      for(auto &f : running) {
+        kill(f->pid, SIGINT);
+        f->result = result;
+      }
+      for(; next != files.size(); next++)
+        done(next, result);
+    };
+
+    while(next != files.size() || !running.empty()) {
+      if(!cancelled && cancel) {
+        if(auto result = cancel())
+          cancel_all(*result);
+      }
+
+      while(next != files.size() && running.size() < jobs) {
+        auto f = std::make_unique<running_file>();
+        f->index = next++;
+        if((f->pid = spawn_test_file(files[f->index], f->message_pipe)) < 0) {
+          done(f->index, PARENT_FAILED());
+          continue;
+        }
+
+        if(monitor.watch_fd(f->message_pipe.read_fd, f.get()) < 0 ||
+           monitor.watch_child(f->pid, f.get()) < 0) {
+          auto result = PARENT_FAILED();
+          kill(f->pid, SIGKILL);
+          reap(*f, nullptr);
+          done(f->index, result);
+          continue;
+        }
+        running.push_back(std::move(f));
+      }
+      if(running.empty())
+        continue;
+
+      if(monitor.wait(events, nullptr, nullptr) < 0) {
+        if(errno != EINTR)
+          fail_all(PARENT_FAILED());
+        continue;
+      }
+
+      for(const auto &e : events) {
+        auto &f = *static_cast<running_file*>(e.data);
+        if(e.type == child_monitor::event_type::exited || f.pipe_closed)
+          continue;
+
+        char buf[BUFSIZ];
+        ssize_t size = read(f.message_pipe.read_fd, buf, sizeof(buf));
+        if(size > 0) {
+          output(f.index, buf, size);
+          continue;
+        } else if(size < 0 && (errno == EINTR || errno == EAGAIN)) {
+          continue;
+        }
+
+        // The file has closed its end of the pipe (or we failed to read), so
+        // it's about to finish. Stop reading, but don't reap it until we're
+        // told it's exited, so that we don't hold up the other files.
+        if(size < 0) {
+          f.result = PARENT_FAILED();
+          kill(f.pid, SIGKILL);
+        }
+        monitor.unwatch_fd(f.message_pipe.read_fd);
+        f.message_pipe.close_read();
+        f.pipe_closed = true;
+      }
+
+      for(const auto &e : events) {
+        if(e.type == child_monitor::event_type::exited)
+          static_cast<running_file*>(e.data)->exited = true;
+      }
+
+      // Walk backwards so that finished files can be removed as we go.
+      for(std::size_t i = running.size(); i-- != 0;) {
+        auto &f = *running[i];
+        if(!f.exited)
+          continue;
+
+        int status;
+        file_result result;
+        if(reap(f, &status) < 0)
+          result = PARENT_FAILED();
+        else if(f.result)
+          result = std::move(*f.result);
+        else
+          result = file_status(status, nullptr);
+
+        std::size_t index = f.index;
+        running.erase(running.begin() + i);
+        done(index, std::move(result));
+      }
+    }
   }
 
 } // namespace mettle::posix
@@ -1,6 +1,9 @@
 #ifndef INC_METTLE_SRC_POSIX_RUN_TEST_FILE_HPP
 #define INC_METTLE_SRC_POSIX_RUN_TEST_FILE_HPP
 
+#include <cstdint>
+#include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -16,6 +19,31 @@ namespace mettle::posix {
     return run_test_file(std::move(args), logger);
   }
 
+  // Get the raw list of the tests in a test file (in the `binary` list
+  // format), or nothing if the file couldn't list its tests.
+  std::optional<std::string> list_test_file(std::vector<std::string> args);
+
+  // List the tests in each of `files`, running up to `jobs` of them at once.
+  std::vector<std::optional<std::string>>
+  list_test_files(const std::vector<std::vector<std::string>> &files,
+                  std::size_t jobs);
+
+  using file_output_callback = std::function<
+    void(std::size_t, const char *, std::size_t)
+  >;
+  using file_done_callback = std::function<void(std::size_t, file_result)>;
+  using file_cancel_callback = std::function<std::optional<file_result>()>;
+
+  // Run up to `jobs` test files at once, passing along their raw output and
+  // their results (identified by their index in `files`) as they arrive. If
+  // `cancel` returns a result, interrupt any running files and skip the rest,
+  // reporting that result for each.
+  void run_test_files_parallel(
+    const std::vector<std::vector<std::string>> &files, std::size_t jobs,
+    const file_output_callback &output, const file_done_callback &done,
+    const file_cancel_callback &cancel = nullptr
+  );
+
 } // namespace mettle::posix
 
 #endif
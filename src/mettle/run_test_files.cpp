@@ -1,5 +1,13 @@
 #include "run_test_files.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <sstream>
+
+#include <mettle/driver/list_tests.hpp>
+#include <mettle/driver/run_tests.hpp>
+
 #include "log_pipe.hpp"
 
 #ifndef _WIN32
@@ -12,27 +20,428 @@ namespace platform = mettle::windows;
 
 namespace mettle {
 
+  namespace {
+
+    std::vector<std::string>
+    make_args(const test_command &command, const std::vector<std::string> &args,
+              failure_limit *fail_fast) {
+      std::vector<std::string> final_args = command.args();
+      final_args.insert(final_args.end(), args.begin(), args.end());
+      if(fail_fast) {
+        final_args.push_back("--fail-fast=" +
+                             std::to_string(fail_fast->remaining()));
+      }
+      return final_args;
+    }
+
+#ifndef _WIN32
+    // A piece of a test file to run in its own process: either the whole file
+    // or, when scheduling by test, a chunk of its tests.
+    struct work_item {
+      std::size_t file;
+      std::vector<std::string> args;
+      std::optional<log::test_duration> estimate;
+    };
+
+    // The state of a work item being run in parallel. Its output is held here
+    // until every item before it has been reported, so that the logger only
+    // ever sees one file at a time.
+    struct parallel_item {
+      parallel_item(const test_file &file, log::file_logger &logger)
+        : pipe(logger, file.id) {}
+
+      // Pass along every complete event we've received so far. If `final` is
+      // set, pass along whatever is left too, which will report an error if
+      // the item's output was truncated.
+      void flush(bool final = false) {
+        if(except)
+          return;
+
+        try {
+          std::size_t size, total = 0;
+          std::string_view rest = buffer;
+          while((size = log::pipe::event_size(rest.substr(total))) != 0)
+            total += size;
+          if(final)
+            total = buffer.size();
+          if(total == 0)
+            return;
+
+          std::istringstream ss(buffer.substr(0, total));
+          buffer.erase(0, total);
+          while(ss.peek() != EOF)
+            pipe(ss);
+        } catch(...) {
+          except = std::current_exception();
+        }
+      }
+
+      // Count the failures in any complete events we've received so far,
+      // whether or not we can report them yet.
+      void count_failures(const char *data, std::size_t size,
+                          failure_limit &fail_fast) {
+        if(except)
+          return;
+
+        scanned.append(data, size);
+        try {
+          std::size_t size;
+          while((size = log::pipe::event_size(scanned)) != 0) {
+            if(log::pipe::is_failure(std::string_view(scanned).substr(0, size)))
+              fail_fast.add_failure();
+            scanned.erase(0, size);
+          }
+        } catch(...) {
+          // The pipe will report this error once it reaches it.
+          scanned.clear();
+        }
+      }
+
+      log::pipe pipe;
+      std::string buffer, scanned;
+      std::exception_ptr except;
+      std::optional<file_result> result;
+    };
+
+    // Join the suites of consecutive work items from the same file, so that a
+    // suite split across several items is only reported once. Each
+    // `ended_suite` is held until we know whether the next event starts the
+    // same suite again.
+    class suite_joiner : public log::file_logger {
+    public:
+      suite_joiner(log::file_logger &logger) : logger_(logger) {}
+
+      void started_run() override {
+        flush();
+        logger_.started_run();
+      }
+      void ended_run() override {
+        flush();
+        logger_.ended_run();
+      }
+
+      void started_suite(const std::vector<std::string> &suites) override {
+        if(!ended_.empty() && ended_.back() == suites) {
+          ended_.pop_back();
+          return;
+        }
+        flush();
+        logger_.started_suite(suites);
+      }
+      void ended_suite(const std::vector<std::string> &suites) override {
+        ended_.push_back(suites);
+      }
+
+      void started_test(const test_name &test) override {
+        flush();
+        logger_.started_test(test);
+      }
+      void passed_test(const test_name &test, const log::test_output &output,
+                       log::test_duration duration) override {
+        flush();
+        logger_.passed_test(test, output, duration);
+      }
+      void failed_test(const test_name &test, const std::string &message,
+                       const log::test_output &output,
+                       log::test_duration duration) override {
+        flush();
+        logger_.failed_test(test, message, output, duration);
+      }
+      void skipped_test(const test_name &test,
+                        const std::string &message) override {
+        flush();
+        logger_.skipped_test(test, message);
+      }
+      void test_output_chunk(const test_name &test, log::output_stream stream,
+                             std::string_view data) override {
+        logger_.test_output_chunk(test, stream, data);
+      }
+
+      void started_file(const test_file &file) override {
+        flush();
+        logger_.started_file(file);
+      }
+      void ended_file(const test_file &file) override {
+        flush();
+        logger_.ended_file(file);
+      }
+      void failed_file(const test_file &file,
+                       const std::string &message) override {
+        flush();
+        logger_.failed_file(file, message);
+      }
+    private:
+      void flush() {
+        for(const auto &suites : ended_)
+          logger_.ended_suite(suites);
+        ended_.clear();
+      }
+
+      log::file_logger &logger_;
+      std::vector<std::vector<std::string>> ended_;
+    };
+
+    std::vector<work_item> schedule_files(
+      const std::vector<test_command> &commands,
+      const std::vector<std::string> &args, const file_estimator &estimate,
+      failure_limit *fail_fast
+    ) {
+      std::vector<work_item> items;
+      for(std::size_t i = 0; i != commands.size(); i++) {
+        items.push_back({i, make_args(commands[i], args, fail_fast),
+                         estimate ? estimate(commands[i]) : std::nullopt});
+      }
+      return items;
+    }
+
+    // Add the IDs of `tests[begin, end)` to `args`, collapsing runs of
+    // consecutive IDs into ranges so that large chunks still fit on the
+    // command line.
+    void add_test_ids(std::vector<std::string> &args,
+                      const std::vector<test_name> &tests, std::size_t begin,
+                      std::size_t end) {
+      while(begin != end) {
+        test_uid first = tests[begin].id, last = first;
+        while(++begin != end && tests[begin].id == last + 1)
+          last++;
+
+        std::string range = std::to_string(first);
+        if(last != first)
+          range += "-" + std::to_string(last);
+        args.insert(args.end(), {"--test-id", std::move(range)});
+      }
+    }
+
+    // Split each file's tests into chunks of roughly equal estimated duration,
+    // several per job so that the chunks can be balanced between the jobs.
+    // Each chunk is still run by its own file, so its results are reported
+    // with the rest of that file's. Files that can't list their tests are run
+    // whole.
+    std::vector<work_item> schedule_tests(
+      const std::vector<test_command> &commands,
+      const std::vector<std::string> &args, std::size_t jobs,
+      const file_estimator &estimate, const test_estimator &estimate_test,
+      failure_limit *fail_fast
+    ) {
+      const std::size_t chunks_per_job = 4;
+
+      // Pass along the driver options so that the lists are already filtered.
+      std::vector<std::vector<std::string>> all_list_args;
+      for(const auto &command : commands) {
+        auto &list_args = all_list_args.emplace_back(command.args());
+        list_args.insert(list_args.end(), args.begin(), args.end());
+      }
+      auto lists = platform::list_test_files(all_list_args, jobs);
+
+      std::vector<std::optional<std::vector<test_name>>> listed;
+      std::vector<std::vector<std::optional<log::test_duration>>> estimates;
+      log::test_duration known_total{0};
+      std::size_t known = 0;
+      for(const auto &data : lists) {
+        auto &tests = listed.emplace_back();
+        auto &test_estimates = estimates.emplace_back();
+        if(data) {
+          try {
+            tests = read_test_list(*data);
+          } catch(...) {}
+        }
+        if(!tests)
+          continue;
+
+        for(const auto &test : *tests) {
+          auto e = estimate_test ? estimate_test(test) : std::nullopt;
+          if(e) {
+            known_total += *e;
+            known++;
+          }
+          test_estimates.push_back(e);
+        }
+      }
+
+      // As with sharding, tests with no estimate are assumed to take the
+      // average time, and every test takes at least a millisecond.
+      auto average = known ? known_total / static_cast<
+        log::test_duration::rep
+      >(known) : log::test_duration{1};
+      auto weight = [&average](const std::optional<log::test_duration> &e) {
+        return std::max(e ? *e : average, log::test_duration{1});
+      };
+
+      log::test_duration total{0};
+      for(const auto &test_estimates : estimates) {
+        for(const auto &e : test_estimates)
+          total += weight(e);
+      }
+      auto target = total / static_cast<log::test_duration::rep>(
+        jobs * chunks_per_job
+      );
+
+      std::vector<work_item> items;
+      for(std::size_t i = 0; i != commands.size(); i++) {
+        auto file_args = make_args(commands[i], args, fail_fast);
+        if(!listed[i] || listed[i]->empty()) {
+          items.push_back({i, std::move(file_args),
+                           estimate ? estimate(commands[i]) : std::nullopt});
+          continue;
+        }
+
+        const auto &tests = *listed[i];
+        std::size_t chunk_begin = 0;
+        log::test_duration chunk{0};
+        for(std::size_t j = 0; j != tests.size(); j++) {
+          chunk += weight(estimates[i][j]);
+          if(chunk >= target || j + 1 == tests.size()) {
+            std::vector<std::string> chunk_args = file_args;
+            add_test_ids(chunk_args, tests, chunk_begin, j + 1);
+            items.push_back({i, std::move(chunk_args), chunk});
+            chunk_begin = j + 1;
+            chunk = log::test_duration{0};
+          }
+        }
+      }
+      return items;
+    }
+
+    void run_parallel(
+      const std::vector<test_command> &commands, std::vector<work_item> items,
+      log::file_logger &logger, std::size_t jobs, failure_limit *fail_fast
+    ) {
+      detail::file_uid_maker uid;
+      std::vector<test_file> files;
+      files.reserve(commands.size());
+      for(const auto &command : commands)
+        files.push_back({command, uid.make_file_uid()});
+
+      std::vector<parallel_item> pending;
+      std::vector<std::optional<log::test_duration>> estimates;
+      pending.reserve(items.size());
+      for(const auto &item : items) {
+        pending.emplace_back(files[item.file], logger);
+        estimates.push_back(item.estimate);
+      }
+
+      // Start the items longest-first; they're still reported in the order
+      // they were given.
+      auto order = detail::longest_first(estimates);
+      std::vector<std::vector<std::string>> all_args;
+      for(auto i : order)
+        all_args.push_back(std::move(items[i].args));
+
+      // A file is finished once its last item has been reported, and fails if
+      // any of its items did.
+      std::size_t head = 0;
+      std::optional<file_result> failure;
+      auto report = [&pending, &items, &files, &logger, &head, &failure]() {
+        while(head != pending.size()) {
+          auto &p = pending[head];
+          p.flush(bool(p.result));
+          if(!p.result)
+            return;
+
+          auto result = std::move(*p.result);
+          if(result.passed && p.except) {
+            try {
+              std::rethrow_exception(p.except);
+            } catch(const std::exception &e) {
+              result = {false, e.what()};
+            }
+          }
+          if(!result.passed && !failure)
+            failure = std::move(result);
+
+          auto file = items[head].file;
+          if(++head != pending.size() && items[head].file == file)
+            continue;
+
+          if(failure)
+            logger.failed_file(files[file], failure->message);
+          else
+            logger.ended_file(files[file]);
+          failure.reset();
+
+          if(head != pending.size())
+            logger.started_file(files[items[head].file]);
+        }
+      };
+
+      if(!pending.empty())
+        logger.started_file(files[items[0].file]);
+
+      platform::run_test_files_parallel(
+        all_args, jobs,
+        [&pending, &order, &head, fail_fast](std::size_t i, const char *data,
+                                             std::size_t size) {
+          i = order[i];
+          if(fail_fast)
+            pending[i].count_failures(data, size, *fail_fast);
+          pending[i].buffer.append(data, size);
+          if(i == head)
+            pending[i].flush();
+        },
+        [&pending, &order, &report, fail_fast](std::size_t i,
+                                               file_result result) {
+          if(fail_fast && !result.passed)
+            fail_fast->add_failure();
+          pending[order[i]].result = std::move(result);
+          report();
+        },
+        [fail_fast]() -> std::optional<file_result> {
+          if(fail_fast && fail_fast->reached())
+            return file_result{false, fail_fast->cancelled_message()};
+          return std::nullopt;
+        }
+      );
+    }
+#endif
+
+  }
+
   void run_test_files(
     const std::vector<test_command> &commands, log::file_logger &logger,
-    const std::vector<std::string> &args
+    const std::vector<std::string> &args, std::size_t jobs,
+    const file_estimator &estimate, failure_limit *fail_fast,
+    schedule_mode schedule, const test_estimator &estimate_test
   ) {
     using namespace platform;
     logger.started_run();
 
+#ifndef _WIN32
+    if(jobs > 1) {
+      if(schedule == schedule_mode::test) {
+        suite_joiner joiner(logger);
+        run_parallel(commands, schedule_tests(commands, args, jobs, estimate,
+                                              estimate_test, fail_fast),
+                     joiner, jobs, fail_fast);
+      } else {
+        run_parallel(commands, schedule_files(commands, args, estimate,
+                                              fail_fast),
+                     logger, jobs, fail_fast);
+      }
+      logger.ended_run();
+      return;
+    }
+#endif
+
     detail::file_uid_maker uid;
     for(const auto &command : commands) {
       test_file file = {command, uid.make_file_uid()};
       logger.started_file(file);
 
-      std::vector<std::string> final_args = command.args();
-      final_args.insert(final_args.end(), args.begin(), args.end());
-      auto result = run_test_file(std::move(final_args),
-                                  log::pipe(logger, file.id));
+      if(fail_fast && fail_fast->reached()) {
+        logger.failed_file(file, fail_fast->cancelled_message());
+        continue;
+      }
+
+      auto result = run_test_file(make_args(command, args, fail_fast),
+                                  log::pipe(logger, file.id, fail_fast));
 
-      if(result.passed)
+      if(result.passed) {
         logger.ended_file(file);
-      else
+      } else {
         logger.failed_file(file, result.message);
+        if(fail_fast)
+          fail_fast->add_failure();
+      }
     }
 
     logger.ended_run();
@@ -1,9 +1,13 @@
 #ifndef INC_METTLE_SRC_METTLE_RUN_TEST_FILES_HPP
 #define INC_METTLE_SRC_METTLE_RUN_TEST_FILES_HPP
 
+#include <cstdint>
+#include <functional>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include <mettle/driver/run_tests.hpp>
 #include <mettle/driver/log/core.hpp>
 
 #include "test_command.hpp"
@@ -15,9 +19,31 @@ namespace mettle {
     std::string message;
   };
 
+  // Estimates how long a test file will take to run, so that parallel runs
+  // can start the slowest files first.
+  using file_estimator = std::function<
+    std::optional<log::test_duration>(const test_command &)
+  >;
+
+  // How to divide the work between jobs when running test files in parallel:
+  // `file` runs each file in its own process, while `test` lists the tests in
+  // every file and splits them into smaller pieces (each run by a separate
+  // process of its file), so that one large file doesn't hold up the run.
+  enum class schedule_mode {
+    file,
+    test
+  };
+
+  // If `fail_fast` is set, each file is told how many more failures it can
+  // have. Once the limit is reached, any running files are interrupted and
+  // the rest are reported as failed without being run.
   void run_test_files(
     const std::vector<test_command> &commands, log::file_logger &logger,
-    const std::vector<std::string> &args = {}
+    const std::vector<std::string> &args = {}, std::size_t jobs = 1,
+    const file_estimator &estimate = nullptr,
+    failure_limit *fail_fast = nullptr,
+    schedule_mode schedule = schedule_mode::file,
+    const test_estimator &estimate_test = nullptr
   );
 
 } // namespace mettle
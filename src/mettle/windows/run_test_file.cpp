@@ -17,6 +17,7 @@
 #endif
 
 #include <mettle/detail/source_location.hpp>
+#include <mettle/driver/log/child.hpp>
 #include <mettle/driver/windows/scoped_pipe.hpp>
 
 #include "../log_pipe.hpp"
@@ -114,13 +115,24 @@ namespace mettle::windows {
     args.insert(args.end(), { "--output-fd", ss.str() });
     std::basic_string<TCHAR> command = make_command(args);
 
+    // Tell the test file which protocol we can read through its environment
+    // (see `log::protocol_env`). Files are run one at a time, so we can just
+    // set the variable in our own environment until the child has started.
+    SetEnvironmentVariableA(log::protocol_env, "binary");
+    SetEnvironmentVariableA(log::buffer_env, "65536");
+
     STARTUPINFO startup_info = { sizeof(STARTUPINFO) };
     PROCESS_INFORMATION proc_info;
 
-    if(!CreateProcess(
-         nullptr, const_cast<PTCHAR>(command.c_str()), nullptr,
-         nullptr, true, 0, nullptr, nullptr, &startup_info, &proc_info
-       )) {
+    bool created = CreateProcess(
+      nullptr, const_cast<PTCHAR>(command.c_str()), nullptr,
+      nullptr, true, 0, nullptr, nullptr, &startup_info, &proc_info
+    );
+    DWORD err = GetLastError();
+    SetEnvironmentVariableA(log::protocol_env, nullptr);
+    SetEnvironmentVariableA(log::buffer_env, nullptr);
+    if(!created) {
+      SetLastError(err);
       return METTLE_FAILED();
     }
     scoped_handle subproc_handles[] = {proc_info.hProcess, proc_info.hThread};
@@ -1,45 +1,47 @@
 #include <mettle.hpp>
 using namespace mettle;
 
+#include <thread>
+
 #include "../../helpers.hpp"
 #include "../../../src/mettle/log_pipe.hpp"
 #include <mettle/driver/log/child.hpp>
 
 struct recording_logger : log::file_logger {
   void started_run() override {
-    called = "started_run";
+    call("started_run");
   }
   void ended_run() override {
-    called = "ended_run";
+    call("ended_run");
   }
 
   void started_file(const test_file &) override {
-    called = "started_file";
+    call("started_file");
   }
   void ended_file(const test_file &) override {
-    called = "ended_file";
+    call("ended_file");
   }
   void failed_file(const test_file &, const std::string &) override {
-    called = "failed_file";
+    call("failed_file");
   }
 
   void started_suite(const std::vector<std::string> &actual_suites) override {
-    called = "started_suite";
+    call("started_suite");
     suites = actual_suites;
   }
   void ended_suite(const std::vector<std::string> &actual_suites) override {
-    called = "ended_suite";
+    call("ended_suite");
     suites = actual_suites;
   }
 
   void started_test(const test_name &actual_test) override {
-    called = "started_test";
+    call("started_test");
     test = actual_test;
   }
   void passed_test(const test_name &actual_test,
                    const log::test_output &actual_output,
                    log::test_duration actual_duration) override {
-    called = "passed_test";
+    call("passed_test");
     test = actual_test;
     output = actual_output;
     duration = actual_duration;
@@ -48,7 +50,7 @@ struct recording_logger : log::file_logger {
                    const std::string &actual_message,
                    const log::test_output &actual_output,
                    log::test_duration actual_duration) override {
-    called = "failed_test";
+    call("failed_test");
     test = actual_test;
     message = actual_message;
     output = actual_output;
@@ -56,17 +58,31 @@ struct recording_logger : log::file_logger {
   }
   void skipped_test(const test_name &actual_test,
                     const std::string &actual_message) override {
-    called = "skipped_test";
+    call("skipped_test");
     test = actual_test;
     message = actual_message;
   }
+  void test_output_chunk(const test_name &actual_test,
+                         log::output_stream stream,
+                         std::string_view data) override {
+    call("test_output_chunk");
+    test = actual_test;
+    chunks.emplace_back(stream, data);
+  }
+
+  void call(const std::string &event) {
+    called = event;
+    calls.push_back(event);
+  }
 
   std::string called;
+  std::vector<std::string> calls;
   std::vector<std::string> suites;
   test_name test;
   std::string message;
   log::test_output output;
   log::test_duration duration;
+  std::vector<std::pair<log::output_stream, std::string>> chunks;
 };
 
 auto equal_test_name(const test_name &expected) {
@@ -82,67 +98,78 @@ auto equal_test_name(const test_name &expected) {
   );
 }
 
+template<typename Child>
 struct fixture {
+  using child_type = Child;
+
   fixture() : pipe(parent, test_uid(1) << 32), child(stream) {}
 
+  void read() {
+    while(stream.peek() != EOF)
+      pipe(stream);
+    stream.clear();
+  }
+
   recording_logger parent;
   std::stringstream stream;
   log::pipe pipe;
-  log::child child;
+  Child child;
 };
 
-suite<fixture> test_child("child/pipe loggers", [](auto &_) {
+suite<fixture<log::child>, fixture<log::binary_child>>
+test_child("child/pipe loggers", [](auto &_) {
+  using Fixture = fixture_type_t<decltype(_)>;
 
-  _.test("started_run()", [](fixture &f) {
+  _.test("started_run()", [](Fixture &f) {
     f.child.started_run();
-    f.pipe(f.stream);
+    f.read();
 
     // Shouldn't be called, since we ignore started_run and ended_run.
     expect(f.parent.called, equal_to(""));
   });
 
-  _.test("ended_run()", [](fixture &f) {
+  _.test("ended_run()", [](Fixture &f) {
     f.child.ended_run();
-    f.pipe(f.stream);
+    f.read();
 
     // Shouldn't be called, since we ignore started_run and ended_run.
     expect(f.parent.called, equal_to(""));
   });
 
-  _.test("started_suite()", [](fixture &f) {
+  _.test("started_suite()", [](Fixture &f) {
     std::vector<std::string> suites = {"suite", "subsuite"};
     f.child.started_suite(suites);
-    f.pipe(f.stream);
+    f.read();
 
     expect(f.parent.called, equal_to("started_suite"));
     expect(f.parent.suites, equal_to(suites));
   });
 
-  _.test("ended_suite()", [](fixture &f) {
+  _.test("ended_suite()", [](Fixture &f) {
     std::vector<std::string> suites = {"suite", "subsuite"};
     f.child.ended_suite(suites);
-    f.pipe(f.stream);
+    f.read();
 
     expect(f.parent.called, equal_to("ended_suite"));
     expect(f.parent.suites, equal_to(suites));
   });
 
-  _.test("started_test()", [](fixture &f) {
+  _.test("started_test()", [](Fixture &f) {
     test_name test = {{"suite", "subsuite"}, "test", 1};
     f.child.started_test(test);
-    f.pipe(f.stream);
+    f.read();
 
     expect(f.parent.called, equal_to("started_test"));
     expect(f.parent.test, equal_test_name(test));
   });
 
-  _.test("passed_test()", [](fixture &f) {
+  _.test("passed_test()", [](Fixture &f) {
     test_name test = {{"suite", "subsuite"}, "test", 1};
     log::test_output output = {"stdout", "stderr"};
     log::test_duration duration(1000);
 
     f.child.passed_test(test, output, duration);
-    f.pipe(f.stream);
+    f.read();
 
     expect(f.parent.called, equal_to("passed_test"));
     expect(f.parent.test, equal_test_name(test));
@@ -151,14 +178,47 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.duration, equal_to(duration));
   });
 
-  _.test("failed_test()", [](fixture &f) {
+  _.test("passed_test() with elided output", [](Fixture &f) {
+    test_name test = {{"suite", "subsuite"}, "test", 1};
+    log::test_output output = {"stdout", "stderr", 100, 200};
+
+    f.child.passed_test(test, output, log::test_duration(1000));
+    f.read();
+
+    expect(f.parent.output.stdout_log, equal_to(output.stdout_log));
+    expect(f.parent.output.stderr_log, equal_to(output.stderr_log));
+    expect(f.parent.output.stdout_elided, equal_to(100u));
+    expect(f.parent.output.stderr_elided, equal_to(200u));
+  });
+
+  _.test("passed_test() with resource usage", [](Fixture &f) {
+    using namespace std::literals::chrono_literals;
+    test_name test = {{"suite", "subsuite"}, "test", 1};
+    log::test_output output = {"stdout", "stderr"};
+    output.resources = log::test_resources{1500us, 250us, 4096, 1, 2, 3, 4};
+
+    f.child.passed_test(test, output, log::test_duration(1000));
+    f.read();
+
+    expect(f.parent.output.resources.has_value(), equal_to(true));
+    auto &r = *f.parent.output.resources;
+    expect(r.user_time, equal_to(1500us));
+    expect(r.system_time, equal_to(250us));
+    expect(r.max_rss, equal_to(4096u));
+    expect(r.minor_faults, equal_to(1u));
+    expect(r.major_faults, equal_to(2u));
+    expect(r.voluntary_switches, equal_to(3u));
+    expect(r.involuntary_switches, equal_to(4u));
+  });
+
+  _.test("failed_test()", [](Fixture &f) {
     test_name test = {{"suite", "subsuite"}, "test", 1};
     std::string message = "failure";
     log::test_output output = {"stdout", "stderr"};
     log::test_duration duration(1000);
 
     f.child.failed_test(test, message, output, duration);
-    f.pipe(f.stream);
+    f.read();
 
     expect(f.parent.called, equal_to("failed_test"));
     expect(f.parent.test, equal_test_name(test));
@@ -168,15 +228,192 @@ suite<fixture> test_child("child/pipe loggers", [](auto &_) {
     expect(f.parent.duration, equal_to(duration));
   });
 
-  _.test("skipped_test()", [](fixture &f) {
+  _.test("test_output_chunk()", [](Fixture &f) {
+    test_name test = {{"suite", "subsuite"}, "test", 1};
+    f.child.test_output_chunk(test, log::output_stream::stdout_log, "out");
+    f.child.test_output_chunk(test, log::output_stream::stderr_log, "err");
+    f.read();
+
+    expect(f.parent.calls, array("test_output_chunk", "test_output_chunk"));
+    expect(f.parent.test, equal_test_name(test));
+    expect(f.parent.chunks[0].first,
+           equal_to(log::output_stream::stdout_log));
+    expect(f.parent.chunks[0].second, equal_to("out"));
+    expect(f.parent.chunks[1].first,
+           equal_to(log::output_stream::stderr_log));
+    expect(f.parent.chunks[1].second, equal_to("err"));
+  });
+
+  _.test("skipped_test()", [](Fixture &f) {
     test_name test = {{"suite", "subsuite"}, "test", 1};
     std::string message = "message";
     f.child.skipped_test(test, message);
-    f.pipe(f.stream);
+    f.read();
 
     expect(f.parent.called, equal_to("skipped_test"));
     expect(f.parent.message, equal_to(message));
     expect(f.parent.test, equal_test_name(test));
   });
 
+  _.test("event_size()", [](Fixture &f) {
+    test_name test = {{"suite", "subsuite"}, "test", 1};
+    log::test_output output = {"stdout", "stderr"};
+
+    // Send the test once first so that the next events stand on their own.
+    f.child.started_test(test);
+    f.stream.str("");
+    f.child.passed_test(test, output, log::test_duration(1000));
+    f.child.ended_run();
+
+    std::string data = f.stream.str();
+    auto size = log::pipe::event_size(data);
+    expect(size, greater(0u));
+    expect(size, less(data.size()));
+    expect(log::pipe::event_size(std::string_view(data).substr(size)),
+           equal_to(data.size() - size));
+
+    for(std::size_t i = 0; i != size; i++)
+      expect(log::pipe::event_size(data.substr(0, i)), equal_to(0u));
+  });
+
+  _.test("repeated suites and files", [](Fixture &f) {
+    test_name test1 = {{"suite", "subsuite"}, "test 1", 1, "file.cpp", 1};
+    test_name test2 = {test1.suites, "test 2", 2, "file.cpp", 2};
+    test_name test3 = {{"suite"}, "test 3", 3, "other.cpp", 3};
+
+    f.child.started_test(test1);
+    auto first = f.stream.str().size();
+    f.read();
+    expect(f.parent.test, equal_test_name(test1));
+
+    // The binary protocol only sends each suite path and file once.
+    f.child.started_test(test1);
+    if constexpr(std::is_same_v<typename Fixture::child_type,
+                                log::binary_child>)
+      expect(f.stream.str().size() - first, less(first));
+
+    for(const auto &test : {test2, test3, test1}) {
+      f.child.started_test(test);
+      f.read();
+      expect(f.parent.test, equal_test_name(test));
+      expect(f.parent.test.file, equal_to(test.file));
+      expect(f.parent.test.line, equal_to(test.line));
+    }
+  });
+
+  _.test("is_failure()", [](Fixture &f) {
+    test_name test = {{"suite", "subsuite"}, "test", 1};
+    f.child.passed_test(test, {}, log::test_duration(1000));
+    auto passed = f.stream.str();
+    f.stream.str("");
+    f.child.failed_test(test, "failure", {}, log::test_duration(1000));
+    auto failed = f.stream.str();
+
+    expect(log::pipe::is_failure(passed), equal_to(false));
+    expect(log::pipe::is_failure(failed), equal_to(true));
+  });
+
+  subsuite<>(_, "buffering", [](auto &_) {
+    using Child = typename Fixture::child_type;
+    using namespace std::literals::chrono_literals;
+
+    _.test("send when starting a test", [](Fixture &f) {
+      test_name test = {{"suite", "subsuite"}, "test", 1};
+      Child child(f.stream, {1024, 1h});
+      child.started_suite({"suite"});
+      child.passed_test(test, {}, log::test_duration(1000));
+      expect(f.stream.str(), equal_to(""));
+
+      child.started_test(test);
+      f.read();
+      expect(f.parent.calls, array("started_suite", "passed_test",
+                                   "started_test"));
+    });
+
+    _.test("send output chunks right away", [](Fixture &f) {
+      test_name test = {{"suite", "subsuite"}, "test", 1};
+      Child child(f.stream, {1024, 1h});
+      child.started_test(test);
+      f.read();
+
+      child.test_output_chunk(test, log::output_stream::stdout_log, "out");
+      f.read();
+      expect(f.parent.calls, array("started_test", "test_output_chunk"));
+    });
+
+    _.test("send when ending the run", [](Fixture &f) {
+      Child child(f.stream, {1024, 1h});
+      child.started_suite({"suite"});
+      expect(f.stream.str(), equal_to(""));
+
+      child.ended_run();
+      expect(f.stream.str(), not_equal_to(""));
+    });
+
+    _.test("send when full", [](Fixture &f) {
+      Child child(f.stream, {64, 1h});
+      child.started_suite({"suite"});
+      expect(f.stream.str(), equal_to(""));
+
+      child.ended_suite({std::string(64, 'x')});
+      f.read();
+      expect(f.parent.calls, array("started_suite", "ended_suite"));
+    });
+
+    _.test("send after a delay", [](Fixture &f) {
+      Child child(f.stream, {1024, 10ms});
+      child.started_suite({"suite"});
+      expect(f.stream.str(), equal_to(""));
+
+      std::this_thread::sleep_for(20ms);
+      child.ended_suite({"suite"});
+      f.read();
+      expect(f.parent.calls, array("started_suite", "ended_suite"));
+    });
+
+    _.test("send when destroyed", [](Fixture &f) {
+      {
+        Child child(f.stream, {1024, 1h});
+        child.started_suite({"suite"});
+        expect(f.stream.str(), equal_to(""));
+      }
+
+      f.read();
+      expect(f.parent.called, equal_to("started_suite"));
+    });
+  });
+
+  _.test("truncated event", [](Fixture &f) {
+    test_name test = {{"suite", "subsuite"}, "test", 1};
+    f.child.started_test(test);
+    f.stream.str("");
+    f.child.started_test(test);
+
+    std::string data = f.stream.str();
+    std::istringstream truncated(data.substr(0, data.size() - 1));
+    expect([&f, &truncated]() { f.pipe(truncated); }, thrown<std::exception>());
+  });
+
+});
+
+suite<> test_mixed_protocols("mixed child protocols", [](auto &_) {
+
+  _.test("read bencode and binary events", []() {
+    recording_logger parent;
+    log::pipe pipe(parent, test_uid(1) << 32);
+    std::stringstream stream;
+    log::child bencode_child(stream);
+    log::binary_child binary_child(stream);
+
+    test_name test = {{"suite"}, "test", 1};
+    bencode_child.started_test(test);
+    binary_child.skipped_test(test, "message");
+
+    while(stream.peek() != EOF)
+      pipe(stream);
+    expect(parent.calls, array("started_test", "skipped_test"));
+    expect(parent.message, equal_to("message"));
+    expect(parent.test, equal_test_name(test));
+  });
+
 });
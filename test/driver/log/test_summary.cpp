@@ -321,6 +321,28 @@ suite<> test_summary("summary logger", [](auto &_) {
         "    standard error\n"
       ));
     });
+
+    _.test("elided output", [](logger_factory &f) {
+      using namespace std::literals::chrono_literals;
+      test_name test = {{"suite"}, "test", 1};
+      f.logger.started_run();
+      f.logger.started_suite({"suite"});
+      f.logger.started_test(test);
+      f.logger.failed_test(test, "error", {"head\ntail", "", 1000, 0}, 100ms);
+      f.logger.ended_suite({"suite"});
+      f.logger.ended_run();
+      f.logger.summarize();
+      expect(f.ss.str(), equal_to(
+        "0/1 tests passed\n"
+        "  suite > test FAILED\n"
+        "    error\n"
+        "\n"
+        "    stdout:\n"
+        "    head\n"
+        "    [... 1000 bytes elided ...]\n"
+        "    tail\n"
+      ));
+    });
   });
 
 });
@@ -269,6 +269,13 @@ suite<> test_verbose("verbose logger", [](auto &_) {
       expect(f.ss.str(), equal_to("FAILED (100 ms)\n  error\n"));
     });
 
+    _.test("passed_test() with resource usage", [](logger_factory &f) {
+      log::test_output output;
+      output.resources = log::test_resources{60ms, 15ms, 2 * 1024 * 1024};
+      f.logger.passed_test({{"suite"}, "test", 1}, output, 100ms);
+      expect(f.ss.str(), equal_to("PASSED (100 ms, 75 ms cpu, 2048 KiB rss)\n"));
+    });
+
     _.test("passing run", [](logger_factory &f) {
       passing_run(f.logger);
       expect(f.ss.str(), equal_to(
@@ -367,6 +374,29 @@ suite<> test_verbose("verbose logger", [](auto &_) {
       ));
     });
 
+    _.test("streamed output", [](logger_factory &f) {
+      test_name test = {{"suite"}, "test", 1};
+      f.logger.started_test(test);
+      f.logger.test_output_chunk(test, log::output_stream::stdout_log,
+                                 "foo\n");
+      f.logger.test_output_chunk(test, log::output_stream::stderr_log, "bar");
+      expect(f.ss.str(), equal_to("test \n  foo\n  bar"));
+
+      f.logger.passed_test(test, {"foo\n", "bar"}, 0ms);
+      expect(f.ss.str(), equal_to("test \n  foo\n  bar\ntest PASSED\n"));
+    });
+
+    _.test("streamed output from another test", [](logger_factory &f) {
+      test_name test = {{"suite"}, "test", 1};
+      test_name other = {{"suite"}, "other", 2};
+      f.logger.started_test(test);
+      f.logger.test_output_chunk(other, log::output_stream::stdout_log, "foo");
+      expect(f.ss.str(), equal_to("test "));
+
+      f.logger.failed_test(test, "error", {}, 0ms);
+      expect(f.ss.str(), equal_to("test FAILED\n  error\n"));
+    });
+
     _.test("passing run", [](logger_factory &f) {
       passing_run(f.logger);
       expect(f.ss.str(), equal_to(
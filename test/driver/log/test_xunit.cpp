@@ -155,6 +155,55 @@ suite<> test_verbose("xunit logger", [](auto &_) {
     });
   });
 
+  _.test("elided output", []() {
+    using namespace std::literals::chrono_literals;
+    auto ss = new std::ostringstream();
+    log::xunit logger(std::unique_ptr<std::ostream>(ss), 1);
+
+    test_name test = {{"suite"}, "test", 1, "file.cpp", 10};
+    logger.started_run();
+    logger.started_suite({"suite"});
+    logger.started_test(test);
+    logger.passed_test(test, {"headtail", "", 1000, 0}, 100ms);
+    logger.ended_suite({"suite"});
+    logger.ended_run();
+    expect(ss->str(), regex_search(
+      "<system-out>\n"
+      "        head\n"
+      "        \\[\\.\\.\\. 1000 bytes elided \\.\\.\\.\\]\n"
+      "        tail\n"
+      "      </system-out>"
+    ));
+  });
+
+  _.test("resource usage", []() {
+    using namespace std::literals::chrono_literals;
+    auto ss = new std::ostringstream();
+    log::xunit logger(std::unique_ptr<std::ostream>(ss), 1);
+
+    test_name test = {{"suite"}, "test", 1, "file.cpp", 10};
+    log::test_output output;
+    output.resources = log::test_resources{1500ms, 250ms, 4096, 1, 2, 3, 4};
+    logger.started_run();
+    logger.started_suite({"suite"});
+    logger.started_test(test);
+    logger.passed_test(test, output, 100ms);
+    logger.ended_suite({"suite"});
+    logger.ended_run();
+    expect(ss->str(), regex_search(
+      "<properties>\n"
+      "        <property name=\"user_time\" value=\"1\\.50*\"/>\n"
+      "        <property name=\"system_time\" value=\"0\\.250*\"/>\n"
+      "        <property name=\"max_rss\" value=\"4096\"/>\n"
+      "        <property name=\"minor_faults\" value=\"1\"/>\n"
+      "        <property name=\"major_faults\" value=\"2\"/>\n"
+      "        <property name=\"voluntary_context_switches\" value=\"3\"/>\n"
+      "        <property name=\"involuntary_context_switches\" "
+      "value=\"4\"/>\n"
+      "      </properties>"
+    ));
+  });
+
   _.test("multiple runs", []() {
     expect([]() { log::xunit("file.xml", 2); }, thrown<std::domain_error>(
       "xunit logger may only be used with --runs=1"
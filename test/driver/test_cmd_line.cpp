@@ -9,11 +9,11 @@ namespace opts = boost::program_options;
 
 auto match_filter_item(attr_instance attr, bool matched) {
   std::ostringstream ss;
-  ss << "filter_item(" << to_printable(attr.attribute.name()) << ") => "
+  ss << "filter_item(" << to_printable(attr.attribute().name()) << ") => "
      << to_printable(matched);
   return basic_matcher(
     [attr = std::move(attr), matched](const attr_filter_item &actual) {
-      return actual.attribute == attr.attribute.name() &&
+      return actual.attribute == attr.attribute().name() &&
              actual.func(&attr) == matched;
     }, ss.str()
   );
@@ -218,6 +218,44 @@ suite<> test_program_options("program_options utilities", [](auto &_) {
     });
   });
 
+  subsuite<>(_, "parse_fail_fast()", [](auto &_) {
+    auto parse = [](std::vector<std::string> args) {
+      std::optional<std::size_t> fail_fast;
+      std::vector<std::string> files;
+      opts::options_description desc;
+      desc.add_options()
+        ("fail-fast", opts::value(&fail_fast)
+                        ->implicit_value(std::size_t(1), "1"), "")
+        ("file", opts::value(&files), "")
+      ;
+      opts::positional_options_description pos;
+      pos.add("file", -1);
+
+      opts::variables_map vm;
+      opts::store(opts::command_line_parser(args).options(desc).positional(pos)
+                    .extra_parser(parse_fail_fast).run(), vm);
+      opts::notify(vm);
+      return std::make_pair(fail_fast, files);
+    };
+
+    _.test("bare option", [parse]() {
+      auto [fail_fast, files] = parse({"--fail-fast", "file"});
+      expect(fail_fast, equal_to(std::optional<std::size_t>(1)));
+      expect(files, array("file"));
+    });
+
+    _.test("option with value", [parse]() {
+      auto [fail_fast, files] = parse({"--fail-fast=3", "file"});
+      expect(fail_fast, equal_to(std::optional<std::size_t>(3)));
+      expect(files, array("file"));
+    });
+
+    _.test("other arguments", []() {
+      expect(parse_fail_fast("--fail-fast-ish").first, equal_to(""));
+      expect(parse_fail_fast("file").first, equal_to(""));
+    });
+  });
+
   subsuite<>(_, "validate()", [](auto &_) {
     _.test("color_option", []() {
       using namespace boost::program_options;
@@ -252,6 +290,141 @@ suite<> test_program_options("program_options utilities", [](auto &_) {
       );
     });
 
+    _.test("report_order", []() {
+      using namespace boost::program_options;
+      {
+        boost::any value;
+        std::vector<std::string> input{"suite"};
+        validate(value, input, static_cast<report_order*>(nullptr), 0);
+        expect(value, any_equal(report_order::suite));
+      }
+
+      {
+        boost::any value;
+        std::vector<std::string> input{"completion"};
+        validate(value, input, static_cast<report_order*>(nullptr), 0);
+        expect(value, any_equal(report_order::completion));
+      }
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"invalid"};
+          validate(value, input, static_cast<report_order*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('invalid') for option is invalid")
+      );
+    });
+
+    _.test("output_capture", []() {
+      using namespace boost::program_options;
+      {
+        boost::any value;
+        std::vector<std::string> input{"pipe"};
+        validate(value, input, static_cast<output_capture*>(nullptr), 0);
+        expect(value, any_equal(output_capture::pipe));
+      }
+
+      {
+        boost::any value;
+        std::vector<std::string> input{"file"};
+        validate(value, input, static_cast<output_capture*>(nullptr), 0);
+        expect(value, any_equal(output_capture::file));
+      }
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"invalid"};
+          validate(value, input, static_cast<output_capture*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('invalid') for option is invalid")
+      );
+    });
+
+    _.test("list_format", []() {
+      using namespace boost::program_options;
+      {
+        boost::any value;
+        std::vector<std::string> input{"text"};
+        validate(value, input, static_cast<list_format*>(nullptr), 0);
+        expect(value, any_equal(list_format::text));
+      }
+
+      {
+        boost::any value;
+        std::vector<std::string> input{"json"};
+        validate(value, input, static_cast<list_format*>(nullptr), 0);
+        expect(value, any_equal(list_format::json));
+      }
+
+      {
+        boost::any value;
+        std::vector<std::string> input{"binary"};
+        validate(value, input, static_cast<list_format*>(nullptr), 0);
+        expect(value, any_equal(list_format::binary));
+      }
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"invalid"};
+          validate(value, input, static_cast<list_format*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('invalid') for option is invalid")
+      );
+    });
+
+    _.test("test_id_range", []() {
+      using namespace boost::program_options;
+      auto parse = [](std::string arg) {
+        boost::any value;
+        std::vector<std::string> input{std::move(arg)};
+        validate(value, input, static_cast<test_id_range*>(nullptr), 0);
+        auto range = boost::any_cast<test_id_range>(value);
+        return std::make_pair(range.first, range.last);
+      };
+
+      expect(parse("5"), equal_to(std::pair<test_uid, test_uid>(5, 5)));
+      expect(parse("5-8"), equal_to(std::pair<test_uid, test_uid>(5, 8)));
+
+      for(std::string bad : {"x", "5-", "-8", "8-5", "5-8-9"}) {
+        expect(
+          [&parse, bad]() { parse(bad); },
+          thrown<std::exception>(
+            "the argument ('" + bad + "') for option is invalid"
+          )
+        );
+      }
+    });
+
+    _.test("child_protocol", []() {
+      using namespace boost::program_options;
+      using log::child_protocol;
+      {
+        boost::any value;
+        std::vector<std::string> input{"bencode"};
+        validate(value, input, static_cast<child_protocol*>(nullptr), 0);
+        expect(value, any_equal(child_protocol::bencode));
+      }
+
+      {
+        boost::any value;
+        std::vector<std::string> input{"binary"};
+        validate(value, input, static_cast<child_protocol*>(nullptr), 0);
+        expect(value, any_equal(child_protocol::binary));
+      }
+
+      expect(
+        []() {
+          boost::any value;
+          std::vector<std::string> input{"invalid"};
+          validate(value, input, static_cast<child_protocol*>(nullptr), 0);
+        },
+        thrown<std::exception>("the argument ('invalid') for option is invalid")
+      );
+    });
+
     _.test("attr_filter_set", []() {
       using namespace boost::program_options;
 
@@ -2,6 +2,7 @@
 using namespace mettle;
 
 #include <mettle/driver/filters.hpp>
+#include <mettle/driver/test_index.hpp>
 #include "../helpers.hpp"
 
 suite<> test_core_filters("core filters", [](auto &_) {
@@ -54,6 +55,47 @@ suite<> test_core_filters("core filters", [](auto &_) {
       );
     });
   });
+
+  subsuite<>(_, "id_filter", [](auto &_) {
+    _.test("listed test", []() {
+      id_filter filter(default_filter{}, {1, 2});
+      expect(
+        filter({{"suite"}, "test", 1}, {}),
+        equal_filter_result({test_action::indeterminate, ""})
+      );
+    });
+
+    _.test("unlisted test", []() {
+      id_filter filter(default_filter{}, {1, 2});
+      expect(
+        filter({{"suite"}, "test", 3}, {}),
+        equal_filter_result({test_action::hide, ""})
+      );
+    });
+
+    _.test("hides_suite()", []() {
+      auto s = make_suites<>("suite", [](auto &_){
+        _.test("test", []() {});
+        subsuite<>(_, "subsuite", [](auto &_) {
+          _.test("test", []() {});
+        });
+      });
+      auto index = make_test_index(s);
+      auto id = [&index](std::size_t i) { return index.tests()[i].name.id; };
+
+      id_filter sub_filter(default_filter{}, {id(1)}, index);
+      expect(index.hides_suite(sub_filter, 0), equal_to(false));
+      expect(index.hides_suite(sub_filter, 1), equal_to(false));
+
+      id_filter parent_filter(default_filter{}, {id(0)}, index);
+      expect(index.hides_suite(parent_filter, 0), equal_to(false));
+      expect(index.hides_suite(parent_filter, 1), equal_to(true));
+
+      // Without an index, we can't tell which suites the tests are in.
+      id_filter no_index(default_filter{}, {id(0)});
+      expect(index.hides_suite(no_index, 1), equal_to(false));
+    });
+  });
 });
 
 suite<> test_name_filters("name filters", [](auto &_) {
@@ -110,6 +152,60 @@ suite<> test_name_filters("name filters", [](auto &_) {
       equal_filter_result({test_action::run, ""})
     );
   });
+
+  _.test("prebuilt full name", []() {
+    test_name name = {{"suite", "subsuite"}, "test", 1};
+    expect(
+      name_filter_set{std::regex("^suite > subsuite > test$")}(
+        name, "suite > subsuite > test", {}
+      ),
+      equal_filter_result({test_action::run, ""})
+    );
+    expect(
+      name_filter_set{std::regex("other")}(name, "other > test", {}),
+      equal_filter_result({test_action::run, ""})
+    );
+    expect(
+      name_filter_set{std::regex("subsuite")}(name, "other > test", {}),
+      equal_filter_result({test_action::hide, ""})
+    );
+  });
+
+  _.test("hides_suite()", []() {
+    auto filters = [](std::initializer_list<std::string> patterns) {
+      name_filter_set result;
+      for(const auto &i : patterns)
+        result.insert(i);
+      return result;
+    };
+
+    expect(name_filter_set{}.hides_suite("suite > ", {}), equal_to(false));
+    expect(filters({"^other"}).hides_suite("suite > ", {}), equal_to(true));
+    expect(filters({"^suite > sub"}).hides_suite("suite > ", {}),
+           equal_to(false));
+    expect(filters({"^suite"}).hides_suite("suite > subsuite > ", {}),
+           equal_to(false));
+    expect(filters({"^other", "^suite"}).hides_suite("suite > ", {}),
+           equal_to(false));
+    expect(filters({R"(^a\(int\) > )"}).hides_suite("a (float) > ", {}),
+           equal_to(true));
+    expect(filters({"^others?"}).hides_suite("other > ", {}),
+           equal_to(false));
+
+    // Patterns without a literal prefix could match anything.
+    expect(filters({"other"}).hides_suite("suite > ", {}), equal_to(false));
+    expect(filters({"^.ther"}).hides_suite("suite > ", {}), equal_to(false));
+    expect(filters({R"(^\w)"}).hides_suite("suite > ", {}), equal_to(false));
+    expect(filters({"^other|suite"}).hides_suite("suite > ", {}),
+           equal_to(false));
+    expect(name_filter_set{std::regex("^other")}.hides_suite("suite > ", {}),
+           equal_to(false));
+
+    expect(
+      filters({"^suite > "})({{"suite", "subsuite"}, "test", 1}, {}),
+      equal_filter_result({test_action::run, ""})
+    );
+  });
 });
 
 struct attr_filter_fixture {
@@ -588,6 +684,28 @@ suite<> test_attr_filters("attribute filters", [](auto &_) {
         equal_filter_result({test_action::run, ""})
       );
     });
+
+    _.test("hides_suite()", []() {
+      bool_attr attr1("first");
+      attributes attrs = {attr1};
+
+      expect(attr_filter_set{}.hides_suite("", attrs), equal_to(false));
+      expect(attr_filter_set{ {!has_attr("first")} }.hides_suite("", attrs),
+             equal_to(true));
+      expect(attr_filter_set{ {!has_attr("first")} }.hides_suite("", {}),
+             equal_to(false));
+      expect(attr_filter_set{ {has_attr("first")} }.hides_suite("", attrs),
+             equal_to(false));
+      expect(attr_filter_set{
+        {!has_attr("first", "value")}
+      }.hides_suite("", {attr1("value")}), equal_to(false));
+      expect(attr_filter_set{
+        {!has_attr("first")}, {has_attr("second")}
+      }.hides_suite("", attrs), equal_to(false));
+      expect(attr_filter_set{
+        {!has_attr("first")}, {has_attr("second"), !has_attr("first")}
+      }.hides_suite("", attrs), equal_to(true));
+    });
   });
 });
 
@@ -690,4 +808,19 @@ suite<> test_combined_filters("combined filters", [](auto &_) {
       equal_filter_result({test_action::run, ""})
     );
   });
+
+  _.test("hides_suite()", []() {
+    bool_attr attr1("first");
+
+    filter_set by_name;
+    by_name.by_name.insert(std::string("^suite > "));
+    expect(by_name.hides_suite("other > ", {}), equal_to(true));
+    expect(by_name.hides_suite("suite > ", {}), equal_to(false));
+
+    filter_set by_attr = { {}, {{!has_attr("first")}} };
+    expect(by_attr.hides_suite("suite > ", {attr1}), equal_to(true));
+    expect(by_attr.hides_suite("suite > ", {}), equal_to(false));
+
+    expect(filter_set{}.hides_suite("suite > ", {attr1}), equal_to(false));
+  });
 });
@@ -0,0 +1,214 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <sstream>
+
+#include <mettle/driver/filters.hpp>
+#include <mettle/driver/list_tests.hpp>
+#include <mettle/driver/log/frame.hpp>
+
+bool_attr slow("slow");
+bool_attr hide("hide");
+list_attr tags("tags");
+
+filter_result hide_filter(const test_name &, const attributes &attrs) {
+  return attrs.find("hide") != attrs.end() ? test_action::hide :
+    test_action::indeterminate;
+}
+
+auto make_inner() {
+  return make_suites<>("inner", [](auto &_){
+    _.test("test 1", []() {});
+    _.test("test 2", {slow, tags("a", "b")}, []() {});
+    _.test("test 3", {skip("broken")}, []() {});
+    _.test("test 4", {hide}, []() {});
+
+    subsuite<>(_, "subsuite", [](auto &_) {
+      _.test("\"quoted\"\n", []() {});
+    });
+  });
+}
+
+suite<> test_list_tests("list_tests()", [](auto &_) {
+
+  _.test("lists tests", []() {
+    auto s = make_inner();
+    auto tests = list_tests(s, hide_filter);
+
+    expect(tests.size(), equal_to(4u));
+    expect(tests[0].name.full_name(), equal_to("inner > test 1"));
+    expect(tests[0].name.id, equal_to(s[0].tests()[0].id));
+    expect(tests[0].name.file, equal_to(s[0].tests()[0].loc.file_name()));
+    expect(tests[0].name.line, equal_to(s[0].tests()[0].loc.line()));
+    expect(tests[0].skipped, equal_to(false));
+
+    expect(tests[1].name.full_name(), equal_to("inner > test 2"));
+    expect(tests[1].attrs.size(), equal_to(2u));
+    expect(tests[2].name.full_name(), equal_to("inner > test 3"));
+    expect(tests[2].skipped, equal_to(true));
+    expect(tests[3].name.full_name(),
+           equal_to("inner > subsuite > \"quoted\"\n"));
+  });
+
+  _.test("filtered", []() {
+    auto s = make_inner();
+    filter_set filter;
+    filter.by_name.insert(std::regex("test [23]"));
+    auto tests = list_tests(s, filter);
+
+    expect(tests.size(), equal_to(2u));
+    expect(tests[0].name.name, equal_to("test 2"));
+    expect(tests[1].name.name, equal_to("test 3"));
+    expect(tests[1].skipped, equal_to(false));
+  });
+
+  subsuite<>(_, "write_test_list()", [](auto &_) {
+    _.test("text", []() {
+      auto s = make_inner();
+      auto tests = list_tests(s, hide_filter);
+      tests.pop_back();
+
+      std::ostringstream ss;
+      write_test_list(ss, tests, list_format::text);
+
+      auto where = [&tests](std::size_t i) {
+        return "#" + std::to_string(tests[i].name.id) + " " +
+               tests[i].name.full_name() + " (" + tests[i].name.file + ":" +
+               std::to_string(tests[i].name.line) + ")";
+      };
+      expect(ss.str(), equal_to(
+        where(0) + "\n" +
+        where(1) + " [slow, tags=a,b]\n" +
+        where(2) + " [skip=broken] SKIPPED\n"
+      ));
+    });
+
+    _.test("json", []() {
+      auto s = make_suites<>("inner", [](auto &_){
+        _.test("test 1", {tags("a", "b")}, []() {});
+        subsuite<>(_, "subsuite", [](auto &_) {
+          _.test("\"quoted\"\n", {skip}, []() {});
+        });
+      });
+      auto tests = list_tests(s, hide_filter);
+      for(auto &i : tests)
+        i.name.file = "file.cpp";
+
+      std::ostringstream ss;
+      write_test_list(ss, tests, list_format::json);
+      expect(ss.str(), equal_to(
+        "[\n"
+        "  {\"id\": " + std::to_string(tests[0].name.id) +
+        ", \"suites\": [\"inner\"], \"name\": \"test 1\", "
+        "\"file\": \"file.cpp\", \"line\": " +
+        std::to_string(tests[0].name.line) + ", "
+        "\"attributes\": {\"tags\": [\"a\", \"b\"]}, \"skipped\": false},\n"
+        "  {\"id\": " + std::to_string(tests[1].name.id) +
+        ", \"suites\": [\"inner\", \"subsuite\"], "
+        "\"name\": \"\\\"quoted\\\"\\n\", "
+        "\"file\": \"file.cpp\", \"line\": " +
+        std::to_string(tests[1].name.line) + ", "
+        "\"attributes\": {\"skip\": []}, \"skipped\": true}\n"
+        "]\n"
+      ));
+    });
+
+    _.test("json with no tests", []() {
+      std::ostringstream ss;
+      write_test_list(ss, {}, list_format::json);
+      expect(ss.str(), equal_to("[]\n"));
+    });
+
+    _.test("binary", []() {
+      auto s = make_inner();
+      auto tests = list_tests(s, hide_filter);
+
+      std::ostringstream ss;
+      write_test_list(ss, tests, list_format::binary);
+
+      using namespace log;
+      frame::name_table names;
+      std::vector<std::string> listed;
+      std::vector<std::string> attrs;
+      std::string data = ss.str();
+      std::string_view rest = data;
+      while(!rest.empty()) {
+        auto size = frame::frame_size(rest);
+        expect(size, greater(0u));
+        auto [type, payload_size] = frame::read_header(rest);
+        frame::reader r(rest.substr(frame::header_size, payload_size));
+        rest.remove_prefix(size);
+
+        if(type == frame::event_type::define_suites) {
+          auto id = r.u64();
+          names.define_suites(id, r.suites());
+        } else if(type == frame::event_type::define_file) {
+          auto id = r.u64();
+          names.define_file(id, r.str());
+        } else {
+          expect(type, equal_to(frame::event_type::listed_test));
+          auto id = r.u64();
+          auto &suites = names.suites(r.u64());
+          auto name = r.str();
+          auto &file = names.file(r.u64());
+          auto line = r.u64();
+          expect(file, equal_to(tests[listed.size()].name.file));
+          expect(line, equal_to(tests[listed.size()].name.line));
+
+          test_name test = {suites, name, id};
+          listed.push_back(test.full_name() + (r.u64() ? " SKIPPED" : ""));
+          for(auto count = r.u64(); count != 0; count--) {
+            attrs.push_back(r.str());
+            for(auto values = r.u64(); values != 0; values--) {
+              attrs.back() += (attrs.back().find('=') == std::string::npos ?
+                               "=" : ",") + r.str();
+            }
+          }
+        }
+      }
+
+      expect(listed, array(
+        "inner > test 1",
+        "inner > test 2",
+        "inner > test 3 SKIPPED",
+        "inner > subsuite > \"quoted\"\n"
+      ));
+      expect(attrs, array("slow", "tags=a,b", "skip=broken"));
+    });
+  });
+
+  subsuite<>(_, "read_test_list()", [](auto &_) {
+    _.test("round trip", []() {
+      auto s = make_inner();
+      auto tests = list_tests(s, hide_filter);
+
+      std::ostringstream ss;
+      write_test_list(ss, tests, list_format::binary);
+      auto read = read_test_list(ss.str());
+
+      expect(read.size(), equal_to(tests.size()));
+      for(std::size_t i = 0; i != read.size(); i++) {
+        expect(read[i].id, equal_to(tests[i].name.id));
+        expect(read[i].full_name(), equal_to(tests[i].name.full_name()));
+        expect(read[i].file, equal_to(tests[i].name.file));
+        expect(read[i].line, equal_to(tests[i].name.line));
+      }
+    });
+
+    _.test("empty", []() {
+      expect(read_test_list("").size(), equal_to(0u));
+    });
+
+    _.test("truncated", []() {
+      auto s = make_inner();
+      std::ostringstream ss;
+      write_test_list(ss, list_tests(s, hide_filter), list_format::binary);
+      auto data = ss.str();
+      data.pop_back();
+
+      expect([&data]() { read_test_list(data); },
+             thrown<std::runtime_error>("unexpected end of test list"));
+    });
+  });
+
+});
@@ -0,0 +1,81 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <mettle/driver/resource_limits.hpp>
+
+using namespace std::literals::chrono_literals;
+
+suite<> test_resource_limits("resource limits", [](auto &_) {
+  subsuite<>(_, "parse_memory_size()", [](auto &_) {
+    _.test("bytes", []() {
+      expect(parse_memory_size("100"), equal_to(100u));
+      expect(parse_memory_size("100B"), equal_to(100u));
+    });
+
+    _.test("suffixes", []() {
+      expect(parse_memory_size("2K"), equal_to(2048u));
+      expect(parse_memory_size("2KiB"), equal_to(2048u));
+      expect(parse_memory_size("512M"), equal_to(512u * 1024 * 1024));
+      expect(parse_memory_size("4G"), equal_to(4ull * 1024 * 1024 * 1024));
+    });
+
+    _.test("invalid", []() {
+      for(std::string i : {"", "M", "0", "-1", "1.5M", "1T", "1 M",
+                           "99999999999999999999"}) {
+        expect(i, [&i]() { parse_memory_size(i); },
+               thrown<std::invalid_argument>(
+                 "invalid memory size \"" + i + "\""
+               ));
+      }
+    });
+  });
+
+  subsuite<>(_, "parse_cpu_time()", [](auto &_) {
+    _.test("seconds", []() {
+      expect(parse_cpu_time("30"), equal_to(30s));
+      expect(parse_cpu_time("30s"), equal_to(30s));
+    });
+
+    _.test("suffixes", []() {
+      expect(parse_cpu_time("2m"), equal_to(120s));
+      expect(parse_cpu_time("1h"), equal_to(3600s));
+    });
+
+    _.test("invalid", []() {
+      for(std::string i : {"", "s", "0s", "1.5s", "10ms", "1d"}) {
+        expect(i, [&i]() { parse_cpu_time(i); },
+               thrown<std::invalid_argument>("invalid CPU time \"" + i + "\""));
+      }
+    });
+  });
+
+  _.test("format_memory_size()", []() {
+    expect(format_memory_size(100), equal_to("100 bytes"));
+    expect(format_memory_size(1536), equal_to("1536 bytes"));
+    expect(format_memory_size(2048), equal_to("2 KiB"));
+    expect(format_memory_size(512 * 1024 * 1024), equal_to("512 MiB"));
+    expect(format_memory_size(8ull * 1024 * 1024 * 1024), equal_to("8 GiB"));
+  });
+
+  subsuite<>(_, "get_resource_limits()", [](auto &_) {
+    _.test("defaults", []() {
+      auto limits = get_resource_limits({}, {1024, 10s});
+      expect(limits.max_rss, equal_to(1024u));
+      expect(limits.cpu_time, equal_to(10s));
+    });
+
+    _.test("attributes", []() {
+      auto limits = get_resource_limits(
+        {limit::max_rss("1K"), limit::cpu_time("1m")}, {}
+      );
+      expect(limits.max_rss, equal_to(1024u));
+      expect(limits.cpu_time, equal_to(60s));
+    });
+
+    _.test("attributes override defaults", []() {
+      auto limits = get_resource_limits({limit::max_rss("2K")}, {1024, 10s});
+      expect(limits.max_rss, equal_to(2048u));
+      expect(limits.cpu_time, equal_to(10s));
+    });
+  });
+});
@@ -1,7 +1,12 @@
 #include <mettle.hpp>
 using namespace mettle;
 
+#include <cstdio>
 #include <cstdlib>
+#include <filesystem>
+
+#include <mettle/driver/list_tests.hpp>
+#include <mettle/driver/test_history.hpp>
 
 #include "../../src/mettle/log_pipe.hpp"
 #include "../../src/mettle/run_test_files.hpp"
@@ -71,6 +76,20 @@ suite<> test_run_file("run files", [](auto &_) {
       expect(run_test_file({test_data("test_abort")}, f.pipe), passed(false));
       expect(f.logger.events, array());
     });
+
+#ifndef _WIN32
+    _.test("file that only knows --output-fd", [](logger_factory &f) {
+      // Act like a test file built against an older mettle, which rejects
+      // options it doesn't know and only sends bencode.
+      std::string script =
+        "for a in \"$@\"; do case $a in --output-protocol|--output-buffer) exit 2;; esac; "
+        "done; printf '%s' 'd5:event13:started_suite6:suitesl5:suiteee"
+        "d5:event11:ended_suite6:suitesl5:suiteee' >\"/dev/fd/$2\"";
+      expect(run_test_file({"/bin/sh", "-c", script, "sh"}, f.pipe),
+             passed(true));
+      expect(f.logger.events, array("started_suite", "ended_suite"));
+    });
+#endif
   });
 
   subsuite<test_event_logger>(_, "run_test_files()", [](auto &_) {
@@ -114,6 +133,166 @@ suite<> test_run_file("run files", [](auto &_) {
       ));
     });
 
+    _.test("multiple files in parallel", [](test_event_logger &logger) {
+      run_test_files({
+        test_data("test_pass"), test_data("test_fail"), test_data("test_abort")
+      }, logger, {}, 3);
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+          "started_file",
+            "started_suite", "started_test", "failed_test", "ended_suite",
+          "ended_file",
+          "started_file", "failed_file",
+        "ended_run"
+      ));
+      expect(logger.files.size(), equal_to(3));
+      expect(logger.tests.size(), equal_to(2));
+    });
+
+    _.test("multiple files longest first", [](test_event_logger &logger) {
+      using namespace std::literals::chrono_literals;
+      auto estimate = [](const test_command &command)
+        -> std::optional<log::test_duration> {
+        if(command.command() == test_data("test_abort"))
+          return 100ms;
+        return std::nullopt;
+      };
+
+      run_test_files({
+        test_data("test_pass"), test_data("test_fail"), test_data("test_abort")
+      }, logger, {}, 2, estimate);
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+          "started_file",
+            "started_suite", "started_test", "failed_test", "ended_suite",
+          "ended_file",
+          "started_file", "failed_file",
+        "ended_run"
+      ));
+    });
+
+    _.test("multiple files scheduled by test", [](test_event_logger &logger) {
+      run_test_files({
+        test_data("test_pass"), test_data("test_fail"), test_data("test_abort")
+      }, logger, {}, 3, nullptr, nullptr, schedule_mode::test);
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "passed_test", "ended_suite",
+          "ended_file",
+          "started_file",
+            "started_suite", "started_test", "failed_test", "ended_suite",
+          "ended_file",
+          "started_file", "failed_file",
+        "ended_run"
+      ));
+      expect(logger.files.size(), equal_to(3));
+      expect(logger.tests.size(), equal_to(2));
+    });
+
+    _.test("one file split by test", [](test_event_logger &logger) {
+      using namespace std::literals::chrono_literals;
+      auto estimate = [](const test_name &test)
+        -> std::optional<log::test_duration> {
+        if(test.name == "test 3")
+          return 100ms;
+        return std::nullopt;
+      };
+
+      run_test_files({test_data("test_many")}, logger, {}, 2, nullptr,
+                     nullptr, schedule_mode::test, estimate);
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite",
+              "started_suite",
+                "started_test", "passed_test",
+                "started_test", "passed_test",
+                "started_test", "passed_test",
+              "ended_suite",
+              "started_suite",
+                "started_test", "passed_test",
+                "started_test", "passed_test",
+                "started_test", "passed_test",
+              "ended_suite",
+            "ended_suite",
+          "ended_file",
+        "ended_run"
+      ));
+      expect(logger.files.size(), equal_to(1));
+      expect(logger.tests.size(), equal_to(6));
+    });
+
+#ifndef _WIN32
+    _.test("sharded and split by test", [](test_event_logger &) {
+      using namespace std::literals::chrono_literals;
+      auto history_path = (std::filesystem::temp_directory_path() /
+                           "mettle-test-shard-history").string();
+
+      // Give the tests uneven durations so that the shards are balanced by
+      // their history rather than by hashing each test's name.
+      auto list = platform::list_test_file({test_data("test_many_suites")});
+      expect(list.has_value(), equal_to(true));
+      test_history history;
+      log::test_duration duration{10};
+      for(const auto &test : read_test_list(*list)) {
+        history.record(test, duration, true);
+        duration *= 2;
+      }
+      history.save(history_path);
+
+      std::size_t total = 0;
+      for(std::string index : {"0", "1", "2"}) {
+        test_event_logger logger;
+        run_test_files({test_data("test_many_suites")}, logger, {
+          "--shard-count", "3", "--shard-index", index,
+          "--history", history_path
+        }, 2, nullptr, nullptr, schedule_mode::test);
+        expect(logger.files.size(), equal_to(1));
+        total += logger.tests.size();
+      }
+      std::remove(history_path.c_str());
+      expect(total, equal_to(6));
+    });
+#endif
+
+    _.test("fail fast", [](test_event_logger &logger) {
+      failure_limit fail_fast(1);
+      run_test_files({
+        test_data("test_fail"), test_data("test_pass"), test_data("test_abort")
+      }, logger, {}, 1, nullptr, &fail_fast);
+      expect(logger.events, array(
+        "started_run",
+          "started_file",
+            "started_suite", "started_test", "failed_test", "ended_suite",
+          "ended_file",
+          "started_file", "failed_file",
+          "started_file", "failed_file",
+        "ended_run"
+      ));
+      expect(fail_fast.reached(), equal_to(true));
+    });
+
+    _.test("fail fast in parallel", [](test_event_logger &logger) {
+      // The second file may or may not finish before it's interrupted, but
+      // the third never gets a chance to start.
+      failure_limit fail_fast(1);
+      run_test_files({
+        test_data("test_fail"), test_data("test_pass"), test_data("test_abort")
+      }, logger, {}, 2, nullptr, &fail_fast);
+      expect(std::vector<std::string>(logger.events.end() - 3,
+                                      logger.events.end()),
+             array("started_file", "failed_file", "ended_run"));
+      expect(logger.files.size(), equal_to(3));
+      expect(fail_fast.reached(), equal_to(true));
+    });
+
     _.test("multiple runs", [](test_event_logger &logger) {
       for(int i = 0; i != 2; i++) {
         run_test_files({
@@ -1,9 +1,53 @@
 #include <mettle.hpp>
 using namespace mettle;
 
+#include <deque>
+
 #include <mettle/driver/run_tests.hpp>
 #include "../test_event_logger.hpp"
 
+// A pool that holds onto every test until wait() is called, and then reports
+// them in reverse order.
+struct reverse_pool : test_pool {
+  void start(const test_info &test, callback_type done) override {
+    started.push_back(test.name);
+    pending.emplace_back(test.function(), std::move(done));
+  }
+
+  void wait() override {
+    while(!pending.empty()) {
+      auto [result, done] = std::move(pending.back());
+      pending.pop_back();
+      done(std::move(result), {}, log::test_duration(0));
+    }
+  }
+
+  std::vector<std::pair<test_result, callback_type>> pending;
+  std::vector<std::string> started;
+};
+
+// A pool that runs its tests one at a time in wait(), and drops whatever's
+// left when cancelled.
+struct cancelling_pool : test_pool {
+  void start(const test_info &test, callback_type done) override {
+    pending.emplace_back(&test, std::move(done));
+  }
+
+  void wait() override {
+    while(!pending.empty()) {
+      auto [test, done] = std::move(pending.front());
+      pending.pop_front();
+      done(test->function(), {}, log::test_duration(0));
+    }
+  }
+
+  void cancel() override {
+    pending.clear();
+  }
+
+  std::deque<std::pair<const test_info *, callback_type>> pending;
+};
+
 suite<test_event_logger> test_run_tests("run_tests", [](auto &_) {
 
   _.test("single suite", [](test_event_logger &logger) {
@@ -30,6 +74,22 @@ suite<test_event_logger> test_run_tests("run_tests", [](auto &_) {
     expect(logger.events, equal_to(expected));
   });
 
+  _.test("tests in a suite share their suite path", [](
+    test_event_logger &logger
+  ) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {});
+      _.test("test 2", []() {});
+    });
+
+    run_tests(s, logger, inline_test_runner);
+    expect(logger.tests.size(), equal_to(2u));
+    auto &first = logger.tests.begin()->suites;
+    auto &second = std::next(logger.tests.begin())->suites;
+    expect(first, array("inner"));
+    expect(&first.get(), equal_to(&second.get()));
+  });
+
   _.test("multiple suites", [](test_event_logger &logger) {
     auto s = make_suites<int, float>("inner", [](auto &_){
       _.test("test 1", [](const auto &) {});
@@ -133,4 +193,228 @@ suite<test_event_logger> test_run_tests("run_tests", [](auto &_) {
     expect(logger.events, equal_to(expected));
   });
 
+  _.test("suite hidden by the filter", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {});
+      subsuite<>(_, "subsuite 1", [](auto &_) {
+        _.test("sub-test 1", []() {});
+        subsuite<>(_, "sub-subsuite", [](auto &_) {
+          _.test("sub-sub-test 1", []() {});
+        });
+      });
+      subsuite<>(_, "subsuite 2", [](auto &_) {
+        _.test("sub-test 2", []() {});
+      });
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_suite",
+          "started_test",
+          "passed_test",
+        "ended_suite",
+      "ended_suite",
+      "ended_run"
+    };
+
+    struct prefix_filter {
+      filter_result operator ()(const test_name &name,
+                                const attributes &) const {
+        filtered.push_back(name.full_name());
+        return test_action::run;
+      }
+
+      bool hides_suite(std::string_view prefix, const attributes &) const {
+        return prefix.starts_with("inner > subsuite 1 > ");
+      }
+
+      std::vector<std::string> &filtered;
+    };
+
+    std::vector<std::string> filtered;
+    run_tests(s, logger, inline_test_runner, prefix_filter{filtered});
+    expect(logger.events, equal_to(expected));
+    expect(filtered, array(
+      "inner > test 1", "inner > subsuite 2 > sub-test 2"
+    ));
+  });
+
+  subsuite<reverse_pool>(_, "in parallel", [](auto &_) {
+    auto make = []() {
+      return make_suites<>("inner", [](auto &_){
+        _.test("test 1", []() {});
+        _.test("test 2", []() { expect(true, equal_to(false)); });
+        _.test("test 3", {skip}, []() {});
+        subsuite<>(_, "subsuite", [](auto &_) {
+          _.test("sub-test 1", []() {});
+        });
+      });
+    };
+
+    _.test("suite order", [make](test_event_logger &logger,
+                                 reverse_pool &pool) {
+      std::vector<std::string> expected = {
+        "started_run",
+        "started_suite",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "skipped_test",
+          "started_suite",
+            "started_test",
+            "passed_test",
+          "ended_suite",
+        "ended_suite",
+        "ended_run"
+      };
+
+      run_tests(make(), logger, pool, default_filter());
+      expect(logger.events, equal_to(expected));
+    });
+
+    _.test("completion order", [make](test_event_logger &logger,
+                                      reverse_pool &pool) {
+      std::vector<std::string> expected = {
+        "started_run",
+        "started_suite",
+          "started_test",
+          "skipped_test",
+          "started_suite",
+            "started_test",
+            "passed_test",
+          "ended_suite",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "passed_test",
+        "ended_suite",
+        "ended_run"
+      };
+
+      run_tests(make(), logger, pool, default_filter(),
+                report_order::completion);
+      expect(logger.events, equal_to(expected));
+    });
+
+    _.test("longest first", [make](test_event_logger &logger,
+                                   reverse_pool &pool) {
+      std::vector<std::string> expected = {
+        "started_run",
+        "started_suite",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "skipped_test",
+          "started_suite",
+            "started_test",
+            "passed_test",
+          "ended_suite",
+        "ended_suite",
+        "ended_run"
+      };
+
+      using namespace std::literals::chrono_literals;
+      auto estimate = [](const test_name &test)
+        -> std::optional<log::test_duration> {
+        if(test.name == "test 1")
+          return 10ms;
+        else if(test.name == "sub-test 1")
+          return 50ms;
+        return std::nullopt;
+      };
+
+      run_tests(make(), logger, pool, default_filter(), report_order::suite,
+                estimate);
+      expect(logger.events, equal_to(expected));
+      expect(pool.started, array("test 2", "sub-test 1", "test 1"));
+    });
+  });
+
+  subsuite<>(_, "fail fast", [](auto &_) {
+    auto make = []() {
+      return make_suites<>("inner", [](auto &_){
+        _.test("test 1", []() { expect(true, equal_to(false)); });
+        _.test("test 2", []() {});
+        _.test("test 3", []() { expect(true, equal_to(false)); });
+        _.test("test 4", []() {});
+      });
+    };
+
+    _.test("runner", [make](test_event_logger &logger) {
+      std::vector<std::string> expected = {
+        "started_run",
+        "started_suite",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "passed_test",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "skipped_test",
+        "ended_suite",
+        "ended_run"
+      };
+
+      failure_limit fail_fast(2);
+      run_tests(make(), logger, inline_test_runner, default_filter(),
+                &fail_fast);
+      expect(logger.events, equal_to(expected));
+      expect(fail_fast.reached(), equal_to(true));
+    });
+
+    _.test("pool", [make](test_event_logger &logger) {
+      std::vector<std::string> expected = {
+        "started_run",
+        "started_suite",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "skipped_test",
+          "started_test",
+          "skipped_test",
+          "started_test",
+          "skipped_test",
+        "ended_suite",
+        "ended_run"
+      };
+
+      cancelling_pool pool;
+      failure_limit fail_fast(1);
+      run_tests(make(), logger, pool, default_filter(), report_order::suite,
+                nullptr, &fail_fast);
+      expect(logger.events, equal_to(expected));
+    });
+
+    _.test("pool in completion order", [make](test_event_logger &logger) {
+      std::vector<std::string> expected = {
+        "started_run",
+        "started_suite",
+          "started_test",
+          "failed_test",
+          "started_test",
+          "skipped_test",
+          "started_test",
+          "skipped_test",
+          "started_test",
+          "skipped_test",
+        "ended_suite",
+        "ended_run"
+      };
+
+      cancelling_pool pool;
+      failure_limit fail_fast(1);
+      run_tests(make(), logger, pool, default_filter(),
+                report_order::completion, nullptr, &fail_fast);
+      expect(logger.events, equal_to(expected));
+    });
+  });
+
 });
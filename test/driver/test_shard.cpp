@@ -0,0 +1,128 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <map>
+
+#include <mettle/driver/shard.hpp>
+#include "../test_event_logger.hpp"
+
+using namespace std::literals::chrono_literals;
+
+template<typename Suites>
+std::vector<std::string> run_shard(const Suites &suites, std::size_t index,
+                                   std::size_t count,
+                                   const test_estimator &estimate = nullptr) {
+  auto filter = make_shard_filter(suites, default_filter(), index, count,
+                                  estimate);
+  std::vector<std::string> ran;
+  run_tests(suites, test_event_logger(), [&ran](const test_info &test,
+                                                log::test_output &) {
+    ran.push_back(test.name);
+    return test.function();
+  }, filter);
+  return ran;
+}
+
+suite<> test_shard("sharding", [](auto &_) {
+  subsuite<>(_, "stable_hash()", [](auto &_) {
+    _.test("empty string", []() {
+      expect(stable_hash(""), equal_to(0xcbf29ce484222325ULL));
+    });
+
+    _.test("non-empty string", []() {
+      expect(stable_hash("a"), equal_to(0xaf63dc4c8601ec8cULL));
+      expect(stable_hash("foobar"), equal_to(0x85944171f73967e8ULL));
+    });
+  });
+
+  subsuite<>(_, "assign_shards()", [](auto &_) {
+    _.test("one shard", []() {
+      expect(assign_shards({"a", "b", "c"}, {10ms, 20ms, std::nullopt}, 1),
+             array(0u, 0u, 0u));
+    });
+
+    _.test("no estimates", []() {
+      std::vector<std::string> keys = {"a", "b", "c", "d"};
+      auto shards = assign_shards(
+        keys, std::vector<std::optional<log::test_duration>>(4), 3
+      );
+      for(std::size_t i = 0; i != keys.size(); i++)
+        expect(shards[i], equal_to(stable_hash(keys[i]) % 3));
+    });
+
+    _.test("balanced", []() {
+      auto shards = assign_shards(
+        {"a", "b", "c", "d"}, {100ms, 50ms, 40ms, 10ms}, 2
+      );
+      expect(shards[1], equal_to(shards[2]));
+      expect(shards[1], equal_to(shards[3]));
+      expect(shards[0], not_equal_to(shards[1]));
+    });
+
+    _.test("unknown estimates", []() {
+      // "c" is assumed to take the average time, so it goes with "b".
+      auto shards = assign_shards(
+        {"a", "b", "c"}, {100ms, 20ms, std::nullopt}, 2
+      );
+      expect(shards[1], equal_to(shards[2]));
+      expect(shards[0], not_equal_to(shards[1]));
+    });
+
+    _.test("deterministic", []() {
+      std::vector<std::string> keys;
+      std::vector<std::optional<log::test_duration>> estimates;
+      for(int i = 0; i != 100; i++) {
+        keys.push_back("test " + std::to_string(i));
+        estimates.push_back(log::test_duration(i % 7));
+      }
+
+      auto shards = assign_shards(keys, estimates, 8);
+      expect(assign_shards(keys, estimates, 8), equal_to(shards));
+      expect(shards, each(less(8u)));
+    });
+  });
+
+  subsuite<>(_, "make_shard_filter()", [](auto &_) {
+    auto make = []() {
+      return make_suites<>("inner", [](auto &_){
+        for(int i = 0; i != 20; i++)
+          _.test("test " + std::to_string(i), []() {});
+        subsuite<>(_, "subsuite", [](auto &_) {
+          for(int i = 0; i != 20; i++)
+            _.test("sub-test " + std::to_string(i), []() {});
+        });
+      });
+    };
+
+    _.test("every test runs once", [make]() {
+      auto s = make();
+      std::map<std::string, int> counts;
+      for(std::size_t i = 0; i != 4; i++) {
+        for(const auto &name : run_shard(s, i, 4))
+          counts[name]++;
+      }
+
+      expect(counts.size(), equal_to(40u));
+      for(const auto &i : counts)
+        expect(i.first, i.second, equal_to(1));
+    });
+
+    _.test("balanced by estimate", [make]() {
+      auto s = make();
+      auto estimate = [](const test_name &test)
+        -> std::optional<log::test_duration> {
+        if(test.name == "test 0")
+          return 1000ms;
+        return 10ms;
+      };
+
+      auto shard0 = run_shard(s, 0, 2, estimate),
+           shard1 = run_shard(s, 1, 2, estimate);
+      auto &slow = std::find(shard0.begin(), shard0.end(), "test 0") !=
+                   shard0.end() ? shard0 : shard1;
+      auto &fast = &slow == &shard0 ? shard1 : shard0;
+      expect(slow, array("test 0"));
+      expect(fast.size(), equal_to(39u));
+    });
+  });
+});
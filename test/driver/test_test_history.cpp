@@ -0,0 +1,156 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include <mettle/driver/test_history.hpp>
+#include <mettle/driver/log/history.hpp>
+
+using namespace std::literals::chrono_literals;
+
+auto equal_entry(log::test_duration duration, bool passed) {
+  std::ostringstream ss;
+  ss << "entry(" << duration.count() << " ms, " << to_printable(passed) << ")";
+  return basic_matcher(
+    [duration, passed](const std::optional<test_history::entry> &actual) {
+      return actual && actual->duration == duration &&
+             actual->passed == passed;
+    }, ss.str()
+  );
+}
+
+struct history_file {
+  history_file() : path((std::filesystem::temp_directory_path() /
+                         "mettle-test-history").string()) {
+    std::remove(path.c_str());
+  }
+
+  ~history_file() {
+    std::remove(path.c_str());
+  }
+
+  std::string path;
+};
+
+suite<history_file> test_history_suite("test_history", [](auto &_) {
+  _.test("record and find", [](history_file &) {
+    test_history history;
+    test_name test = {{"suite", "subsuite"}, "test", 1, "file.cpp"};
+    test_name other = {{"suite"}, "test", 2, "file.cpp"};
+
+    expect(history.find(test), equal_to(std::nullopt));
+    history.record(test, 100ms, true);
+    expect(history.find(test), equal_entry(100ms, true));
+    expect(history.find(other), equal_to(std::nullopt));
+
+    history.record(test, 50ms, false);
+    expect(history.find(test), equal_entry(50ms, false));
+
+    history.record_file("test_file", 200ms, true);
+    expect(history.find_file("test_file"), equal_entry(200ms, true));
+    expect(history.size(), equal_to(2u));
+  });
+
+  _.test("missing file", [](history_file &f) {
+    expect(test_history::load(f.path).empty(), equal_to(true));
+  });
+
+  _.test("save and load", [](history_file &f) {
+    test_name test1 = {{"suite"}, "test 1", 1, "file1.cpp"};
+    test_name test2 = {{"suite"}, "test 2", 2, "file1.cpp"};
+    test_name test3 = {{"suite"}, "test 1", 3, "file2.cpp"};
+
+    test_history history;
+    history.record(test1, 100ms, true);
+    history.record(test2, 5000000000ms, false);
+    history.record(test3, 0ms, true);
+    history.record_file("test_file", 200ms, false);
+    history.save(f.path);
+
+    auto loaded = test_history::load(f.path);
+    expect(loaded.size(), equal_to(4u));
+    expect(loaded.find(test1), equal_entry(100ms, true));
+    expect(loaded.find(test2), equal_entry(5000000000ms, false));
+    expect(loaded.find(test3), equal_entry(0ms, true));
+    expect(loaded.find_file("test_file"), equal_entry(200ms, false));
+  });
+
+  _.test("save replaces existing file", [](history_file &f) {
+    test_name test = {{"suite"}, "test", 1, "file.cpp"};
+
+    test_history history;
+    history.record(test, 100ms, true);
+    history.save(f.path);
+    history.record(test, 50ms, false);
+    history.save(f.path);
+
+    expect(test_history::load(f.path).find(test), equal_entry(50ms, false));
+  });
+
+  _.test("save leaves no temporary files", [](history_file &f) {
+    test_history history;
+    history.record({{"suite"}, "test", 1, "file.cpp"}, 100ms, true);
+    history.save(f.path);
+    history.save(f.path);
+
+    auto path = std::filesystem::path(f.path);
+    auto prefix = path.filename().string() + ".";
+    std::size_t leftover = 0;
+    for(const auto &i : std::filesystem::directory_iterator(
+          path.parent_path()
+        )) {
+      if(i.path().filename().string().starts_with(prefix))
+        leftover++;
+    }
+    expect(leftover, equal_to(0u));
+    expect(test_history::load(f.path).size(), equal_to(1u));
+  });
+
+  _.test("invalid file", [](history_file &f) {
+    {
+      std::ofstream out(f.path);
+      out << "garbage";
+    }
+    expect([&f]() { test_history::load(f.path); },
+           thrown<std::runtime_error>());
+
+    test_history history;
+    history.record({{"suite"}, "test", 1, "file.cpp"}, 100ms, true);
+    history.save(f.path);
+    std::filesystem::resize_file(f.path,
+                                 std::filesystem::file_size(f.path) - 1);
+    expect([&f]() { test_history::load(f.path); },
+           thrown<std::runtime_error>());
+  });
+});
+
+suite<test_history> test_history_logger("history logger", [](auto &_) {
+  _.test("records tests", [](test_history &history) {
+    log::history logger(history, nullptr);
+    test_name passed = {{"suite"}, "passed", 1, "file.cpp"};
+    test_name failed = {{"suite"}, "failed", 2, "file.cpp"};
+    test_name skipped = {{"suite"}, "skipped", 3, "file.cpp"};
+
+    logger.started_run();
+    logger.started_file({"test_file", 0});
+    logger.started_suite({"suite"});
+    logger.started_test(passed);
+    logger.passed_test(passed, {}, 100ms);
+    logger.started_test(failed);
+    logger.failed_test(failed, "message", {}, 50ms);
+    logger.skipped_test(skipped, "message");
+    logger.ended_suite({"suite"});
+    logger.ended_file({"test_file", 0});
+    logger.started_file({"failed_file", 1});
+    logger.failed_file({"failed_file", 1}, "message");
+    logger.ended_run();
+
+    expect(history.find(passed), equal_entry(100ms, true));
+    expect(history.find(failed), equal_entry(50ms, false));
+    expect(history.find(skipped), equal_to(std::nullopt));
+    expect(history.find_file("test_file"), equal_entry(150ms, false));
+    expect(history.find_file("failed_file"), equal_entry(0ms, false));
+  });
+});
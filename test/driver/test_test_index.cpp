@@ -0,0 +1,117 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <mettle/driver/test_index.hpp>
+#include "../helpers.hpp"
+
+auto make_inner() {
+  return make_suites<>("inner", [](auto &_){
+    _.test("test 1", []() {});
+    _.test("test 2", []() {});
+
+    subsuite<>(_, "subsuite 1", [](auto &_) {
+      _.test("sub-test 1", []() {});
+      subsuite<>(_, "sub-subsuite", [](auto &_) {
+        _.test("sub-sub-test 1", []() {});
+      });
+    });
+
+    subsuite<>(_, "subsuite 2", [](auto &_) {
+      _.test("sub-test 2", []() {});
+    });
+  });
+}
+
+suite<> test_test_index("test_index", [](auto &_) {
+
+  _.test("tests", []() {
+    auto s = make_inner();
+    auto index = make_test_index(s);
+    const auto &tests = index.tests();
+
+    std::vector<std::string> names;
+    for(const auto &test : tests)
+      names.push_back(test.name.full_name());
+    expect(names, array(
+      "inner > test 1",
+      "inner > test 2",
+      "inner > subsuite 1 > sub-test 1",
+      "inner > subsuite 1 > sub-subsuite > sub-sub-test 1",
+      "inner > subsuite 2 > sub-test 2"
+    ));
+    for(std::size_t i = 0; i != tests.size(); i++)
+      expect(tests[i].full_name, equal_to(names[i]));
+
+    expect(tests[0].info, equal_to(&s[0].tests()[0]));
+    expect(tests[0].name.id, equal_to(s[0].tests()[0].id));
+    expect(tests[0].name.file, equal_to(s[0].tests()[0].loc.file_name()));
+    expect(tests[0].name.line, equal_to(s[0].tests()[0].loc.line()));
+    expect(tests[4].info, equal_to(&s[0].subsuites()[1].tests()[0]));
+  });
+
+  _.test("suites", []() {
+    auto s = make_inner();
+    auto index = make_test_index(s);
+    const auto &suites = index.suites();
+
+    std::vector<std::vector<std::string>> paths;
+    for(const auto &suite : suites)
+      paths.push_back(suite.path);
+    expect(paths, array(
+      array("inner"),
+      array("inner", "subsuite 1"),
+      array("inner", "subsuite 1", "sub-subsuite"),
+      array("inner", "subsuite 2")
+    ));
+
+    auto ranges = [](const auto &suite) {
+      return std::vector<std::size_t>{
+        suite.tests_begin, suite.tests_end, suite.subsuites_end,
+        suite.subtree_tests_end
+      };
+    };
+    expect(ranges(suites[0]), array(0u, 2u, 4u, 5u));
+    expect(ranges(suites[1]), array(2u, 3u, 3u, 4u));
+    expect(ranges(suites[2]), array(3u, 4u, 3u, 4u));
+    expect(ranges(suites[3]), array(4u, 5u, 4u, 5u));
+
+    expect(index.tests()[3].suite, equal_to(2u));
+    expect(suites[0].prefix, equal_to("inner > "));
+    expect(suites[2].prefix, equal_to("inner > subsuite 1 > sub-subsuite > "));
+  });
+
+  _.test("suite attributes", []() {
+    bool_attr slow("slow");
+    bool_attr other("other");
+    auto s = make_suites<>("inner", {slow}, [&other](auto &_){
+      _.test("test", []() {});
+      subsuite<>(_, "subsuite", {other}, [](auto &_) {
+        _.test("sub-test", []() {});
+      });
+    });
+    auto index = make_test_index(s);
+
+    expect(*index.suites()[0].attrs, equal_attributes({slow}));
+    expect(*index.suites()[1].attrs, equal_attributes({other, slow}));
+  });
+
+  _.test("tests in a suite share their suite path", []() {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {});
+      _.test("test 2", []() {});
+    });
+    auto index = make_test_index(s);
+    const auto &tests = index.tests();
+
+    expect(&tests[0].name.suites.get(), equal_to(&tests[1].name.suites.get()));
+    expect(&tests[0].name.suites.get(),
+           equal_to(&index.suites()[0].path.get()));
+  });
+
+  _.test("empty", []() {
+    auto index = make_test_index(suites_list{});
+    expect(index.suites().size(), equal_to(0u));
+    expect(index.tests().size(), equal_to(0u));
+  });
+
+});
@@ -15,7 +15,7 @@ namespace mettle {
 
   std::string to_printable(const attr_instance &attr) {
     std::ostringstream ss;
-    ss << attr.attribute.name();
+    ss << attr.attribute().name();
     if(!attr.value.empty()) {
       ss << "(" << detail::joined(attr.value, [](auto &&i) {
         return to_printable(i);
@@ -67,7 +67,7 @@ namespace mettle {
     return basic_matcher(
       std::move(expected),
       [](const attr_instance &actual, const attr_instance &expected) {
-        return actual.attribute.name() == expected.attribute.name() &&
+        return actual.attribute().name() == expected.attribute().name() &&
                actual.value == expected.value;
       }, ""
     );
@@ -0,0 +1,124 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "errno.hpp"
+#include <mettle/driver/posix/child_monitor.hpp>
+#include <mettle/driver/posix/scoped_pipe.hpp>
+#include <mettle/driver/posix/scoped_signal.hpp>
+using namespace mettle::posix;
+
+auto equal_event(child_monitor::event_type type, void *data) {
+  return basic_matcher([type, data](const child_monitor::event &actual) {
+    return actual.type == type && actual.data == data;
+  }, "event");
+}
+
+void sighandler(int) {}
+
+struct monitor_fixture {
+  monitor_fixture() {
+    // Make sure child exits interrupt our wait on platforms where the monitor
+    // falls back to polling for them.
+    mask.push(SIG_BLOCK, SIGCHLD);
+    sig.open(SIGCHLD, sighandler);
+    sigemptyset(&empty);
+  }
+
+  scoped_sigprocmask mask;
+  scoped_sigaction sig;
+  sigset_t empty;
+  child_monitor monitor;
+  std::vector<child_monitor::event> events;
+};
+
+suite<monitor_fixture>
+test_child_monitor("posix::child_monitor", [](auto &_) {
+  _.setup([](monitor_fixture &f) {
+    expect("open monitor", f.monitor.open(), equal_to(0));
+  });
+
+  _.test("readable fd", [](monitor_fixture &f) {
+    scoped_pipe pipe;
+    expect("open pipe", pipe.open(), equal_to(0));
+    expect("watch fd", f.monitor.watch_fd(pipe.read_fd, &pipe), equal_to(0));
+
+    write(pipe.write_fd, "x", 1);
+    expect(f.monitor.wait(f.events, nullptr, &f.empty), equal_to(1));
+    expect(f.events, array(
+      equal_event(child_monitor::event_type::readable, &pipe)
+    ));
+
+    expect("unwatch fd", f.monitor.unwatch_fd(pipe.read_fd), equal_to(0));
+    expect("unwatch fd again", f.monitor.unwatch_fd(pipe.read_fd),
+           all( equal_to(-1), equal_errno(ENOENT) ));
+  });
+
+  _.test("timeout", [](monitor_fixture &f) {
+    scoped_pipe pipe;
+    expect("open pipe", pipe.open(), equal_to(0));
+    expect("watch fd", f.monitor.watch_fd(pipe.read_fd, &pipe), equal_to(0));
+
+    timespec timeout = {0, 10*1000*1000 /* 10 ms */};
+    expect(f.monitor.wait(f.events, &timeout, &f.empty), equal_to(0));
+    expect(f.events, array());
+  });
+
+  _.test("exited child", [](monitor_fixture &f) {
+    pid_t pid;
+    if((pid = fork()) < 0)
+      throw std::system_error(errno, std::system_category());
+    if(pid == 0)
+      _exit(0);
+
+    int data;
+    expect("watch child", f.monitor.watch_child(pid, &data), equal_to(0));
+
+    int rv;
+    do {
+      rv = f.monitor.wait(f.events, nullptr, &f.empty);
+    } while(rv < 0 && errno == EINTR);
+
+    expect(rv, equal_to(1));
+    expect(f.events, array(
+      equal_event(child_monitor::event_type::exited, &data)
+    ));
+
+    // The monitor shouldn't have reaped the child.
+    int status;
+    expect(waitpid(pid, &status, 0), equal_to(pid));
+    expect(f.monitor.unwatch_child(pid), equal_to(0));
+  });
+
+  _.test("many children", [](monitor_fixture &f) {
+    constexpr int count = 64;
+    std::vector<pid_t> pids;
+    for(int i = 0; i != count; i++) {
+      pid_t pid;
+      if((pid = fork()) < 0)
+        throw std::system_error(errno, std::system_category());
+      if(pid == 0)
+        _exit(0);
+      pids.push_back(pid);
+      expect("watch child", f.monitor.watch_child(pid, &pids), equal_to(0));
+    }
+
+    while(!pids.empty()) {
+      if(f.monitor.wait(f.events, nullptr, &f.empty) < 0) {
+        expect("wait", errno, equal_to(EINTR));
+        continue;
+      }
+
+      for(std::size_t i = pids.size(); i-- != 0;) {
+        if(waitpid(pids[i], nullptr, WNOHANG) == pids[i]) {
+          expect("unwatch child", f.monitor.unwatch_child(pids[i]),
+                 equal_to(0));
+          pids.erase(pids.begin() + i);
+        }
+      }
+    }
+  });
+});
@@ -5,7 +5,6 @@ using namespace mettle;
 
 #include <fcntl.h>
 
-#include <mettle/driver/exit_code.hpp>
 #include <mettle/driver/posix/scoped_pipe.hpp>
 #include <mettle/driver/posix/scoped_signal.hpp>
 #include <mettle/driver/posix/subprocess.hpp>
@@ -22,20 +21,17 @@ struct read_into_fixture {
 void sighandler(int) {}
 
 suite<> test_subprocess("posix subprocess utilities", [](auto &_) {
-  subsuite<>(_, "make_timeout_monitor()", [](auto &_) {
-    _.test("test process exits first", []() {
-      expect([]() {
-        make_timeout_monitor(std::chrono::milliseconds(100));
-        _exit(0);
-      }, exited(0));
+  subsuite<>(_, "to_timespec()", [](auto &_) {
+    _.test("positive duration", []() {
+      auto ts = to_timespec(std::chrono::milliseconds(1500));
+      expect(ts.tv_sec, equal_to(1));
+      expect(ts.tv_nsec, equal_to(500*1000*1000));
     });
 
-    _.test("timer process exits first", []() {
-      expect([]() {
-        make_timeout_monitor(std::chrono::milliseconds(100));
-        std::this_thread::sleep_for(std::chrono::milliseconds(250));
-        _exit(0);
-      }, exited(exit_code::timeout));
+    _.test("negative duration", []() {
+      auto ts = to_timespec(std::chrono::milliseconds(-10));
+      expect(ts.tv_sec, equal_to(0));
+      expect(ts.tv_nsec, equal_to(0));
     });
   });
 
@@ -80,6 +76,23 @@ suite<> test_subprocess("posix subprocess utilities", [](auto &_) {
       expect(f.results[1], equal_to(""));
     });
 
+    _.test("reuse a monitor", [](read_into_fixture &f) {
+      child_monitor monitor;
+      expect("open monitor", monitor.open(), equal_to(0));
+
+      timespec timeout = {0, 0};
+      write(f.pipe[0].write_fd, "pipe 1", 6);
+      expect(read_into(f.readfds, monitor, &timeout, nullptr), equal_to(0));
+      expect(f.results[0], equal_to("pipe 1"));
+
+      write(f.pipe[1].write_fd, "pipe 2", 6);
+      f.pipe[0].close_write();
+      f.pipe[1].close_write();
+      expect(read_into(f.readfds, monitor, nullptr, nullptr), equal_to(0));
+      expect(f.results[0], equal_to("pipe 1"));
+      expect(f.results[1], equal_to("pipe 2"));
+    });
+
     attributes sigtest_attrs;
 #ifdef __APPLE__
     sigtest_attrs.insert(skip("pselect(2) is buggy on OS X"));
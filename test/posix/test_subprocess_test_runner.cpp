@@ -3,7 +3,9 @@ using namespace mettle;
 
 #include <chrono>
 #include <iostream>
+#include <sstream>
 #include <thread>
+#include <vector>
 
 #include <signal.h>
 #include <string.h>
@@ -188,6 +190,134 @@ test_fork("posix::subprocess_test_runner", bind_factory(500ms), [](auto &_) {
       expect(output.stderr_log, equal_to("stderr"));
     });
 
+    _.test("test with limited stdout/stderr", [](subprocess_test_runner &,
+                                                 log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::cout << std::string(50000, 'a') << std::string(50000, 'b');
+          std::cerr << "stderr";
+        });
+      });
+
+      subprocess_test_runner runner(500ms, 10);
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(true));
+      expect(output.stdout_log, equal_to("aaaaabbbbb"));
+      expect(output.stdout_elided, equal_to(99990u));
+      expect(output.stderr_log, equal_to("stderr"));
+      expect(output.stderr_elided, equal_to(0u));
+    });
+
+    _.test("test with stdout/stderr captured in files",
+           [](subprocess_test_runner &, log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::cout << "stdout";
+          std::cerr << "stderr";
+        });
+      });
+
+      subprocess_test_runner runner(500ms, 0, output_capture::file);
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(true));
+      expect(output.stdout_log, equal_to("stdout"));
+      expect(output.stderr_log, equal_to("stderr"));
+    });
+
+    _.test("crashing test with limited output captured in files",
+           [](subprocess_test_runner &, log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::cout << std::string(50000, 'a') << std::string(50000, 'b');
+          std::cout.flush();
+          abort();
+        });
+      });
+
+      subprocess_test_runner runner(500ms, 10, output_capture::file);
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(false));
+      expect(result.message, equal_to(strsignal(SIGABRT)));
+      expect(output.stdout_log, equal_to("aaaaabbbbb"));
+      expect(output.stdout_elided, equal_to(99990u));
+      expect(output.stderr_log, equal_to(""));
+    });
+
+    _.test("test with resource usage", [](subprocess_test_runner &runner,
+                                          log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::vector<char> data(64 * 1024 * 1024, 1);
+          expect(data.back(), equal_to(1));
+        });
+      });
+
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(true));
+      expect(output.resources.has_value(), equal_to(true));
+      expect(output.resources->max_rss, greater_equal(64u * 1024 * 1024));
+      expect(output.resources->minor_faults, greater(0u));
+    });
+
+    _.test("test exceeding memory limit",
+           [](subprocess_test_runner &, log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", []() {
+          std::vector<char> data(1024 * 1024 * 1024, 1);
+          expect(data.back(), equal_to(1));
+        });
+      });
+
+      subprocess_test_runner runner(5s, 0, output_capture::pipe,
+                                    {256 * 1024 * 1024, std::nullopt});
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(false));
+      expect(result.message, equal_to("Exceeded memory limit of 256 MiB"));
+    });
+
+    _.test("test exceeding CPU time limit",
+           [](subprocess_test_runner &, log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", {limit::cpu_time("1s")}, []() {
+          auto then = std::chrono::steady_clock::now();
+          volatile std::size_t n = 0;
+          while(std::chrono::steady_clock::now() - then < 10s)
+            n = n + 1;
+        });
+      });
+
+      subprocess_test_runner runner(20s);
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(false));
+      expect(result.message, equal_to("Exceeded CPU time limit of 1 s"));
+    });
+
+    _.test("test within limits", [](subprocess_test_runner &,
+                                    log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", {limit::max_rss("1G")}, []() {
+          std::vector<char> data(64 * 1024 * 1024, 1);
+          expect(data.back(), equal_to(1));
+        });
+      });
+
+      subprocess_test_runner runner(5s, 0, output_capture::pipe,
+                                    {16 * 1024 * 1024, std::chrono::seconds(5)});
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(true));
+    });
+
+    _.test("test with invalid limit", [](subprocess_test_runner &runner,
+                                         log::test_output &output) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test", {limit::max_rss("lots")}, []() {});
+      });
+
+      auto result = runner(s.tests()[0], output);
+      expect(result.passed, equal_to(false));
+      expect(result.message, equal_to("invalid memory size \"lots\""));
+    });
+
   });
 
   subsuite<test_event_logger>(_, "run_tests()", [](auto &_) {
@@ -244,6 +374,532 @@ test_fork("posix::subprocess_test_runner", bind_factory(500ms), [](auto &_) {
 
 });
 
+suite<test_event_logger>
+test_pool("posix::subprocess_test_pool", [](auto &_) {
+
+  _.test("runs tests in parallel", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      for(int i = 0; i < 4; i++) {
+        _.test("test " + std::to_string(i), []() {
+          std::this_thread::sleep_for(300ms);
+        });
+      }
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "passed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    subprocess_test_pool pool(4);
+    auto then = std::chrono::steady_clock::now();
+    run_tests(s, logger, pool, default_filter());
+    auto now = std::chrono::steady_clock::now();
+
+    expect(logger.events, equal_to(expected));
+    expect(now - then, less(1s));
+  });
+
+  _.test("reports tests in suite order", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("slow test", []() {
+        std::this_thread::sleep_for(200ms);
+      });
+      _.test("failing test", []() {
+        expect(true, equal_to(false));
+      });
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "failed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    subprocess_test_pool pool(2);
+    run_tests(s, logger, pool, default_filter());
+    expect(logger.events, equal_to(expected));
+  });
+
+  _.test("reports tests in completion order", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("slow test", []() {
+        std::this_thread::sleep_for(200ms);
+      });
+      _.test("failing test", []() {
+        expect(true, equal_to(false));
+      });
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "passed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    subprocess_test_pool pool(2);
+    run_tests(s, logger, pool, default_filter(), report_order::completion);
+    expect(logger.events, equal_to(expected));
+  });
+
+  _.test("crashing tests don't crash framework", [](
+    test_event_logger &logger
+  ) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {});
+      _.test("test 2", []() {
+        abort();
+      });
+      _.test("test 3", []() {});
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "passed_test",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "passed_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    subprocess_test_pool pool(2);
+    run_tests(s, logger, pool, default_filter());
+    expect(logger.events, equal_to(expected));
+  });
+
+  _.test("timed out test", [](test_event_logger &) {
+    auto s = make_suite<>("inner", [](auto &_){
+      _.test("test 1", []() {
+        std::this_thread::sleep_for(2s);
+      });
+      _.test("test 2", []() {
+        std::cout << "stdout";
+      });
+    });
+
+    std::vector<test_result> results(2);
+    std::vector<log::test_output> outputs(2);
+    subprocess_test_pool pool(2, 500ms);
+
+    auto then = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i != 2; i++) {
+      pool.start(s.tests()[i], [&results, &outputs, i](
+        test_result result, log::test_output output, log::test_duration
+      ) {
+        results[i] = std::move(result);
+        outputs[i] = std::move(output);
+      });
+    }
+    pool.wait();
+    auto now = std::chrono::steady_clock::now();
+
+    expect(results[0].passed, equal_to(false));
+    expect(results[0].message, equal_to("Timed out after 500 ms"));
+    expect(results[1].passed, equal_to(true));
+    expect(outputs[1].stdout_log, equal_to("stdout"));
+    expect(now - then, less(1s));
+  });
+
+  _.test("fail fast", [](test_event_logger &logger) {
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("slow test", []() {
+        std::this_thread::sleep_for(2s);
+      });
+      _.test("failing test", []() {
+        expect(true, equal_to(false));
+      });
+      _.test("unstarted test", []() {});
+    });
+
+    std::vector<std::string> expected = {
+      "started_run",
+      "started_suite",
+        "started_test",
+        "skipped_test",
+        "started_test",
+        "failed_test",
+        "started_test",
+        "skipped_test",
+      "ended_suite",
+      "ended_run"
+    };
+
+    subprocess_test_pool pool(2);
+    failure_limit fail_fast(1);
+
+    auto then = std::chrono::steady_clock::now();
+    run_tests(s, logger, pool, default_filter(), report_order::suite, nullptr,
+              &fail_fast);
+    auto now = std::chrono::steady_clock::now();
+
+    expect(logger.events, equal_to(expected));
+    expect(fail_fast.reached(), equal_to(true));
+    expect(now - then, less(1s));
+  });
+
+  _.test("streams output", [](test_event_logger &) {
+    struct chunk_logger : test_event_logger {
+      void test_output_chunk(const test_name &test, log::output_stream stream,
+                             std::string_view data) override {
+        names.push_back(test.name);
+        (stream == log::output_stream::stdout_log ? out : err) += data;
+      }
+
+      std::vector<std::string> names;
+      std::string out, err;
+    };
+
+    auto s = make_suites<>("inner", [](auto &_){
+      _.test("test 1", []() {
+        std::cout << "stdout";
+        std::cout.flush();
+        std::cerr << "stderr";
+      });
+      _.test("test 2", []() {});
+    });
+
+    chunk_logger logger;
+    subprocess_test_pool pool(1);
+    run_tests(s, logger, pool, default_filter(), report_order::suite, nullptr,
+              nullptr, true);
+    expect(logger.names, each(equal_to("test 1")));
+    expect(logger.out, equal_to("stdout"));
+    expect(logger.err, equal_to("stderr"));
+
+    // Without streaming, the logger only sees the full output at the end.
+    chunk_logger quiet;
+    run_tests(s, quiet, pool, default_filter());
+    expect(quiet.names, array());
+  });
+
+  subsuite<>(_, "batches", [](auto &_) {
+    auto run_batch = [](const auto &s, subprocess_test_pool &pool,
+                        std::vector<test_result> &results,
+                        std::vector<log::test_output> &outputs) {
+      auto count = s.tests().size();
+      results.resize(count);
+      outputs.resize(count);
+      for(std::size_t i = 0; i != count; i++) {
+        pool.start(s.tests()[i], [&results, &outputs, i](
+          test_result result, log::test_output output, log::test_duration
+        ) {
+          results[i] = std::move(result);
+          outputs[i] = std::move(output);
+        });
+      }
+      pool.wait();
+    };
+
+    _.test("runs tests in one process", [run_batch](test_event_logger &) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test 1", []() {
+          std::cout << getpid();
+        });
+        _.test("test 2", []() {
+          std::cout << getpid();
+          std::cerr << "stderr";
+        });
+        _.test("test 3", []() {
+          std::cout << getpid();
+          expect(true, equal_to(false));
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1, std::nullopt, 3);
+      run_batch(s, pool, results, outputs);
+
+      expect(results[0].passed, equal_to(true));
+      expect(results[1].passed, equal_to(true));
+      expect(results[2].passed, equal_to(false));
+      expect(results[2].message, not_equal_to(""));
+
+      expect(outputs[1].stderr_log, equal_to("stderr"));
+      expect(outputs[0].stdout_log, all(
+        not_equal_to(""), not_equal_to(std::to_string(getpid()))
+      ));
+      expect(outputs[1].stdout_log, equal_to(outputs[0].stdout_log));
+      expect(outputs[2].stdout_log, equal_to(outputs[0].stdout_log));
+    });
+
+    _.test("crashing test", [run_batch](test_event_logger &) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test 1", []() {
+          std::cout << getpid();
+        });
+        _.test("test 2", []() {
+          std::cout << "crashing";
+          std::cout.flush();
+          abort();
+        });
+        _.test("test 3", []() {
+          std::cout << getpid();
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1, std::nullopt, 3);
+      run_batch(s, pool, results, outputs);
+
+      expect(results[0].passed, equal_to(true));
+      expect(results[1].passed, equal_to(false));
+      expect(results[1].message, equal_to(strsignal(SIGABRT)));
+      expect(outputs[1].stdout_log, equal_to("crashing"));
+      expect(results[2].passed, equal_to(true));
+      expect(outputs[2].stdout_log, not_equal_to(outputs[0].stdout_log));
+    });
+
+    _.test("limited output", [run_batch](test_event_logger &) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test 1", []() {
+          std::cout << std::string(50, 'a') << std::string(50, 'b');
+        });
+        _.test("test 2", []() {
+          std::cout << "stdout";
+          std::cerr << std::string(50, 'c') << std::string(50, 'd');
+          std::cerr.flush();
+          abort();
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1, std::nullopt, 2, 10);
+      run_batch(s, pool, results, outputs);
+
+      expect(results[0].passed, equal_to(true));
+      expect(outputs[0].stdout_log, equal_to("aaaaabbbbb"));
+      expect(outputs[0].stdout_elided, equal_to(90u));
+      expect(outputs[0].stderr_elided, equal_to(0u));
+
+      expect(results[1].passed, equal_to(false));
+      expect(outputs[1].stdout_log, equal_to("stdout"));
+      expect(outputs[1].stdout_elided, equal_to(0u));
+      expect(outputs[1].stderr_log, equal_to("cccccddddd"));
+      expect(outputs[1].stderr_elided, equal_to(90u));
+    });
+
+    _.test("resource usage", [run_batch](test_event_logger &) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test 1", []() {
+          std::vector<char> data(64 * 1024 * 1024, 1);
+          expect(data.back(), equal_to(1));
+        });
+        _.test("test 2", []() {});
+        _.test("test 3", []() {
+          abort();
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1, std::nullopt, 3);
+      run_batch(s, pool, results, outputs);
+
+      expect(results[0].passed, equal_to(true));
+      expect(outputs[0].resources.has_value(), equal_to(true));
+      expect(outputs[0].resources->max_rss,
+             greater_equal(64u * 1024 * 1024));
+      expect(outputs[0].resources->minor_faults, greater(0u));
+      expect(outputs[1].resources.has_value(), equal_to(true));
+
+      // We can't tell how much of the batch's usage belongs to a test that
+      // crashed.
+      expect(results[2].passed, equal_to(false));
+      expect(outputs[2].resources.has_value(), equal_to(false));
+    });
+
+    _.test("test exceeding memory limit", [run_batch](test_event_logger &) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test 1", []() {});
+        _.test("test 2", {limit::max_rss("256M")}, []() {
+          std::vector<char> data(1024 * 1024 * 1024, 1);
+          expect(data.back(), equal_to(1));
+        });
+        _.test("test 3", []() {
+          std::vector<char> data(512 * 1024 * 1024, 1);
+          expect(data.back(), equal_to(1));
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1, std::nullopt, 3);
+      run_batch(s, pool, results, outputs);
+
+      expect(results[0].passed, equal_to(true));
+      expect(results[1].passed, equal_to(false));
+      expect(results[1].message, equal_to("Exceeded memory limit of 256 MiB"));
+      expect(results[2].passed, equal_to(true));
+    });
+
+    _.test("timed out test", [run_batch](test_event_logger &) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.test("test 1", []() {
+          std::this_thread::sleep_for(300ms);
+        });
+        _.test("test 2", []() {
+          std::this_thread::sleep_for(2s);
+        });
+        _.test("test 3", []() {
+          std::this_thread::sleep_for(300ms);
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1, 500ms, 3);
+
+      auto then = std::chrono::steady_clock::now();
+      run_batch(s, pool, results, outputs);
+      auto now = std::chrono::steady_clock::now();
+
+      expect(results[0].passed, equal_to(true));
+      expect(results[1].passed, equal_to(false));
+      expect(results[1].message, equal_to("Timed out after 500 ms"));
+      expect(results[2].passed, equal_to(true));
+      expect(now - then, less(2s));
+    });
+
+    // Each test prints the pid that ran its suite's setup, followed by its own
+    // pid.
+    auto pids = [](const log::test_output &output) {
+      std::istringstream ss(output.stdout_log);
+      std::pair<pid_t, pid_t> result = {0, 0};
+      ss >> result.first >> result.second;
+      return result;
+    };
+
+    _.test("shared setup", [run_batch, pids](test_event_logger &) {
+      auto s = make_suite<int>("inner", [](auto &_){
+        _.fork_after_setup();
+        _.setup([](int &setup_pid) {
+          setup_pid = getpid();
+        });
+        _.teardown([](int &) {
+          std::cout << " teardown";
+        });
+        _.test("test 1", [](int &setup_pid) {
+          std::cout << setup_pid << " " << getpid();
+          setup_pid = 0;
+        });
+        _.test("test 2", [](int &setup_pid) {
+          std::cout << setup_pid << " " << getpid();
+          expect(true, equal_to(false));
+        });
+        _.test("test 3", [](int &setup_pid) {
+          std::cout << setup_pid << " " << getpid();
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1);
+      run_batch(s, pool, results, outputs);
+
+      expect(results[0].passed, equal_to(true));
+      expect(results[1].passed, equal_to(false));
+      expect(results[1].message, not_equal_to(""));
+      expect(results[2].passed, equal_to(true));
+
+      auto [setup0, test0] = pids(outputs[0]);
+      auto [setup1, test1] = pids(outputs[1]);
+      auto [setup2, test2] = pids(outputs[2]);
+      expect(setup0, all(not_equal_to(0), not_equal_to(getpid())));
+      expect(setup1, equal_to(setup0));
+      expect(setup2, equal_to(setup0));
+      expect(std::vector{test0, test1, test2}, each(not_equal_to(setup0)));
+      expect(test1, not_equal_to(test0));
+      expect(test2, not_equal_to(test1));
+
+      for(const auto &output : outputs)
+        expect(output.stdout_log, regex_search(" teardown$"));
+    });
+
+    _.test("shared setup with crashing test", [run_batch, pids](
+      test_event_logger &
+    ) {
+      auto s = make_suite<int>("inner", [](auto &_){
+        _.fork_after_setup();
+        _.setup([](int &setup_pid) {
+          setup_pid = getpid();
+        });
+        _.test("test 1", [](int &setup_pid) {
+          std::cout << setup_pid << " " << getpid();
+        });
+        _.test("test 2", [](int &) {
+          std::cout << "crashing";
+          std::cout.flush();
+          abort();
+        });
+        _.test("test 3", [](int &setup_pid) {
+          std::cout << setup_pid << " " << getpid();
+        });
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1);
+      run_batch(s, pool, results, outputs);
+
+      expect(results[0].passed, equal_to(true));
+      expect(results[1].passed, equal_to(false));
+      expect(results[1].message, equal_to(strsignal(SIGABRT)));
+      expect(outputs[1].stdout_log, equal_to("crashing"));
+      expect(results[2].passed, equal_to(true));
+      expect(pids(outputs[2]).first, equal_to(pids(outputs[0]).first));
+    });
+
+    _.test("shared setup that fails", [run_batch](test_event_logger &) {
+      auto s = make_suite<>("inner", [](auto &_){
+        _.fork_after_setup();
+        _.setup([]() {
+          throw std::runtime_error("setup failed");
+        });
+        _.test("test 1", []() {});
+        _.test("test 2", []() {});
+      });
+
+      std::vector<test_result> results;
+      std::vector<log::test_output> outputs;
+      subprocess_test_pool pool(1);
+      run_batch(s, pool, results, outputs);
+
+      for(const auto &result : results) {
+        expect(result.passed, equal_to(false));
+        expect(result.message, regex_search("setup failed"));
+      }
+    });
+  });
+
+});
+
 suite<> test_make_fd_private("make_fd_private", [](auto &_) {
 
   _.test("make_fd_private()", []() {
@@ -1,6 +1,9 @@
 #include <mettle.hpp>
 using namespace mettle;
 
+#include <iterator>
+#include <vector>
+
 #include "../helpers.hpp"
 
 suite<> test_attr("attributes", [](auto &_) {
@@ -18,7 +21,7 @@ suite<> test_attr("attributes", [](auto &_) {
       bool_attr attr("attribute");
       attr_instance a = attr;
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array());
     });
 
@@ -26,7 +29,7 @@ suite<> test_attr("attributes", [](auto &_) {
       bool_attr attr("attribute");
       attr_instance a = attr("comment");
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array("comment"));
     });
 
@@ -34,7 +37,7 @@ suite<> test_attr("attributes", [](auto &_) {
       bool_attr attr("attribute", test_action::skip);
       attr_instance a = attr;
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array());
     });
 
@@ -42,7 +45,7 @@ suite<> test_attr("attributes", [](auto &_) {
       bool_attr attr("attribute");
       attr_instance a = unite(attr("a"), attr("b"));
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array("a"));
     });
   });
@@ -52,7 +55,7 @@ suite<> test_attr("attributes", [](auto &_) {
       string_attr attr("attribute");
       attr_instance a = attr("value");
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array("value"));
     });
 
@@ -60,7 +63,7 @@ suite<> test_attr("attributes", [](auto &_) {
       string_attr attr("attribute");
       attr_instance a = unite(attr("a"), attr("b"));
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array("a"));
     });
   });
@@ -70,7 +73,7 @@ suite<> test_attr("attributes", [](auto &_) {
       list_attr attr("attribute");
       attr_instance a = attr("value");
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array("value"));
     });
 
@@ -78,7 +81,7 @@ suite<> test_attr("attributes", [](auto &_) {
       list_attr attr("attribute");
       attr_instance a = attr("value 1", "value 2");
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array("value 1", "value 2"));
     });
 
@@ -86,7 +89,7 @@ suite<> test_attr("attributes", [](auto &_) {
       list_attr attr("attribute");
       attr_instance a = unite(attr("a"), attr("b"));
 
-      expect(&a.attribute, equal_to(&attr));
+      expect(&a.attribute(), equal_to(&attr));
       expect(a.value, array("a", "b"));
     });
   });
@@ -138,4 +141,89 @@ suite<> test_attr("attributes", [](auto &_) {
       }));
     });
   });
+
+  subsuite<>(_, "attributes", [](auto &_) {
+    _.test("sorted by name", []() {
+      string_attr attr1("1");
+      string_attr attr2("2");
+      attributes attrs = {attr2("b"), attr1("a"), attr2("c")};
+
+      expect(attrs, equal_attributes({attr1("a"), attr2("b")}));
+    });
+
+    _.test("find()", []() {
+      bool_attr attr1("1");
+      string_attr attr2("2");
+      attributes attrs = {attr1, attr2("value")};
+
+      expect(&attrs.find("2")->attribute(), equal_to(&attr2));
+      expect(attrs.find("2", detail::attr_id("2")), equal_to(attrs.find("2")));
+      expect(attrs.find("3"), equal_to(attrs.end()));
+      expect(attrs.count("1"), equal_to(1u));
+      expect(attributes{}.find("1"), equal_to(attributes{}.end()));
+    });
+
+    _.test("insert()", []() {
+      string_attr attr1("1");
+      string_attr attr2("2");
+      string_attr attr3("3");
+      attributes attrs = {attr1("a"), attr3("c")};
+
+      expect(attrs.insert(attr2("b")).second, equal_to(true));
+      expect(attrs.insert(attr2("x")).second, equal_to(false));
+      expect(attrs, equal_attributes({attr1("a"), attr2("b"), attr3("c")}));
+      expect(attrs.find("2")->value, array("b"));
+    });
+
+    _.test("insert() with hint", []() {
+      string_attr attr1("1");
+      string_attr attr2("2");
+      string_attr attr3("3");
+      attributes attrs = {attr2("b")};
+
+      auto i = attrs.insert(attrs.end(), attr1("a"));
+      expect(&i->attribute(), equal_to(&attr1));
+      expect(&attrs.insert(attrs.begin(), attr2("x"))->attribute(),
+             equal_to(&attr2));
+
+      std::vector<attr_instance> more = {attr3("c"), attr1("y")};
+      std::copy(more.begin(), more.end(),
+                std::inserter(attrs, attrs.begin()));
+      expect(attrs, equal_attributes({attr1("a"), attr2("b"), attr3("c")}));
+
+      attributes copied;
+      copied.insert(attrs.begin(), attrs.end());
+      expect(copied, equal_attributes({attr1("a"), attr2("b"), attr3("c")}));
+    });
+
+    _.test("erase()", []() {
+      string_attr attr1("1");
+      string_attr attr2("2");
+      string_attr attr3("3");
+      attributes attrs = {attr1("a"), attr2("b"), attr3("c")};
+
+      auto i = attrs.erase(attrs.find("2"));
+      expect(&i->attribute(), equal_to(&attr3));
+      expect(attrs, equal_attributes({attr1("a"), attr3("c")}));
+
+      expect(attrs.erase("1"), equal_to(1u));
+      expect(attrs.erase("1"), equal_to(0u));
+      expect(attrs, equal_attributes({attr3("c")}));
+      expect(attrs.find("1"), equal_to(attrs.end()));
+    });
+
+    _.test("has_skip()", []() {
+      bool_attr attr("attribute");
+      attributes attrs = {attr};
+      expect(attrs.has_skip(), equal_to(false));
+
+      attrs.insert(skip("broken"));
+      expect(attrs.has_skip(), equal_to(true));
+      expect(unite(attributes{attr}, attributes{skip}).has_skip(),
+             equal_to(true));
+
+      attrs.erase("skip");
+      expect(attrs.has_skip(), equal_to(false));
+    });
+  });
 });
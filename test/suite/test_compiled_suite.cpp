@@ -9,6 +9,7 @@ struct mock_test {
   std::function<T> function;
   attributes attrs;
   detail::source_location loc;
+  shared_setup_info shared_setup = {};
 };
 
 template<typename>
@@ -97,4 +97,96 @@ suite<suites_list> test_global_suite("global suite declaration", [](auto &_) {
     expect(suites.size(), equal_to(0));
   });
 
+
+  subsuite<>(_, "suite_registry", [](auto &_) {
+    auto add = [](detail::suite_registry &registry, const std::string &name,
+                  int &calls) {
+      registry.add(name, {}, [&calls](suites_list &list,
+                                      const std::string &name,
+                                      const attributes &attrs) {
+        calls++;
+        suite<>(list, name, attrs, [](auto &_){
+          _.test("test 1", []() {});
+          _.test("test 2", []() {});
+        });
+      });
+    };
+    auto keep_only = [](std::size_t kept) {
+      return [kept](std::size_t index, const std::string &,
+                    const attributes &) {
+        return index == kept;
+      };
+    };
+
+    _.test("register without building", [add](suites_list &) {
+      detail::suite_registry registry;
+      int calls = 0;
+      add(registry, "inner test suite", calls);
+
+      expect(registry.size(), equal_to(1u));
+      expect(calls, equal_to(0));
+
+      auto &suites = registry.materialize();
+      expect(calls, equal_to(1));
+      expect(suites.size(), equal_to(1u));
+      expect(suites[0].name(), equal_to("inner test suite"));
+      expect(suites[0].tests().size(), equal_to(2u));
+
+      registry.materialize();
+      expect(calls, equal_to(1));
+    });
+
+    _.test("build only kept registrations", [add, keep_only](suites_list &) {
+      detail::suite_registry registry;
+      int calls[3] = {0, 0, 0};
+      add(registry, "first", calls[0]);
+      add(registry, "second", calls[1]);
+      add(registry, "third", calls[2]);
+
+      auto &suites = registry.materialize(keep_only(1));
+      expect(calls, array(0, 1, 0));
+      expect(suites.size(), equal_to(1u));
+      expect(suites[0].name(), equal_to("second"));
+
+      registry.materialize();
+      expect(calls, array(1, 1, 1));
+      std::vector<std::string> names;
+      for(const auto &i : suites)
+        names.push_back(i.name());
+      expect(names, array("first", "second", "third"));
+    });
+
+    _.test("test IDs don't depend on other registrations",
+           [add, keep_only](suites_list &) {
+      detail::suite_registry all, one;
+      int calls = 0;
+      for(auto *registry : {&all, &one}) {
+        add(*registry, "first", calls);
+        add(*registry, "second", calls);
+      }
+
+      auto &all_suites = all.materialize();
+      auto &one_suites = one.materialize(keep_only(1));
+      expect(one_suites[0].tests()[0].id,
+             equal_to(all_suites[1].tests()[0].id));
+      expect(one_suites[0].tests()[1].id,
+             equal_to(all_suites[1].tests()[1].id));
+      expect(detail::registration_index(one_suites[0].tests()[0].id),
+             equal_to(1u));
+    });
+
+    _.test("throwing builder", [keep_only](suites_list &) {
+      detail::suite_registry registry;
+      registry.add("broken test suite", {}, [](suites_list &,
+                                              const std::string &,
+                                              const attributes &) {
+        throw std::runtime_error("bad");
+      });
+
+      expect([&registry]() { registry.materialize(); },
+             thrown<std::runtime_error>("bad"));
+      expect(registry.materialize(keep_only(1)).size(), equal_to(0u));
+    });
+  });
+
 });
@@ -165,6 +165,54 @@ suite<> test_suite("suite creation", [](auto &_) {
       expect(s2, simple_suite("test suite"));
     });
 
+    _.test("create a test suite that forks after setup", []() {
+      int setups = 0;
+      auto s = make_suite<int>("test suite", [&setups](auto &_){
+        fork_after_setup(_);
+        _.setup([&setups](int &x) {
+          x = 1;
+          setups++;
+        });
+        _.test("test 1", [](int &x) {
+          expect(x, equal_to(1));
+        });
+        _.test("test 2", [](int &x) {
+          expect(x, equal_to(1));
+        });
+
+        subsuite<>(_, "subsuite", [](auto &_) {
+          _.test("test 3", [](int &x) {
+            expect(x, equal_to(1));
+          });
+        });
+      });
+
+      auto &tests = s.tests();
+      auto &subtests = s.subsuites()[0].tests();
+      expect(tests[0].shared_setup.group, not_equal_to(nullptr));
+      expect(tests[1].shared_setup.group,
+             equal_to(tests[0].shared_setup.group));
+      expect(subtests[0].shared_setup.group,
+             equal_to(tests[0].shared_setup.group));
+      expect(std::vector{tests[0].shared_setup.index,
+                         tests[1].shared_setup.index,
+                         subtests[0].shared_setup.index},
+             array(0u, 1u, 2u));
+
+      // Without a test runner that forks, each test sets up its own fixture.
+      for(const auto &t : tests)
+        expect(t.function().passed, equal_to(true));
+      expect(subtests[0].function().passed, equal_to(true));
+      expect(setups, equal_to(3));
+    });
+
+    _.test("create a test suite that doesn't fork after setup", []() {
+      auto s = make_suite<>("test suite", [](auto &_){
+        _.test("test", []() {});
+      });
+      expect(bool(s.tests()[0].shared_setup), equal_to(false));
+    });
+
     _.test("create a test suite that throws", []() {
       auto make_bad_suite = []() {
         auto s = make_suite<>("broken test suite", [](auto &){
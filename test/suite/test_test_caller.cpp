@@ -54,4 +54,23 @@ test_test_caller("test_caller", [](auto &_) {
     expect("test run count", test.runs(), equal_to(1));
     expect("teardown run count", teardown.runs(), equal_to(1));
   });
+
+  _.test("shared suite", [](auto &tup) {
+    run_counter_from_tuple<Fixture> setup, teardown, test1, test2;
+    using caller_type = apply_tuple<test_caller, Fixture>;
+    auto suite = std::make_shared<typename caller_type::suite_type>();
+    suite->setup = setup;
+    suite->teardown = teardown;
+    suite->tests.push_back(test1);
+    suite->tests.push_back(test2);
+
+    caller_type caller1{suite, 0}, caller2{suite, 1};
+    std::apply(caller1, tup);
+    std::apply(caller2, tup);
+
+    expect("setup run count", setup.runs(), equal_to(2));
+    expect("test 1 run count", test1.runs(), equal_to(1));
+    expect("test 2 run count", test2.runs(), equal_to(1));
+    expect("teardown run count", teardown.runs(), equal_to(2));
+  });
 });
@@ -0,0 +1,84 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+#include <array>
+#include <functional>
+#include <memory>
+
+#include <mettle/detail/move_only_function.hpp>
+
+using detail::move_only_function;
+
+suite<> test_move_only_function("move_only_function", [](auto &_) {
+  _.test("empty", []() {
+    move_only_function<void()> f;
+    expect(bool(f), equal_to(false));
+
+    move_only_function<void()> g = nullptr;
+    expect(bool(g), equal_to(false));
+
+    move_only_function<void()> h = std::function<void()>();
+    expect(bool(h), equal_to(false));
+  });
+
+  _.test("small callable", []() {
+    int calls = 0;
+    move_only_function<int(int)> f = [&calls](int x) {
+      calls++;
+      return x * 2;
+    };
+    expect(bool(f), equal_to(true));
+    expect(f(2), equal_to(4));
+    expect(calls, equal_to(1));
+  });
+
+  _.test("large callable", []() {
+    std::array<int, 32> data = {};
+    data[31] = 5;
+    move_only_function<int()> f = [data]() { return data[31]; };
+    expect(f(), equal_to(5));
+  });
+
+  _.test("move-only callable", []() {
+    auto p = std::make_unique<int>(3);
+    move_only_function<int()> f = [p = std::move(p)]() { return *p; };
+    expect(f(), equal_to(3));
+  });
+
+  _.test("reference arguments", []() {
+    move_only_function<void(int &)> f = [](int &x) { x++; };
+    int x = 1;
+    f(x);
+    expect(x, equal_to(2));
+  });
+
+  _.test("move construct", []() {
+    auto p = std::make_shared<int>(3);
+    move_only_function<int()> f = [p]() { return *p; };
+    move_only_function<int()> g = std::move(f);
+    expect(bool(f), equal_to(false));
+    expect(g(), equal_to(3));
+    expect(p.use_count(), equal_to(2));
+  });
+
+  _.test("move assign", []() {
+    auto p = std::make_shared<int>(3), q = std::make_shared<int>(4);
+    move_only_function<int()> f = [p]() { return *p; };
+    move_only_function<int()> g = [q]() { return *q; };
+    g = std::move(f);
+    expect(bool(f), equal_to(false));
+    expect(g(), equal_to(3));
+    expect(q.use_count(), equal_to(1));
+  });
+
+  _.test("destroy", []() {
+    auto p = std::make_shared<int>(3);
+    std::array<int, 32> data = {};
+    {
+      move_only_function<int()> f = [p]() { return *p; };
+      move_only_function<int()> g = [p, data]() { return *p + data[0]; };
+      expect(p.use_count(), equal_to(3));
+    }
+    expect(p.use_count(), equal_to(1));
+  });
+});
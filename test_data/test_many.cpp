@@ -0,0 +1,16 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+suite<> test_suite("suite", [](auto &_) {
+  subsuite<>(_, "first", [](auto &_) {
+    _.test("test 1", []() {});
+    _.test("test 2", []() {});
+    _.test("test 3", []() {});
+  });
+
+  subsuite<>(_, "second", [](auto &_) {
+    _.test("test 1", []() {});
+    _.test("test 2", []() {});
+    _.test("test 3", []() {});
+  });
+});
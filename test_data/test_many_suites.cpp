@@ -0,0 +1,14 @@
+#include <mettle.hpp>
+using namespace mettle;
+
+suite<> first_suite("first", [](auto &_) {
+  _.test("test 1", []() {});
+  _.test("test 2", []() {});
+  _.test("test 3", []() {});
+});
+
+suite<> second_suite("second", [](auto &_) {
+  _.test("test 1", []() {});
+  _.test("test 2", []() {});
+  _.test("test 3", []() {});
+});